@@ -0,0 +1,146 @@
+#include "allocator.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace csv {
+
+namespace {
+
+constexpr size_t kAlignment = 64u;
+// MPOL_PREFERRED of <numaif.h>, which comes with libnuma
+constexpr int kPreferredNumaPolicy = 1;
+// pooled buffers more than this many times the requested size aren't reused for it
+constexpr size_t kMaxFitRatio = 2u;
+
+inline size_t RoundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+char* AllocateAligned(size_t size) {
+  void* buffer = nullptr;
+  if (posix_memalign(&buffer, kAlignment, size == 0u ? kAlignment : size) != 0) {
+    throw std::bad_alloc();
+  }
+  return static_cast<char*>(buffer);
+}
+
+class HeapChunkAllocator : public ChunkAllocator {
+public:
+  char* Allocate(size_t size, size_t& capacity) override {
+    capacity = size;
+    return AllocateAligned(size);
+  }
+  void Deallocate(char* buffer, size_t) override { std::free(buffer); }
+};
+
+}  // namespace
+
+std::shared_ptr<ChunkAllocator> DefaultChunkAllocator() {
+  static const std::shared_ptr<ChunkAllocator> allocator(new HeapChunkAllocator());
+  return allocator;
+}
+
+PooledChunkAllocator::PooledChunkAllocator(Options options)
+    : options_(options), pooled_bytes_(0u) {}
+
+PooledChunkAllocator::~PooledChunkAllocator() { Trim(); }
+
+char* PooledChunkAllocator::Allocate(size_t size, size_t& capacity) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // the smallest pooled buffer that fits, unless it would hold on to much more
+    // memory than asked for
+    const auto best_fit = pool_.lower_bound(size);
+    if (best_fit != pool_.end() && best_fit->first / kMaxFitRatio <= size) {
+      capacity = best_fit->first;
+      char* buffer = best_fit->second;
+      pooled_bytes_ -= capacity;
+      pool_.erase(best_fit);
+      return buffer;
+    }
+  }
+  return AllocateNew(size, capacity);
+}
+
+void PooledChunkAllocator::Deallocate(char* buffer, size_t capacity) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity <= options_.max_pooled_bytes - pooled_bytes_) {
+      pool_.emplace(capacity, buffer);
+      pooled_bytes_ += capacity;
+      return;
+    }
+  }
+  Free(buffer, capacity);
+}
+
+void PooledChunkAllocator::Trim() {
+  std::multimap<size_t, char*> pool;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pool.swap(pool_);
+    pooled_bytes_ = 0u;
+  }
+  for (const auto& buffer : pool) {
+    Free(buffer.second, buffer.first);
+  }
+}
+
+size_t PooledChunkAllocator::PooledBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pooled_bytes_;
+}
+
+char* PooledChunkAllocator::AllocateNew(size_t size, size_t& capacity) const {
+  if (!options_.huge_pages || size < kHugePageSize) {
+    capacity = size;
+    return AllocateAligned(size);
+  }
+
+  // mmap() aligns on pages only: map a huge page more and unmap what is around the
+  // aligned buffer
+  capacity = RoundUp(size, kHugePageSize);
+  const size_t mapped_size = capacity + kHugePageSize;
+  void* mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapped == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  const auto mapped_begin = reinterpret_cast<uintptr_t>(mapped);
+  const auto begin = RoundUp(mapped_begin, kHugePageSize);
+  if (begin != mapped_begin) {
+    munmap(mapped, begin - mapped_begin);
+  }
+  const size_t tail_size = mapped_begin + mapped_size - (begin + capacity);
+  if (tail_size != 0u) {
+    munmap(reinterpret_cast<void*>(begin + capacity), tail_size);
+  }
+
+  char* buffer = reinterpret_cast<char*>(begin);
+  // only hints: the buffer works without them
+  madvise(buffer, capacity, MADV_HUGEPAGE);
+#ifdef SYS_mbind
+  if (options_.numa_node >= 0 && options_.numa_node < 64) {
+    const unsigned long node_mask = 1ul << options_.numa_node;
+    syscall(SYS_mbind, buffer, capacity, kPreferredNumaPolicy, &node_mask,
+            sizeof(node_mask) * 8, 0);
+  }
+#endif
+  return buffer;
+}
+
+void PooledChunkAllocator::Free(char* buffer, size_t capacity) const {
+  if (!options_.huge_pages || capacity < kHugePageSize) {
+    std::free(buffer);
+  } else {
+    munmap(buffer, capacity);
+  }
+}
+
+}  // namespace csv
@@ -0,0 +1,77 @@
+#ifndef __ALLOCATOR_H__
+#define __ALLOCATOR_H__
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace csv {
+
+// ChunkAllocator provides the memory of MemoryChunks. Memory is 64 byte aligned and
+// not zeroed: every cell of a chunk is written before it is read.
+class ChunkAllocator {
+public:
+  virtual ~ChunkAllocator() = default;
+
+  // Allocate() returns at least size bytes; capacity is set to how many there are
+  virtual char* Allocate(size_t size, size_t& capacity) = 0;
+  // Deallocate() takes back memory returned by Allocate() along with its capacity
+  virtual void Deallocate(char* buffer, size_t capacity) = 0;
+};
+
+// DefaultChunkAllocator() returns an allocator which allocates from and frees to the
+// heap right away. Thread safe.
+std::shared_ptr<ChunkAllocator> DefaultChunkAllocator();
+
+// PooledChunkAllocator keeps deallocated buffers and hands the best fitting one out
+// again, so that chunks of one batch after another (see Document::Clear()) reuse
+// memory. A buffer of more than twice the size asked for is left in the pool. Buffers beyond max_pooled_bytes, and every buffer once the allocator is
+// destroyed or trimmed, are freed. Thread safe.
+//
+// Buffers of at least kHugePageSize bytes are mapped on their own, rounded up to and
+// aligned on huge pages, which the kernel is asked to back them with. Since buffers
+// aren't zeroed, their pages are first touched by the thread parsing into them and
+// so are placed on its NUMA node. numa_node, when not negative, prefers that node
+// for mapped buffers instead.
+class PooledChunkAllocator : public ChunkAllocator {
+public:
+  static constexpr size_t kHugePageSize = 2 * 1024 * 1024;  // 2MB
+
+  struct Options {
+    size_t max_pooled_bytes;
+    bool huge_pages;
+    int numa_node;
+
+    Options()
+        : max_pooled_bytes(static_cast<size_t>(-1)), huge_pages(true), numa_node(-1) {}
+  };
+
+  explicit PooledChunkAllocator(Options options = Options());
+  ~PooledChunkAllocator() override;
+
+  PooledChunkAllocator(const PooledChunkAllocator&) = delete;
+  PooledChunkAllocator& operator=(const PooledChunkAllocator&) = delete;
+
+  char* Allocate(size_t size, size_t& capacity) override;
+  void Deallocate(char* buffer, size_t capacity) override;
+
+  // Trim() frees every pooled buffer
+  void Trim();
+  // PooledBytes() returns the capacity of the pooled buffers
+  size_t PooledBytes() const;
+
+private:
+  char* AllocateNew(size_t size, size_t& capacity) const;
+  void Free(char* buffer, size_t capacity) const;
+
+  Options options_;
+  mutable std::mutex mutex_;
+  // pooled buffers by capacity
+  std::multimap<size_t, char*> pool_;
+  size_t pooled_bytes_;
+};
+
+}  // namespace csv
+
+#endif
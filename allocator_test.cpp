@@ -0,0 +1,100 @@
+#include "allocator.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "chunk.h"
+
+namespace {
+
+using PooledChunkAllocator = csv::PooledChunkAllocator;
+
+TEST(TestChunkAllocator, Default) {
+  auto allocator = csv::DefaultChunkAllocator();
+  size_t capacity = 0u;
+  char* buffer = allocator->Allocate(1000u, capacity);
+  EXPECT_EQ(1000u, capacity);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buffer) % 64);
+  std::memset(buffer, 1, capacity);
+  allocator->Deallocate(buffer, capacity);
+}
+
+TEST(TestChunkAllocator, Pooled) {
+  PooledChunkAllocator::Options options;
+  options.huge_pages = false;
+  PooledChunkAllocator allocator(options);
+  size_t small_capacity = 0u;
+  char* small = allocator.Allocate(100u, small_capacity);
+  size_t big_capacity = 0u;
+  char* big = allocator.Allocate(1000u, big_capacity);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(small) % 64);
+  allocator.Deallocate(small, small_capacity);
+  allocator.Deallocate(big, big_capacity);
+  EXPECT_EQ(1100u, allocator.PooledBytes());
+
+  // the smallest buffer that fits, if it isn't more than twice as big
+  size_t capacity = 0u;
+  EXPECT_EQ(small, allocator.Allocate(50u, capacity));
+  EXPECT_EQ(100u, capacity);
+  char* other = allocator.Allocate(101u, capacity);
+  EXPECT_NE(big, other);
+  EXPECT_EQ(101u, capacity);
+  EXPECT_EQ(1000u, allocator.PooledBytes());
+  EXPECT_EQ(big, allocator.Allocate(600u, capacity));
+  EXPECT_EQ(1000u, capacity);
+  EXPECT_EQ(0u, allocator.PooledBytes());
+  allocator.Deallocate(small, 100u);
+  allocator.Deallocate(big, 1000u);
+  allocator.Deallocate(other, 101u);
+
+  allocator.Trim();
+  EXPECT_EQ(0u, allocator.PooledBytes());
+}
+
+TEST(TestChunkAllocator, MaxPooledBytes) {
+  PooledChunkAllocator::Options options;
+  options.max_pooled_bytes = 1500u;
+  options.huge_pages = false;
+  PooledChunkAllocator allocator(options);
+  size_t first_capacity = 0u;
+  char* first = allocator.Allocate(1000u, first_capacity);
+  size_t second_capacity = 0u;
+  char* second = allocator.Allocate(1000u, second_capacity);
+  allocator.Deallocate(first, first_capacity);
+  // freed right away
+  allocator.Deallocate(second, second_capacity);
+  EXPECT_EQ(1000u, allocator.PooledBytes());
+}
+
+TEST(TestChunkAllocator, HugePages) {
+  PooledChunkAllocator allocator;
+  size_t capacity = 0u;
+  char* buffer = allocator.Allocate(PooledChunkAllocator::kHugePageSize + 1u, capacity);
+  EXPECT_EQ(2 * PooledChunkAllocator::kHugePageSize, capacity);
+  EXPECT_EQ(0u,
+            reinterpret_cast<uintptr_t>(buffer) % PooledChunkAllocator::kHugePageSize);
+  std::memset(buffer, 1, capacity);
+  allocator.Deallocate(buffer, capacity);
+  EXPECT_EQ(buffer, allocator.Allocate(PooledChunkAllocator::kHugePageSize, capacity));
+  allocator.Deallocate(buffer, capacity);
+}
+
+TEST(TestChunkAllocator, MemoryChunk) {
+  auto allocator = std::make_shared<PooledChunkAllocator>();
+  char* data = nullptr;
+  {
+    csv::MemoryChunk chunk(4096u, allocator);
+    EXPECT_EQ(4096u, chunk.Size());
+    chunk.Write(8, int64_t{42});
+    EXPECT_EQ(42, chunk.ReadInt64(8));
+    data = chunk.ReadCharPtr(0);
+  }
+  // the chunk's memory went back to the pool
+  EXPECT_EQ(4096u, allocator->PooledBytes());
+  csv::MemoryChunk chunk(4000u, allocator);
+  EXPECT_EQ(data, chunk.ReadCharPtr(0));
+}
+
+}  // anonymous namespace
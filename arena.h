@@ -0,0 +1,45 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace csv {
+
+// StringSlot locates a string inside a StringArena. It is what a VARSTRING cell
+// holds in a MemoryChunk.
+struct StringSlot {
+  uint32_t offset;
+  uint32_t size;
+};
+
+// StringArena is a bump allocator holding the VARSTRING cells of one chunk.
+// Strings are appended back to back into one buffer and addressed by offset, so
+// growing the buffer never invalidates a StringSlot. Not thread safe: a chunk is
+// written by one thread at a time.
+class StringArena {
+public:
+  StringSlot Append(const char* str, size_t str_length) {
+    if (buffer_.size() + str_length > std::numeric_limits<uint32_t>::max()) {
+      throw std::length_error("strings of a chunk exceed 4GB");
+    }
+    const auto offset = static_cast<uint32_t>(buffer_.size());
+    buffer_.insert(buffer_.end(), str, str + str_length);
+    return StringSlot{offset, static_cast<uint32_t>(str_length)};
+  }
+
+  const char* Data(uint32_t offset) const { return buffer_.data() + offset; }
+  size_t Size() const { return buffer_.size(); }
+  void Reserve(size_t size) { buffer_.reserve(size); }
+
+private:
+  std::vector<char> buffer_;
+};
+
+}  // namespace csv
+
+#endif
@@ -0,0 +1,284 @@
+#include "arrow.h"
+
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace csv {
+
+namespace {
+
+// SchemaData owns everything an exported ArrowSchema points to
+struct SchemaData {
+  std::string format;
+  std::string name;
+  std::vector<ArrowSchema> children;
+  std::vector<ArrowSchema*> child_pointers;
+  std::unique_ptr<ArrowSchema> dictionary;
+};
+
+// ArrayData owns everything an exported ArrowArray points to, besides buffers
+// borrowed from the Document
+struct ArrayData {
+  // copied buffers, as uint64_t for 8 byte alignment
+  std::vector<std::vector<uint64_t>> owned_buffers;
+  std::vector<const void*> buffers;
+  std::vector<ArrowArray> children;
+  std::vector<ArrowArray*> child_pointers;
+  std::unique_ptr<ArrowArray> dictionary;
+
+  template <typename T>
+  T* Own(size_t num_values) {
+    owned_buffers.emplace_back((num_values * sizeof(T) + sizeof(uint64_t) - 1) /
+                               sizeof(uint64_t));
+    return reinterpret_cast<T*>(owned_buffers.back().data());
+  }
+};
+
+void ReleaseSchema(ArrowSchema* schema) {
+  auto data = static_cast<SchemaData*>(schema->private_data);
+  for (auto& child : data->children) {
+    // a consumer may have moved a child out
+    if (child.release != nullptr) {
+      child.release(&child);
+    }
+  }
+  if (data->dictionary && data->dictionary->release != nullptr) {
+    data->dictionary->release(data->dictionary.get());
+  }
+  delete data;
+  schema->release = nullptr;
+}
+
+void ReleaseArray(ArrowArray* array) {
+  auto data = static_cast<ArrayData*>(array->private_data);
+  for (auto& child : data->children) {
+    if (child.release != nullptr) {
+      child.release(&child);
+    }
+  }
+  if (data->dictionary && data->dictionary->release != nullptr) {
+    data->dictionary->release(data->dictionary.get());
+  }
+  delete data;
+  array->release = nullptr;
+}
+
+void InitSchema(const std::string& format, const std::string& name, int64_t flags,
+                SchemaData* data, ArrowSchema* out) {
+  data->format = format;
+  data->name = name;
+  out->format = data->format.c_str();
+  out->name = data->name.c_str();
+  out->metadata = nullptr;
+  out->flags = flags;
+  out->n_children = static_cast<int64_t>(data->children.size());
+  out->children = data->child_pointers.empty() ? nullptr : data->child_pointers.data();
+  out->dictionary = data->dictionary.get();
+  out->release = ReleaseSchema;
+  out->private_data = data;
+}
+
+void InitArray(size_t length, int64_t null_count, ArrayData* data, ArrowArray* out) {
+  out->length = static_cast<int64_t>(length);
+  out->null_count = null_count;
+  out->offset = 0;
+  out->n_buffers = static_cast<int64_t>(data->buffers.size());
+  out->n_children = static_cast<int64_t>(data->children.size());
+  out->buffers = data->buffers.empty() ? nullptr : data->buffers.data();
+  out->children = data->child_pointers.empty() ? nullptr : data->child_pointers.data();
+  out->dictionary = data->dictionary.get();
+  out->release = ReleaseArray;
+  out->private_data = data;
+}
+
+int64_t NullCount(const uint64_t* validity, size_t num_rows) {
+  size_t num_valid = 0u;
+  for (size_t word = 0u; word < num_rows / 64; ++word) {
+    num_valid += static_cast<size_t>(__builtin_popcountll(validity[word]));
+  }
+  if (num_rows % 64 != 0u) {
+    const uint64_t last_bits = (uint64_t{1u} << (num_rows % 64)) - 1u;
+    num_valid +=
+        static_cast<size_t>(__builtin_popcountll(validity[num_rows / 64] & last_bits));
+  }
+  return static_cast<int64_t>(num_rows - num_valid);
+}
+
+// FixedWidthBuffer() returns the values of view as one array, copied unless they
+// already are one
+template <typename T>
+const void* FixedWidthBuffer(const ColumnView<T>& view, ArrayData* data) {
+  if (view.Empty() || view.Contiguous()) {
+    return view.Data();
+  }
+  auto values = data->Own<T>(view.Size());
+  for (size_t idx = 0u; idx < view.Size(); ++idx) {
+    values[idx] = view[idx];
+  }
+  return values;
+}
+
+// AddStringBuffers() adds the utf8 offsets and data buffers of strings, borrowing
+// the data when the strings lie back to back in memory
+template <typename GetString>
+void AddStringBuffers(size_t num_strings, GetString get_string, ArrayData* data) {
+  auto offsets = data->Own<int32_t>(num_strings + 1);
+  offsets[0] = 0;
+  bool back_to_back = true;
+  const char* first = num_strings == 0u ? nullptr : get_string(0u).data;
+  size_t total_size = 0u;
+  for (size_t idx = 0u; idx < num_strings; ++idx) {
+    const auto str = get_string(idx);
+    back_to_back = back_to_back && (str.size == 0u || str.data == first + total_size);
+    total_size += str.size;
+    if (total_size > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+      throw std::length_error("strings of a chunk don't fit Arrow's utf8 type");
+    }
+    offsets[idx + 1] = static_cast<int32_t>(total_size);
+  }
+
+  data->buffers.push_back(offsets);
+  if (back_to_back) {
+    data->buffers.push_back(first);
+    return;
+  }
+  auto chars = data->Own<char>(total_size);
+  for (size_t idx = 0u; idx < num_strings; ++idx) {
+    const auto str = get_string(idx);
+    if (str.size != 0u) {
+      std::memcpy(chars + offsets[idx], str.data, str.size);
+    }
+  }
+  data->buffers.push_back(chars);
+}
+
+const char* ColumnFormat(FieldType type) {
+  switch (type) {
+  case FieldType::INT64:
+    return "l";
+  case FieldType::DOUBLE:
+    return "g";
+  case FieldType::CATEGORY:
+    return "i";
+  default:
+    return "u";
+  }
+}
+
+void ExportColumnSchema(const Document& doc, size_t column_index, ArrowSchema* out) {
+  std::unique_ptr<SchemaData> data(new SchemaData());
+  const auto type = doc.ColumnType(column_index);
+  if (type == FieldType::CATEGORY) {
+    data->dictionary.reset(new ArrowSchema());
+    InitSchema("u", "", ARROW_FLAG_NULLABLE, new SchemaData(), data->dictionary.get());
+  }
+  InitSchema(ColumnFormat(type), doc.FieldNames()[column_index], ARROW_FLAG_NULLABLE,
+             data.get(), out);
+  data.release();
+}
+
+void ExportColumnArray(const Document& doc, size_t column_index, size_t chunk_index,
+                       ArrowArray* out) {
+  std::unique_ptr<ArrayData> data(new ArrayData());
+  const auto num_rows = doc.NumRowsInChunk(chunk_index);
+  const auto& column = doc.FieldNames()[column_index];
+  const uint64_t* validity = nullptr;
+  switch (doc.ColumnType(column_index)) {
+  case FieldType::INT64: {
+    const auto view = doc.GetColumnView<int64_t>(column_index, chunk_index);
+    validity = view.Validity();
+    data->buffers.push_back(validity);
+    data->buffers.push_back(FixedWidthBuffer(view, data.get()));
+    break;
+  }
+  case FieldType::DOUBLE: {
+    const auto view = doc.GetColumnView<double>(column_index, chunk_index);
+    validity = view.Validity();
+    data->buffers.push_back(validity);
+    data->buffers.push_back(FixedWidthBuffer(view, data.get()));
+    break;
+  }
+  case FieldType::STRING:
+  case FieldType::VARSTRING: {
+    const auto view = doc.GetColumnView<StringRef>(column_index, chunk_index);
+    validity = view.Validity();
+    data->buffers.push_back(validity);
+    AddStringBuffers(num_rows, [&view](size_t idx) { return view[idx]; }, data.get());
+    break;
+  }
+  case FieldType::CATEGORY: {
+    const auto view = doc.GetColumnView<int32_t>(column_index, chunk_index);
+    validity = view.Validity();
+    data->buffers.push_back(validity);
+    data->buffers.push_back(FixedWidthBuffer(view, data.get()));
+
+    const auto& dictionary = doc.Dictionary(column);
+    std::unique_ptr<ArrayData> dictionary_data(new ArrayData());
+    dictionary_data->buffers.push_back(nullptr);
+    AddStringBuffers(dictionary.Size(),
+                     [&dictionary](size_t code) {
+                       return dictionary.Get(static_cast<int32_t>(code));
+                     },
+                     dictionary_data.get());
+    data->dictionary.reset(new ArrowArray());
+    InitArray(dictionary.Size(), 0, dictionary_data.get(), data->dictionary.get());
+    dictionary_data.release();
+    break;
+  }
+  default:
+    throw std::invalid_argument(std::string("can't export column ") + column);
+  }
+
+  InitArray(num_rows, num_rows == 0u ? 0 : NullCount(validity, num_rows), data.get(),
+            out);
+  data.release();
+}
+
+}  // namespace
+
+void ExportSchema(const Document& doc, ArrowSchema* out) {
+  std::unique_ptr<SchemaData> data(new SchemaData());
+  const auto num_columns = doc.FieldNames().size();
+  data->children.resize(num_columns);
+  for (size_t column_index = 0u; column_index < num_columns; ++column_index) {
+    ExportColumnSchema(doc, column_index, &data->children[column_index]);
+    data->child_pointers.push_back(&data->children[column_index]);
+  }
+  InitSchema("+s", "", 0, data.get(), out);
+  data.release();
+}
+
+void ExportChunk(const Document& doc, size_t chunk_index, ArrowArray* out) {
+  std::unique_ptr<ArrayData> data(new ArrayData());
+  const auto num_columns = doc.FieldNames().size();
+  data->buffers.push_back(nullptr);
+  data->children.resize(num_columns);
+  for (auto& child : data->children) {
+    child.release = nullptr;
+  }
+  try {
+    for (size_t column_index = 0u; column_index < num_columns; ++column_index) {
+      ExportColumnArray(doc, column_index, chunk_index, &data->children[column_index]);
+      data->child_pointers.push_back(&data->children[column_index]);
+    }
+  } catch (...) {
+    ArrowArray partial;
+    InitArray(0u, 0, data.release(), &partial);
+    partial.release(&partial);
+    throw;
+  }
+  InitArray(doc.NumRowsInChunk(chunk_index), 0, data.get(), out);
+  data.release();
+}
+
+void ExportColumn(const Document& doc, size_t column_index, size_t chunk_index,
+                  ArrowSchema* schema, ArrowArray* array) {
+  ExportColumnArray(doc, column_index, chunk_index, array);
+  ExportColumnSchema(doc, column_index, schema);
+}
+
+}  // namespace csv
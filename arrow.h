@@ -0,0 +1,74 @@
+#ifndef __ARROW_H__
+#define __ARROW_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "document.h"
+
+// The Arrow C data interface, as specified by Apache Arrow
+// (https://arrow.apache.org/docs/format/CDataInterface.html). Declared here so
+// there is no dependency on the Arrow library; the guard lets Arrow's own
+// declaration take precedence.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  const char* format;
+  const char* name;
+  const char* metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+
+  void (*release)(struct ArrowSchema*);
+  void* private_data;
+};
+
+struct ArrowArray {
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+
+  void (*release)(struct ArrowArray*);
+  void* private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+namespace csv {
+
+// Columns are exported as
+//   INT64 -> int64 ("l"), DOUBLE -> float64 ("g"),
+//   STRING, VARSTRING -> utf8 ("u"),
+//   CATEGORY -> int32 codes ("i") with a utf8 dictionary.
+// Every column is nullable, with the Document's validity bitmap.
+// Buffers which already have Arrow's layout are not copied: validity bitmaps,
+// Layout::COLUMN numbers and CATEGORY codes, CATEGORY dictionaries and VARSTRING
+// strings written in row order. Everything else is copied into memory owned by the
+// exported array. Either way the Document must outlive the exported arrays and
+// must not be changed meanwhile. Ownership of out passes to the caller, who must
+// call its release callback.
+
+// ExportSchema() exports the schema of doc as a struct ("+s") of its columns
+void ExportSchema(const Document& doc, ArrowSchema* out);
+// ExportChunk() exports a chunk of doc as a struct array of its columns (a record
+// batch in Arrow terms) matching ExportSchema()
+void ExportChunk(const Document& doc, size_t chunk_index, ArrowArray* out);
+// ExportColumn() exports one column of one chunk
+void ExportColumn(const Document& doc, size_t column_index, size_t chunk_index,
+                  ArrowSchema* schema, ArrowArray* array);
+
+}  // namespace csv
+
+#endif
@@ -0,0 +1,141 @@
+#include "arrow.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+csv::Document MakeDocument(csv::Layout layout) {
+  csv::Document doc(std::vector<std::string>{"id", "grade", "name", "note", "status"},
+                    std::vector<csv::FieldType>{csv::FieldType::INT64,
+                                                csv::FieldType::DOUBLE,
+                                                csv::FieldType::STRING,
+                                                csv::FieldType::VARSTRING,
+                                                csv::FieldType::CATEGORY},
+                    layout);
+  const std::vector<std::vector<std::string>> rows{{"1", "1.5", "KR", "first", "OK"},
+                                                   {"", "2.5", "", "", "FAIL"},
+                                                   {"3", "", "US", "third", "OK"}};
+  doc.AddChunk(rows.size());
+  for (size_t row = 0u; row < rows.size(); ++row) {
+    for (size_t column = 0u; column < rows[row].size(); ++column) {
+      doc.Write(row, column, rows[row][column].data(), rows[row][column].size());
+    }
+  }
+  return doc;
+}
+
+bool IsValid(const ArrowArray& array, size_t idx) {
+  const auto validity = static_cast<const uint8_t*>(array.buffers[0]);
+  return ((validity[idx / 8] >> (idx % 8)) & 1u) != 0u;
+}
+
+std::string StringAt(const ArrowArray& array, size_t idx) {
+  const auto offsets = static_cast<const int32_t*>(array.buffers[1]);
+  const auto chars = static_cast<const char*>(array.buffers[2]);
+  return std::string(chars + offsets[idx], offsets[idx + 1] - offsets[idx]);
+}
+
+TEST(TestArrow, ExportSchema) {
+  const auto doc = MakeDocument(csv::Layout::ROW);
+  ArrowSchema schema;
+  csv::ExportSchema(doc, &schema);
+  EXPECT_STREQ("+s", schema.format);
+  ASSERT_EQ(5, schema.n_children);
+  const std::vector<std::string> formats{"l", "g", "u", "u", "i"};
+  for (int64_t idx = 0; idx < schema.n_children; ++idx) {
+    EXPECT_EQ(formats[idx], schema.children[idx]->format);
+    EXPECT_EQ(doc.FieldNames()[idx], schema.children[idx]->name);
+    EXPECT_EQ(ARROW_FLAG_NULLABLE, schema.children[idx]->flags);
+  }
+  ASSERT_NE(nullptr, schema.children[4]->dictionary);
+  EXPECT_STREQ("u", schema.children[4]->dictionary->format);
+  EXPECT_EQ(nullptr, schema.children[0]->dictionary);
+
+  schema.release(&schema);
+  EXPECT_EQ(nullptr, schema.release);
+}
+
+TEST(TestArrow, ExportChunk) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    const auto doc = MakeDocument(layout);
+    ArrowArray batch;
+    csv::ExportChunk(doc, 0u, &batch);
+    ASSERT_EQ(3, batch.length);
+    ASSERT_EQ(5, batch.n_children);
+
+    const auto& ids = *batch.children[0];
+    EXPECT_EQ(1, ids.null_count);
+    EXPECT_TRUE(IsValid(ids, 0u));
+    EXPECT_FALSE(IsValid(ids, 1u));
+    const auto id_values = static_cast<const int64_t*>(ids.buffers[1]);
+    EXPECT_EQ(1, id_values[0]);
+    EXPECT_EQ(3, id_values[2]);
+
+    const auto& grades = *batch.children[1];
+    EXPECT_EQ(1, grades.null_count);
+    EXPECT_DOUBLE_EQ(2.5, static_cast<const double*>(grades.buffers[1])[1]);
+
+    const auto& names = *batch.children[2];
+    ASSERT_EQ(3, names.n_buffers);
+    EXPECT_EQ("KR", StringAt(names, 0u));
+    EXPECT_EQ("", StringAt(names, 1u));
+    EXPECT_EQ("US", StringAt(names, 2u));
+
+    const auto& notes = *batch.children[3];
+    EXPECT_EQ("first", StringAt(notes, 0u));
+    EXPECT_EQ("third", StringAt(notes, 2u));
+
+    const auto& statuses = *batch.children[4];
+    const auto codes = static_cast<const int32_t*>(statuses.buffers[1]);
+    ASSERT_NE(nullptr, statuses.dictionary);
+    EXPECT_EQ(2, statuses.dictionary->length);
+    EXPECT_EQ("OK", StringAt(*statuses.dictionary, codes[0]));
+    EXPECT_EQ("FAIL", StringAt(*statuses.dictionary, codes[1]));
+    EXPECT_EQ("OK", StringAt(*statuses.dictionary, codes[2]));
+
+    // buffers with Arrow's layout are borrowed
+    const auto id_view = doc.GetColumnView<int64_t>(0u, 0u);
+    EXPECT_EQ(static_cast<const void*>(id_view.Validity()), ids.buffers[0]);
+    EXPECT_EQ(layout == csv::Layout::COLUMN,
+              static_cast<const void*>(id_view.Data()) == ids.buffers[1]);
+    EXPECT_EQ(static_cast<const void*>(doc.Dictionary("status").Get(0).data),
+              statuses.dictionary->buffers[2]);
+
+    batch.release(&batch);
+    EXPECT_EQ(nullptr, batch.release);
+  }
+}
+
+TEST(TestArrow, ExportColumn) {
+  const auto doc = MakeDocument(csv::Layout::COLUMN);
+  ArrowSchema schema;
+  ArrowArray array;
+  csv::ExportColumn(doc, 3u, 0u, &schema, &array);
+  EXPECT_STREQ("u", schema.format);
+  EXPECT_STREQ("note", schema.name);
+  EXPECT_EQ(3, array.length);
+  EXPECT_EQ(1, array.null_count);
+  EXPECT_EQ("first", StringAt(array, 0u));
+  EXPECT_EQ("", StringAt(array, 1u));
+  EXPECT_EQ("third", StringAt(array, 2u));
+  // VARSTRING cells written in row order are borrowed from the chunk's arena
+  EXPECT_EQ(static_cast<const void*>(doc.GetColumnView<csv::StringRef>(3u, 0u)[0].data),
+            array.buffers[2]);
+
+  // a consumer may move a child out of a batch before releasing the batch
+  ArrowArray batch;
+  csv::ExportChunk(doc, 0u, &batch);
+  ArrowArray moved = *batch.children[1];
+  batch.children[1]->release = nullptr;
+  batch.release(&batch);
+  EXPECT_EQ(3, moved.length);
+  moved.release(&moved);
+
+  array.release(&array);
+  schema.release(&schema);
+}
+
+}  // anonymous namespace
@@ -8,9 +8,31 @@
 #include <string>
 #include <vector>
 
+#include "number.h"
+
 namespace csv {
 
-enum class FieldType { INT64 = 0, DOUBLE, STRING, END };
+// STRING cells have a fixed size of 64 bytes (63 characters at most) while
+// VARSTRING cells hold strings of any length in a per chunk StringArena.
+// CATEGORY cells hold a 32 bit code into a per column dictionary of distinct values,
+// which suits columns with few distinct values (status codes, country codes, ...).
+// SKIP columns of a CSV file are scanned past without being converted or stored,
+// they don't appear in the Document at all.
+enum class FieldType { INT64 = 0, DOUBLE, STRING, VARSTRING, CATEGORY, SKIP, END };
+
+// StringRef points to a string owned by someone else (e.g. a MemoryChunk) and is
+// only valid as long as the owner is.
+struct StringRef {
+  const char* data;
+  size_t size;
+
+  std::string ToString() const { return std::string(data, size); }
+  bool operator==(const StringRef& other) const {
+    return size == other.size &&
+           std::char_traits<char>::compare(data, other.data, size) == 0;
+  }
+  bool operator!=(const StringRef& other) const { return !(*this == other); }
+};
 
 template <FieldType>
 struct FieldTypeHelper {
@@ -35,6 +57,20 @@ struct FieldTypeHelper<FieldType::STRING> {
   static constexpr size_t size = 64;
 };
 
+template <>
+struct FieldTypeHelper<FieldType::VARSTRING> {
+  using type = std::string;
+  // a StringSlot
+  static constexpr size_t size = 8;
+};
+
+template <>
+struct FieldTypeHelper<FieldType::CATEGORY> {
+  using type = std::string;
+  // a code into the column's CategoryDictionary
+  static constexpr size_t size = sizeof(int32_t);
+};
+
 template <typename T>
 T Convert(const std::string&);
 
@@ -53,9 +89,9 @@ inline double Convert<double>(const std::string& str) {
 
 template <>
 inline int64_t Convert<int64_t>(const char* str, size_t len) {
-  auto value = static_cast<int64_t>(std::atoll(str));
-  if (value == 0 && !(*str == '0' && len == 1)) {
-    throw std::invalid_argument(str);
+  int64_t value = 0;
+  if (ParseInt64(str, len, value) != ParseStatus::OK) {
+    throw std::invalid_argument(std::string(str, len));
   }
 
   return value;
@@ -63,9 +99,9 @@ inline int64_t Convert<int64_t>(const char* str, size_t len) {
 
 template <>
 inline double Convert<double>(const char* str, size_t len) {
-  auto value = std::atof(str);
-  if (value == 0.0) {
-    return std::stoll(std::string(str, len));
+  double value = 0.0;
+  if (ParseDouble(str, len, value) != ParseStatus::OK) {
+    throw std::invalid_argument(std::string(str, len));
   }
 
   return value;
@@ -75,6 +111,8 @@ inline size_t GetTotalFieldTypeSize(const std::vector<FieldType>& field_types) {
   using IntHelper = FieldTypeHelper<FieldType::INT64>;
   using DoubleHelper = FieldTypeHelper<FieldType::DOUBLE>;
   using StringHelper = FieldTypeHelper<FieldType::STRING>;
+  using VarStringHelper = FieldTypeHelper<FieldType::VARSTRING>;
+  using CategoryHelper = FieldTypeHelper<FieldType::CATEGORY>;
   auto size_getter = [](size_t sum, FieldType field_type) -> size_t {
     switch (field_type) {
     case FieldType::INT64:
@@ -83,6 +121,10 @@ inline size_t GetTotalFieldTypeSize(const std::vector<FieldType>& field_types) {
       return sum + DoubleHelper::size;
     case FieldType::STRING:
       return sum + StringHelper::size;
+    case FieldType::VARSTRING:
+      return sum + VarStringHelper::size;
+    case FieldType::CATEGORY:
+      return sum + CategoryHelper::size;
     default:
       return sum;
     }
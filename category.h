@@ -0,0 +1,97 @@
+#ifndef __CATEGORY_H__
+#define __CATEGORY_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "arena.h"
+#include "base.h"
+
+namespace csv {
+
+// CategoryDictionary maps the distinct values of a CATEGORY column to dense 32 bit
+// codes, in order of first appearance. Values are kept in a StringArena and looked
+// up through an open addressing hash table, so interning a value that is already
+// known doesn't allocate. Not thread safe.
+class CategoryDictionary {
+public:
+  CategoryDictionary() : table_(kInitialTableSize, int32_t{kEmpty}) {}
+
+  // Intern() returns the code of given value, adding it when it is new
+  int32_t Intern(const char* str, size_t str_length) {
+    const uint64_t hash = Hash(str, str_length);
+    size_t bucket = static_cast<size_t>(hash) & (table_.size() - 1);
+    for (;; bucket = (bucket + 1) & (table_.size() - 1)) {
+      const int32_t code = table_[bucket];
+      if (code == kEmpty) {
+        break;
+      }
+      if (hashes_[code] == hash && Equals(code, str, str_length)) {
+        return code;
+      }
+    }
+
+    if (slots_.size() >= static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+      throw std::length_error("too many distinct values for a CATEGORY column");
+    }
+    const auto code = static_cast<int32_t>(slots_.size());
+    slots_.push_back(arena_.Append(str, str_length));
+    hashes_.push_back(hash);
+    table_[bucket] = code;
+    if (slots_.size() * 2 > table_.size()) {
+      Rehash(table_.size() * 2);
+    }
+    return code;
+  }
+
+  size_t Size() const { return slots_.size(); }
+  StringRef Get(int32_t code) const {
+    const auto& slot = slots_[code];
+    return StringRef{arena_.Data(slot.offset), slot.size};
+  }
+
+private:
+  static constexpr int32_t kEmpty = -1;
+  static constexpr size_t kInitialTableSize = 64;
+
+  // FNV-1a
+  static uint64_t Hash(const char* str, size_t str_length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t idx = 0u; idx < str_length; ++idx) {
+      hash ^= static_cast<unsigned char>(str[idx]);
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  bool Equals(int32_t code, const char* str, size_t str_length) const {
+    const auto& slot = slots_[code];
+    return slot.size == str_length &&
+           std::memcmp(arena_.Data(slot.offset), str, str_length) == 0;
+  }
+
+  void Rehash(size_t table_size) {
+    std::vector<int32_t> table(table_size, int32_t{kEmpty});
+    for (size_t code = 0u; code < hashes_.size(); ++code) {
+      size_t bucket = static_cast<size_t>(hashes_[code]) & (table_size - 1);
+      while (table[bucket] != kEmpty) {
+        bucket = (bucket + 1) & (table_size - 1);
+      }
+      table[bucket] = static_cast<int32_t>(code);
+    }
+    table_.swap(table);
+  }
+
+  StringArena arena_;
+  std::vector<StringSlot> slots_;
+  std::vector<uint64_t> hashes_;
+  std::vector<int32_t> table_;
+};
+
+}  // namespace csv
+
+#endif
@@ -4,8 +4,11 @@
 #include <cassert>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
 
+#include "allocator.h"
+#include "arena.h"
 #include "base.h"
 
 namespace csv {
@@ -15,39 +18,81 @@ public:
   static constexpr size_t kStringCellSize = FieldTypeHelper<FieldType::STRING>::size;
   static constexpr size_t kMaxStringLength = kStringCellSize - 1;
 
-  explicit MemoryChunk(size_t size) : buffer_(new char[size]), size_(size) {
-    std::memset(reinterpret_cast<void *>(buffer_), 0, size_ * sizeof(char));
-  }
+  // MemoryChunk() over size bytes from allocator, which are not zeroed
+  MemoryChunk(size_t size, std::shared_ptr<ChunkAllocator> allocator)
+      : buffer_(allocator->Allocate(size, capacity_)),
+        size_(size),
+        allocator_(std::move(allocator)) {}
+  explicit MemoryChunk(size_t size) : MemoryChunk(size, DefaultChunkAllocator()) {}
+
+  // MemoryChunk() over memory it doesn't own, which keep_alive keeps valid (e.g. a
+  // copy on write file mapping)
+  MemoryChunk(char *buffer, size_t size, std::shared_ptr<const void> keep_alive)
+      : buffer_(buffer),
+        size_(size),
+        capacity_(size),
+        keep_alive_(std::move(keep_alive)) {}
 
   ~MemoryChunk() {
-    if (size_ > 0 && !buffer_)
-      delete[] buffer_;
+    if (allocator_) {
+      allocator_->Deallocate(buffer_, capacity_);
+    }
   }
 
+  MemoryChunk(const MemoryChunk&) = delete;
+  MemoryChunk& operator=(const MemoryChunk&) = delete;
+
+  size_t Size() const { return size_; }
+
+  // cells may be unaligned once 4 byte CATEGORY cells are mixed into a row
   int64_t ReadInt64(int offset) const {
-    return *reinterpret_cast<int64_t *>(buffer_ + offset);
+    int64_t value;
+    std::memcpy(&value, buffer_ + offset, sizeof(int64_t));
+    return value;
+  }
+  int32_t ReadInt32(int offset) const {
+    int32_t value;
+    std::memcpy(&value, buffer_ + offset, sizeof(int32_t));
+    return value;
   }
   double ReadDouble(int offset) const {
-    return *reinterpret_cast<double *>(buffer_ + offset);
+    double value;
+    std::memcpy(&value, buffer_ + offset, sizeof(double));
+    return value;
   }
   std::string ReadString(int offset) const {
     return std::string(ReadCharPtr(offset), ReadStrLength(offset));
   }
+  StringRef ReadStringRef(int offset) const {
+    return StringRef{ReadCharPtr(offset), ReadStrLength(offset)};
+  }
   char *ReadCharPtr(int offset) const { return buffer_ + offset; }
   size_t ReadStrLength(int offset) const {
     return MemoryChunk::kMaxStringLength -
            static_cast<size_t>(*(buffer_ + offset + MemoryChunk::kMaxStringLength));
   }
 
+  StringSlot ReadStringSlot(int offset) const {
+    StringSlot slot;
+    std::memcpy(&slot, buffer_ + offset, sizeof(StringSlot));
+    return slot;
+  }
+
   template <typename T>
   T Read(int offset) const;
 
   void Write(int offset, int64_t value) {
     std::memcpy(buffer_ + offset, &value, sizeof(int64_t));
   }
+  void Write(int offset, int32_t value) {
+    std::memcpy(buffer_ + offset, &value, sizeof(int32_t));
+  }
   void Write(int offset, double value) {
     std::memcpy(buffer_ + offset, &value, sizeof(double));
   }
+  void Write(int offset, const StringSlot &slot) {
+    std::memcpy(buffer_ + offset, &slot, sizeof(StringSlot));
+  }
   void Write(int offset, const std::string &str) {
     this->Write(offset, str.c_str(), str.size());
   }
@@ -64,6 +109,9 @@ public:
 private:
   char *buffer_;
   size_t size_;
+  size_t capacity_;
+  std::shared_ptr<ChunkAllocator> allocator_;
+  std::shared_ptr<const void> keep_alive_;
 };
 
 template <>
@@ -71,6 +119,11 @@ inline int64_t MemoryChunk::Read<int64_t>(int offset) const {
   return ReadInt64(offset);
 }
 
+template <>
+inline int32_t MemoryChunk::Read<int32_t>(int offset) const {
+  return ReadInt32(offset);
+}
+
 template <>
 inline double MemoryChunk::Read<double>(int offset) const {
   return ReadDouble(offset);
@@ -81,6 +134,11 @@ inline std::string MemoryChunk::Read<std::string>(int offset) const {
   return ReadString(offset);
 }
 
+template <>
+inline StringRef MemoryChunk::Read<StringRef>(int offset) const {
+  return ReadStringRef(offset);
+}
+
 }  // namespace csv
 
 #endif
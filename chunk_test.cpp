@@ -74,6 +74,11 @@ TEST(TestCSVMemoryChunk, ReadWriteString) {
       std::string(
           "exact 63 length string to match max string size of MemoryChunk."),
       chunk.ReadString(500));
+
+  const auto ref = chunk.ReadStringRef(string_buffer_size * 2);
+  EXPECT_EQ(18u, ref.size);
+  EXPECT_EQ(chunk.ReadCharPtr(string_buffer_size * 2), ref.data);
+  EXPECT_EQ(std::string("seemed so far away"), ref.ToString());
 }
 
 } // namespace
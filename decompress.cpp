@@ -0,0 +1,287 @@
+#include "decompress.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+#ifdef PCSV_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef PCSV_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "mapped_file.h"
+
+namespace csv {
+
+namespace {
+
+constexpr size_t kReadSize = 4 * 1024 * 1024;
+
+#ifdef PCSV_WITH_ZLIB
+// GzipBuffer inflates a mapped gzip file kReadSize bytes at a time
+class GzipBuffer : public std::streambuf {
+public:
+  explicit GzipBuffer(const std::string& path)
+      : path_(path),
+        file_(path),
+        input_(file_.Data()),
+        output_(kReadSize),
+        finished_(false) {
+    stream_.zalloc = Z_NULL;
+    stream_.zfree = Z_NULL;
+    stream_.opaque = Z_NULL;
+    stream_.next_in = Z_NULL;
+    stream_.avail_in = 0u;
+    // + 32 detects the gzip header
+    if (inflateInit2(&stream_, MAX_WBITS + 32) != Z_OK) {
+      throw std::runtime_error(std::string("Failed to inflate ") + path);
+    }
+  }
+
+  ~GzipBuffer() override { inflateEnd(&stream_); }
+
+protected:
+  int_type underflow() override {
+    const char* const end = file_.Data() + file_.Size();
+    while (!finished_) {
+      if (stream_.avail_in == 0u) {
+        if (input_ == end) {
+          throw std::runtime_error(std::string("Truncated gzip data in ") + path_);
+        }
+        // avail_in is only 32 bits wide
+        const auto input_size =
+            std::min(static_cast<size_t>(end - input_), static_cast<size_t>(1u) << 30);
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input_));
+        stream_.avail_in = static_cast<uInt>(input_size);
+        input_ += input_size;
+      }
+      stream_.next_out = reinterpret_cast<Bytef*>(output_.data());
+      stream_.avail_out = static_cast<uInt>(output_.size());
+      const int result = inflate(&stream_, Z_NO_FLUSH);
+      if (result == Z_STREAM_END) {
+        if (stream_.avail_in == 0u && input_ == end) {
+          finished_ = true;
+        } else {
+          // the next member
+          inflateReset(&stream_);
+        }
+      } else if (result != Z_OK && result != Z_BUF_ERROR) {
+        throw std::runtime_error(std::string("Corrupt gzip data in ") + path_);
+      }
+      const auto produced = output_.size() - stream_.avail_out;
+      if (produced != 0u) {
+        setg(output_.data(), output_.data(), output_.data() + produced);
+        return traits_type::to_int_type(*gptr());
+      }
+    }
+    return traits_type::eof();
+  }
+
+private:
+  const std::string path_;
+  MappedFile file_;
+  // next byte not given to stream_ yet
+  const char* input_;
+  std::vector<char> output_;
+  z_stream stream_;
+  bool finished_;
+};
+#endif
+
+#ifdef PCSV_WITH_ZSTD
+// frames bigger than this are streamed rather than decoded whole
+constexpr unsigned long long kMaxParallelFrameSize = 256ull * 1024 * 1024;
+
+// ZstdBuffer decodes a mapped zstd file, in parallel if its frames allow it
+class ZstdBuffer : public std::streambuf {
+public:
+  ZstdBuffer(const std::string& path, int num_threads, ThreadPool& thread_pool)
+      : path_(path), file_(path), num_threads_(std::max(num_threads, 1)),
+        thread_pool_(thread_pool), next_frame_(0u),
+        stream_(nullptr), frame_remaining_(0u) {
+    const char* const data = file_.Data();
+    const size_t size = file_.Size();
+    bool parallel = std::min(num_threads_, thread_pool.NumThreads()) > 1;
+    for (size_t offset = 0u; offset < size;) {
+      const size_t frame_size =
+          ZSTD_findFrameCompressedSize(data + offset, size - offset);
+      if (ZSTD_isError(frame_size)) {
+        throw std::runtime_error(std::string("Corrupt zstd data in ") + path);
+      }
+      // 0 for skippable frames
+      const auto content_size = ZSTD_getFrameContentSize(data + offset, size - offset);
+      if (content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+          content_size == ZSTD_CONTENTSIZE_ERROR ||
+          content_size > kMaxParallelFrameSize) {
+        parallel = false;
+      }
+      frames_.push_back(Frame{offset, frame_size, static_cast<size_t>(content_size)});
+      offset += frame_size;
+    }
+    if (frames_.size() < 2u) {
+      parallel = false;
+    }
+    if (parallel) {
+      return;
+    }
+
+    frames_.clear();
+    stream_ = ZSTD_createDStream();
+    if (stream_ == nullptr) {
+      throw std::bad_alloc();
+    }
+    ZSTD_initDStream(stream_);
+    input_ = ZSTD_inBuffer{data, size, 0u};
+    output_.resize(ZSTD_DStreamOutSize());
+  }
+
+  ~ZstdBuffer() override {
+    if (stream_ != nullptr) {
+      ZSTD_freeDStream(stream_);
+    }
+  }
+
+protected:
+  int_type underflow() override {
+    const bool has_data = stream_ == nullptr ? DecodeFrames() : Stream();
+    return has_data ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+  }
+
+private:
+  struct Frame {
+    size_t offset;
+    size_t size;
+    size_t content_size;
+  };
+
+  // DecodeFrames() decodes up to 2 frames per thread, but no more than about
+  // kReadSize bytes per thread unless a single frame is bigger, into output_
+  bool DecodeFrames() {
+    while (next_frame_ < frames_.size()) {
+      const size_t batch_begin = next_frame_;
+      std::vector<size_t> output_offsets(1u, 0u);
+      while (next_frame_ < frames_.size() &&
+             next_frame_ - batch_begin < 2u * static_cast<size_t>(num_threads_) &&
+             (next_frame_ == batch_begin ||
+              output_offsets.back() + frames_[next_frame_].content_size <=
+                  kReadSize * static_cast<size_t>(num_threads_))) {
+        output_offsets.push_back(output_offsets.back() +
+                                 frames_[next_frame_].content_size);
+        ++next_frame_;
+      }
+      const size_t batch_size = next_frame_ - batch_begin;
+      output_.resize(std::max(output_.size(), output_offsets.back()));
+
+      thread_pool_.ParallelFor(batch_size, num_threads_, [&](size_t idx) {
+        const auto& frame = frames_[batch_begin + idx];
+        const size_t decoded =
+            ZSTD_decompress(output_.data() + output_offsets[idx], frame.content_size,
+                            file_.Data() + frame.offset, frame.size);
+        if (ZSTD_isError(decoded) || decoded != frame.content_size) {
+          throw std::runtime_error(std::string("Corrupt zstd data in ") + path_);
+        }
+      });
+
+      if (output_offsets.back() != 0u) {
+        setg(output_.data(), output_.data(), output_.data() + output_offsets.back());
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool Stream() {
+    // ZSTD_decompressStream() returns 0 once a frame is complete
+    while (input_.pos < input_.size || frame_remaining_ != 0u) {
+      ZSTD_outBuffer output{output_.data(), output_.size(), 0u};
+      frame_remaining_ = ZSTD_decompressStream(stream_, &output, &input_);
+      if (ZSTD_isError(frame_remaining_)) {
+        throw std::runtime_error(std::string("Corrupt zstd data in ") + path_);
+      }
+      if (output.pos != 0u) {
+        setg(output_.data(), output_.data(), output_.data() + output.pos);
+        return true;
+      }
+      if (input_.pos == input_.size && frame_remaining_ != 0u) {
+        throw std::runtime_error(std::string("Truncated zstd data in ") + path_);
+      }
+    }
+    return false;
+  }
+
+  const std::string path_;
+  MappedFile file_;
+  const int num_threads_;
+  ThreadPool& thread_pool_;
+  std::vector<char> output_;
+
+  // parallel decoding
+  std::vector<Frame> frames_;
+  size_t next_frame_;
+
+  // otherwise
+  ZSTD_DStream* stream_;
+  ZSTD_inBuffer input_;
+  size_t frame_remaining_;
+};
+#endif
+
+}  // namespace
+
+Compression DetectCompression(const std::string& path) {
+  unsigned char magic[4] = {0u, 0u, 0u, 0u};
+  FILE* file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return Compression::NONE;
+  }
+  const size_t magic_size = std::fread(magic, 1u, sizeof(magic), file);
+  std::fclose(file);
+
+  if (magic_size >= 2u && magic[0] == 0x1f && magic[1] == 0x8b) {
+    return Compression::GZIP;
+  }
+  if (magic_size == 4u) {
+    const uint32_t number = magic[0] | magic[1] << 8 | magic[2] << 16 |
+                            static_cast<uint32_t>(magic[3]) << 24;
+    // a frame, or a skippable frame of metadata such as a seek table
+    if (number == 0xfd2fb528u || (number & 0xfffffff0u) == 0x184d2a50u) {
+      return Compression::ZSTD;
+    }
+  }
+  return Compression::NONE;
+}
+
+std::unique_ptr<std::streambuf> OpenDecompressed(const std::string& path,
+                                                 Compression compression, int num_threads,
+                                                 ThreadPool* thread_pool) {
+  switch (compression) {
+    case Compression::GZIP:
+#ifdef PCSV_WITH_ZLIB
+      return std::unique_ptr<std::streambuf>(new GzipBuffer(path));
+#else
+      throw std::runtime_error(path +
+                               " is gzip compressed, but zlib support isn't built in");
+#endif
+    case Compression::ZSTD:
+#ifdef PCSV_WITH_ZSTD
+      return std::unique_ptr<std::streambuf>(
+          new ZstdBuffer(path, num_threads,
+                         thread_pool != nullptr ? *thread_pool : *DefaultThreadPool()));
+#else
+      (void)num_threads;
+      (void)thread_pool;
+      throw std::runtime_error(path +
+                               " is zstd compressed, but zstd support isn't built in");
+#endif
+    case Compression::NONE:
+      break;
+  }
+  throw std::invalid_argument(path + " isn't compressed");
+}
+
+}  // namespace csv
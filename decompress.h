@@ -0,0 +1,36 @@
+#ifndef __DECOMPRESS_H__
+#define __DECOMPRESS_H__
+
+#include <memory>
+#include <streambuf>
+#include <string>
+
+#include "thread_pool.h"
+
+namespace csv {
+
+enum class Compression {
+  NONE,
+  GZIP,
+  ZSTD,
+};
+
+// DetectCompression() tells a gzip or zstd file by its magic bytes, whatever its name.
+Compression DetectCompression(const std::string& path);
+
+// OpenDecompressed() returns a stream buffer reading the decompressed content of a
+// compressed file, which is memory mapped rather than copied. gzip files may hold
+// several members, zstd files several frames. The frames of a zstd file which all
+// tell their content size (as written by pzstd, or by concatenating files) are
+// decoded in parallel on up to num_threads threads of thread_pool (DefaultThreadPool()
+// when null), a couple per thread at a time, and handed out in order; other
+// zstd files are streamed on the calling thread, as gzip files always are.
+// Reading throws std::runtime_error on corrupt data, and so does opening when
+// support for the compression wasn't built in.
+std::unique_ptr<std::streambuf> OpenDecompressed(const std::string& path,
+                                                 Compression compression, int num_threads,
+                                                 ThreadPool* thread_pool = nullptr);
+
+}  // namespace csv
+
+#endif
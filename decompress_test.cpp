@@ -0,0 +1,148 @@
+#include "decompress.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#ifdef PCSV_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef PCSV_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+using Compression = csv::Compression;
+
+struct TempFileHandle {
+  std::string file_name;
+  TempFileHandle(): file_name(std::tmpnam(nullptr)) {}
+  ~TempFileHandle() { if (!file_name.empty()) std::remove(file_name.c_str()); }
+};
+
+// Records() returns num_records CSV records of increasing ids
+std::string Records(int first_id, int num_records) {
+  std::string records;
+  for (int id = first_id; id < first_id + num_records; ++id) {
+    records += std::to_string(id) + ",name" + std::to_string(id % 13) + '\n';
+  }
+  return records;
+}
+
+void WriteFile(const std::string& path, const std::string& content) {
+  std::ofstream ofs(path, std::ios::binary);
+  ofs << content;
+}
+
+std::string Decompress(const std::string& path, int num_threads,
+                       csv::ThreadPool* thread_pool = nullptr) {
+  const auto buffer =
+      csv::OpenDecompressed(path, csv::DetectCompression(path), num_threads, thread_pool);
+  return std::string(std::istreambuf_iterator<char>(buffer.get()),
+                     std::istreambuf_iterator<char>());
+}
+
+TEST(TestDecompress, DetectCompression) {
+  TempFileHandle file_handle;
+  WriteFile(file_handle.file_name, "id,name\n1,a\n");
+  EXPECT_EQ(Compression::NONE, csv::DetectCompression(file_handle.file_name));
+  WriteFile(file_handle.file_name, "");
+  EXPECT_EQ(Compression::NONE, csv::DetectCompression(file_handle.file_name));
+  WriteFile(file_handle.file_name, "\x1f\x8b\x08");
+  EXPECT_EQ(Compression::GZIP, csv::DetectCompression(file_handle.file_name));
+  WriteFile(file_handle.file_name, "\x28\xb5\x2f\xfd");
+  EXPECT_EQ(Compression::ZSTD, csv::DetectCompression(file_handle.file_name));
+  EXPECT_EQ(Compression::NONE, csv::DetectCompression("/nonexistent/file.csv"));
+  EXPECT_THROW(csv::OpenDecompressed(file_handle.file_name, Compression::NONE, 1),
+               std::invalid_argument);
+}
+
+#ifdef PCSV_WITH_ZLIB
+void AppendGzipMember(const std::string& path, const std::string& content) {
+  gzFile file = gzopen(path.c_str(), "ab");
+  ASSERT_NE(nullptr, file);
+  ASSERT_EQ(static_cast<int>(content.size()),
+            gzwrite(file, content.data(), static_cast<unsigned>(content.size())));
+  gzclose(file);
+}
+
+TEST(TestDecompress, Gzip) {
+  TempFileHandle file_handle;
+  // bigger than a single read, in two members as written by pigz or `cat a.gz b.gz`
+  const auto first = Records(0, 400000);
+  const auto second = Records(400000, 1000);
+  AppendGzipMember(file_handle.file_name, first);
+  AppendGzipMember(file_handle.file_name, second);
+  ASSERT_GT(first.size(), size_t{4 * 1024 * 1024});
+  EXPECT_EQ(first + second, Decompress(file_handle.file_name, 4));
+
+  // truncated
+  std::ifstream ifs(file_handle.file_name, std::ios::binary);
+  std::string compressed((std::istreambuf_iterator<char>(ifs)),
+                         std::istreambuf_iterator<char>());
+  WriteFile(file_handle.file_name, compressed.substr(0u, compressed.size() / 2));
+  EXPECT_THROW(Decompress(file_handle.file_name, 4), std::runtime_error);
+}
+#endif
+
+#ifdef PCSV_WITH_ZSTD
+std::string ZstdFrame(const std::string& content, bool content_size) {
+  ZSTD_CCtx* context = ZSTD_createCCtx();
+  ZSTD_CCtx_setParameter(context, ZSTD_c_contentSizeFlag, content_size ? 1 : 0);
+  // as the zstd tool does, so that corrupt data is told apart
+  ZSTD_CCtx_setParameter(context, ZSTD_c_checksumFlag, 1);
+  std::string frame(ZSTD_compressBound(content.size()), '\0');
+  const size_t frame_size =
+      ZSTD_compress2(context, &frame[0], frame.size(), content.data(), content.size());
+  ZSTD_freeCCtx(context);
+  EXPECT_FALSE(ZSTD_isError(frame_size));
+  frame.resize(frame_size);
+  return frame;
+}
+
+TEST(TestDecompress, ZstdFrames) {
+  TempFileHandle file_handle;
+  std::string content;
+  std::string compressed;
+  for (int frame = 0; frame < 40; ++frame) {
+    const auto records = Records(frame * 20000, 20000);
+    content += records;
+    compressed += ZstdFrame(records, true);
+  }
+  // an empty frame, and a skippable one of metadata
+  compressed += ZstdFrame("", true);
+  compressed += std::string("\x50\x2a\x4d\x18\x04\x00\x00\x00meta", 12u);
+  WriteFile(file_handle.file_name, compressed);
+
+  // decoded in parallel, and on one thread
+  csv::ThreadPool thread_pool(4);
+  EXPECT_EQ(content, Decompress(file_handle.file_name, 4, &thread_pool));
+  EXPECT_EQ(content, Decompress(file_handle.file_name, 4));
+  EXPECT_EQ(content, Decompress(file_handle.file_name, 1, &thread_pool));
+
+  // corrupt
+  compressed[compressed.size() / 2] ^= 0x55;
+  WriteFile(file_handle.file_name, compressed);
+  EXPECT_THROW(Decompress(file_handle.file_name, 4, &thread_pool), std::runtime_error);
+}
+
+TEST(TestDecompress, ZstdStream) {
+  TempFileHandle file_handle;
+  // frames without their content size can only be streamed
+  const auto first = Records(0, 300000);
+  const auto second = Records(300000, 10);
+  const auto compressed = ZstdFrame(first, false) + ZstdFrame(second, true);
+  WriteFile(file_handle.file_name, compressed);
+  EXPECT_EQ(first + second, Decompress(file_handle.file_name, 4));
+
+  WriteFile(file_handle.file_name, compressed.substr(0u, compressed.size() - 3));
+  EXPECT_THROW(Decompress(file_handle.file_name, 4), std::runtime_error);
+}
+#endif
+
+}  // anonymous namespace
@@ -1,8 +1,14 @@
 #include "document.h"
 
-#include <omp.h>
+#include "mapped_file.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
 #include <numeric>
+#include <stdexcept>
+#include <type_traits>
 
 namespace csv {
 
@@ -10,17 +16,318 @@ namespace {
 
 inline size_t Align64(size_t size) { return 64 * ((size + 63) / 64); }
 
+// rows Get() reads per task
+constexpr size_t kRowsPerBlock = 16384u;
+
+// CopyContiguous() copies a column stored as one array of cells into output.
+// Returns false for cells which can't be copied bytewise.
+template <typename T>
+inline bool CopyContiguous(const char* cells, size_t num_rows, T* output) {
+  std::memcpy(output, cells, num_rows * sizeof(T));
+  return true;
+}
+
+inline bool CopyContiguous(const char*, size_t, std::string*) { return false; }
+
+// GetMatches() tells whether a column of given type can be read as T: numbers and
+// CATEGORY codes from their own type only, strings from any string column
+template <typename T>
+inline bool GetMatches(FieldType type) {
+  return ViewTypeHelper<T>::Matches(type);
+}
+
+template <>
+inline bool GetMatches<std::string>(FieldType type) {
+  return type == FieldType::STRING || type == FieldType::VARSTRING ||
+         type == FieldType::CATEGORY;
+}
+
+// ReadCell() reads a cell of given type, looking VARSTRING cells up in arena and
+// CATEGORY cells up in dictionary
+template <typename T>
+inline T ReadCell(const MemoryChunk& chunk, const StringArena&, const CategoryDictionary&,
+                  FieldType, size_t offset) {
+  return chunk.Read<T>(offset);
+}
+
+template <>
+inline std::string ReadCell<std::string>(const MemoryChunk& chunk,
+                                         const StringArena& arena,
+                                         const CategoryDictionary& dictionary,
+                                         FieldType type, size_t offset) {
+  if (type == FieldType::VARSTRING) {
+    const auto slot = chunk.ReadStringSlot(offset);
+    return std::string(arena.Data(slot.offset), slot.size);
+  }
+  if (type == FieldType::CATEGORY) {
+    return dictionary.Get(chunk.ReadInt32(offset)).ToString();
+  }
+  return chunk.ReadString(offset);
+}
+
+// ReadRows() reads rows [begin_row, end_row) of a column, whose cells are row_stride
+// bytes apart from first_cell on, into output
+template <typename T>
+inline void ReadRows(const MemoryChunk& chunk, const StringArena& arena,
+                     const CategoryDictionary& dictionary, FieldType type,
+                     size_t first_cell, size_t row_stride, size_t begin_row,
+                     size_t end_row, T* output) {
+  const auto cell = first_cell + begin_row * row_stride;
+  if (row_stride == sizeof(T) &&
+      CopyContiguous(chunk.ReadCharPtr(cell), end_row - begin_row, output)) {
+    return;
+  }
+  for (size_t row = begin_row; row < end_row; ++row) {
+    output[row - begin_row] =
+        ReadCell<T>(chunk, arena, dictionary, type, first_cell + row * row_stride);
+  }
+}
+
+// bytes of rows GetColumns() reads at once for all its columns, so that they stay
+// in L2 cache while every column is copied out of them
+constexpr size_t kTileBytes = 128u * 1024u;
+
+// Accumulator aggregates cells of a column. Runs of 64 valid cells, the common case,
+// go through AddRun(), whose loop keeps kLanes independent sums and extremes so that
+// the compiler can vectorize it and each addition needn't wait for the last.
+template <typename T>
+struct Accumulator {
+  // integers are summed unsigned, so that overflow wraps around
+  using Sum = typename std::conditional<std::is_integral<T>::value, uint64_t, T>::type;
+  static constexpr size_t kLanes = 4u;
+
+  static T Highest() {
+    return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                : std::numeric_limits<T>::max();
+  }
+  static T Lowest() {
+    return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                : std::numeric_limits<T>::lowest();
+  }
+
+  Accumulator() : num_rows(0u), count(0u), sum(0), min(Highest()), max(Lowest()) {}
+
+  void Add(T value) {
+    ++count;
+    sum += static_cast<Sum>(value);
+    min = value < min ? value : min;
+    max = value > max ? value : max;
+  }
+  // AddRun() adds num_cells valid cells, a multiple of kLanes, cell(idx) reading
+  // cell idx
+  template <typename Cell>
+  void AddRun(const Cell& cell, size_t begin, size_t num_cells) {
+    Sum sums[kLanes];
+    T mins[kLanes];
+    T maxs[kLanes];
+    for (size_t lane = 0u; lane < kLanes; ++lane) {
+      sums[lane] = 0;
+      mins[lane] = Highest();
+      maxs[lane] = Lowest();
+    }
+    for (size_t idx = begin; idx < begin + num_cells; idx += kLanes) {
+      for (size_t lane = 0u; lane < kLanes; ++lane) {
+        const T value = cell(idx + lane);
+        sums[lane] += static_cast<Sum>(value);
+        mins[lane] = value < mins[lane] ? value : mins[lane];
+        maxs[lane] = value > maxs[lane] ? value : maxs[lane];
+      }
+    }
+    for (size_t lane = 0u; lane < kLanes; ++lane) {
+      sum += sums[lane];
+      min = mins[lane] < min ? mins[lane] : min;
+      max = maxs[lane] > max ? maxs[lane] : max;
+    }
+    count += num_cells;
+  }
+  void Merge(const Accumulator& other) {
+    num_rows += other.num_rows;
+    count += other.count;
+    sum += other.sum;
+    min = other.min < min ? other.min : min;
+    max = other.max > max ? other.max : max;
+  }
+  ColumnAggregate<T> Result() const {
+    return ColumnAggregate<T>{num_rows, count, static_cast<T>(sum),
+                              count == 0u ? T(0) : min, count == 0u ? T(0) : max};
+  }
+
+  size_t num_rows;
+  size_t count;
+  Sum sum;
+  T min;
+  T max;
+};
+
+// ValidBits() returns the validity bits of cells [begin, end) of a view, at most
+// 64 from begin on, a multiple of 64
+template <typename T>
+inline uint64_t ValidBits(const ColumnView<T>& view, size_t begin, size_t end) {
+  uint64_t bits =
+      view.Validity() == nullptr ? ~uint64_t{0u} : view.Validity()[begin / 64u];
+  if (end - begin < 64u) {
+    bits &= (uint64_t{1u} << (end - begin)) - 1u;
+  }
+  return bits;
+}
+
+// AccumulateRows() adds cells [begin, end) of a view, begin being a multiple of 64,
+// to accumulator
+template <typename T>
+void AccumulateRows(const ColumnView<T>& view, size_t begin, size_t end,
+                    Accumulator<T>& accumulator) {
+  const T* data = view.Data();
+  accumulator.num_rows += end - begin;
+  for (size_t word_begin = begin; word_begin < end; word_begin += 64u) {
+    auto bits = ValidBits(view, word_begin, std::min(word_begin + 64u, end));
+    if (bits == ~uint64_t{0u}) {
+      if (data != nullptr) {
+        accumulator.AddRun([data](size_t idx) { return data[idx]; }, word_begin, 64u);
+      } else {
+        accumulator.AddRun([&view](size_t idx) { return view[idx]; }, word_begin, 64u);
+      }
+      continue;
+    }
+    for (; bits != 0u; bits &= bits - 1u) {
+      accumulator.Add(view[word_begin + static_cast<size_t>(__builtin_ctzll(bits))]);
+    }
+  }
+}
+
+// file format of Save() and Load(), in native byte order
+constexpr char kFileMagic[8] = {'P', 'C', 'S', 'V', 'D', 'O', 'C', '\0'};
+constexpr uint32_t kFileVersion = 1u;
+// tells a file saved with another byte order
+constexpr uint32_t kByteOrderMark = 0x01020304u;
+
+// FileWriter writes the values of a saved Document, counting the bytes written
+class FileWriter {
+public:
+  explicit FileWriter(const std::string& path)
+      : path_(path), file_out_(path, std::ios::binary | std::ios::trunc), offset_(0u) {
+    if (!file_out_) {
+      throw std::runtime_error(std::string("Failed to open ") + path);
+    }
+  }
+
+  template <typename T>
+  void Write(T value) {
+    WriteBytes(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+  void WriteBytes(const char* data, size_t size) {
+    file_out_.write(data, static_cast<std::streamsize>(size));
+    offset_ += size;
+  }
+  void WriteString(const char* str, size_t str_length) {
+    Write(static_cast<uint64_t>(str_length));
+    WriteBytes(str, str_length);
+  }
+  void WriteZeros(size_t size) {
+    static const char zeros[64] = {};
+    for (; size > sizeof(zeros); size -= sizeof(zeros)) {
+      WriteBytes(zeros, sizeof(zeros));
+    }
+    WriteBytes(zeros, size);
+  }
+  // PadTo64() pads the file so that the next byte is 64 byte aligned
+  void PadTo64() { WriteZeros(Align64(offset_) - offset_); }
+  void Close() {
+    file_out_.close();
+    if (!file_out_) {
+      throw std::runtime_error(std::string("Failed to write ") + path_);
+    }
+  }
+
+private:
+  std::string path_;
+  std::ofstream file_out_;
+  size_t offset_;
+};
+
+// FileReader reads the values of a saved Document from its mapping
+class FileReader {
+public:
+  FileReader(const std::string& path, const MappedFile& file)
+      : path_(path), data_(file.MutableData()), size_(file.Size()), offset_(0u) {}
+
+  template <typename T>
+  T Read() {
+    T value;
+    std::memcpy(&value, ReadBytes(sizeof(T)), sizeof(T));
+    return value;
+  }
+  char* ReadBytes(size_t size) {
+    if (size > size_ - offset_) {
+      throw std::runtime_error(path_ + " is truncated");
+    }
+    char* bytes = data_ + offset_;
+    offset_ += size;
+    return bytes;
+  }
+  std::string ReadString() {
+    const auto str_length = Read<uint64_t>();
+    return std::string(ReadBytes(str_length), str_length);
+  }
+  void SkipTo64() { ReadBytes(std::min(Align64(offset_), size_) - offset_); }
+
+private:
+  std::string path_;
+  char* data_;
+  size_t size_;
+  size_t offset_;
+};
+
+// WriteRows() writes num_rows rows of row_stride bytes, of which the first row_size
+// are cells. Chunk memory isn't zeroed, so the bytes past them and the ones past
+// the '\0' of the STRING cells at string_offsets are written as zeros rather than
+// whatever the memory held before.
+void WriteRows(FileWriter& writer, const char* rows, size_t num_rows, size_t row_stride,
+               size_t row_size, const std::vector<size_t>& string_offsets) {
+  if (row_size == row_stride && string_offsets.empty()) {
+    writer.WriteBytes(rows, num_rows * row_stride);
+    return;
+  }
+  const size_t tile_rows = std::max(size_t{1u}, kTileBytes / row_stride);
+  std::vector<char> tile;
+  for (size_t begin_row = 0u; begin_row < num_rows; begin_row += tile_rows) {
+    const size_t end_row = std::min(begin_row + tile_rows, num_rows);
+    tile.assign((end_row - begin_row) * row_stride, '\0');
+    for (size_t row = begin_row; row < end_row; ++row) {
+      char* const tile_row = tile.data() + (row - begin_row) * row_stride;
+      std::memcpy(tile_row, rows + row * row_stride, row_size);
+      for (const auto string_offset : string_offsets) {
+        char* const cell = tile_row + string_offset;
+        const size_t str_length =
+            MemoryChunk::kMaxStringLength -
+            static_cast<unsigned char>(cell[MemoryChunk::kMaxStringLength]);
+        if (str_length + 1u < MemoryChunk::kMaxStringLength) {
+          std::memset(cell + str_length + 1u, 0,
+                      MemoryChunk::kMaxStringLength - str_length - 1u);
+        }
+      }
+    }
+    writer.WriteBytes(tile.data(), tile.size());
+  }
+}
+
 }  // namespace
 
 Document::Document(const std::vector<std::string>& field_names,
-                   const std::vector<FieldType>& field_types)
+                   const std::vector<FieldType>& field_types, Layout layout,
+                   std::shared_ptr<ChunkAllocator> allocator)
 
     : field_names_(field_names),
       num_cols_(field_names.size()),
+      layout_(layout),
       actual_row_byte_size_(Align64(GetTotalFieldTypeSize(field_types))),
+      allocator_(allocator ? std::move(allocator)
+                           : std::make_shared<PooledChunkAllocator>()),
       current_memory_chunk_(nullptr),
       current_row_offset_in_chunk_(0),
       num_threads_(1) {
+  for (size_t idx = 0u; idx < field_names_.size(); ++idx) {
+    column_indices_.emplace(field_names_[idx], idx);
+  }
   column_infos_.reserve(field_types.size());
   int offset = 0;
   for (const auto field_type : field_types) {
@@ -40,29 +347,108 @@ Document::Document(const std::vector<std::string>& field_names,
           ColumnInfo{FieldType::STRING, offset, MemoryChunk::kStringCellSize});
       offset += MemoryChunk::kStringCellSize;
       break;
+    case FieldType::VARSTRING:
+      column_infos_.push_back(ColumnInfo{FieldType::VARSTRING, offset,
+                                         FieldTypeHelper<FieldType::VARSTRING>::size});
+      offset += FieldTypeHelper<FieldType::VARSTRING>::size;
+      break;
+    case FieldType::CATEGORY:
+      column_infos_.push_back(ColumnInfo{FieldType::CATEGORY, offset,
+                                         FieldTypeHelper<FieldType::CATEGORY>::size});
+      offset += FieldTypeHelper<FieldType::CATEGORY>::size;
+      break;
     default:
       break;
     }
   }
+  dictionaries_.resize(column_infos_.size());
 }
 
 void Document::Write(size_t row, size_t column, const char* str, size_t str_length) {
-  const int row_idx_in_chunk = row - current_row_offset_in_chunk_;
+  const size_t row_idx_in_chunk = row - current_row_offset_in_chunk_;
+  WriteCell(*current_memory_chunk_, dictionaries_, row_idx_in_chunk, column, str,
+            str_length);
+}
+
+void Document::WriteToChunk(size_t chunk_index, size_t row_in_chunk, size_t column,
+                            const char* str, size_t str_length) {
+  auto& document_memory_chunk = buffer_[chunk_index];
+  WriteCell(document_memory_chunk, document_memory_chunk.dictionaries, row_in_chunk,
+            column, str, str_length);
+}
+
+void Document::FinishChunk(size_t chunk_index) {
+  auto& document_memory_chunk = buffer_[chunk_index];
+  if (document_memory_chunk.dictionaries.empty()) {
+    return;
+  }
+  const auto chunk = document_memory_chunk.chunk.get();
+  std::vector<int32_t> codes;
+  for (size_t column = 0u; column < column_infos_.size(); ++column) {
+    const auto& local_dictionary = document_memory_chunk.dictionaries[column];
+    if (column_infos_[column].type != FieldType::CATEGORY ||
+        local_dictionary.Size() == 0u) {
+      continue;
+    }
+    // local code -> document code
+    codes.resize(local_dictionary.Size());
+    for (size_t code = 0u; code < codes.size(); ++code) {
+      const auto value = local_dictionary.Get(static_cast<int32_t>(code));
+      codes[code] = dictionaries_[column].Intern(value.data, value.size);
+    }
+    for (size_t row = 0u; row < document_memory_chunk.num_rows; ++row) {
+      const auto offset = CellOffset(document_memory_chunk, row, column);
+      chunk->Write(offset, codes[chunk->ReadInt32(offset)]);
+    }
+  }
+  std::vector<CategoryDictionary>().swap(document_memory_chunk.dictionaries);
+}
+
+void Document::ShrinkChunk(size_t chunk_index, size_t num_rows) {
+  auto& document_memory_chunk = buffer_[chunk_index];
+  if (num_rows > document_memory_chunk.num_rows) {
+    throw std::invalid_argument(std::string("can't grow chunk ") +
+                                std::to_string(chunk_index) + " to " +
+                                std::to_string(num_rows) + " rows");
+  }
+  document_memory_chunk.num_rows = num_rows;
+}
+
+void Document::WriteCell(DocumentMemoryChunk& document_memory_chunk,
+                         std::vector<CategoryDictionary>& dictionaries,
+                         size_t row_in_chunk, size_t column, const char* str,
+                         size_t str_length) {
   const auto& column_info = column_infos_[column];
-  const auto chunk_offset = row_idx_in_chunk * actual_row_byte_size_ + column_info.offset;
+  const auto chunk_offset = CellOffset(document_memory_chunk, row_in_chunk, column);
+  const auto chunk = document_memory_chunk.chunk.get();
+  if (str_length != 0u) {
+    document_memory_chunk
+        .validity[column * document_memory_chunk.validity_words + row_in_chunk / 64] |=
+        uint64_t{1u} << (row_in_chunk % 64);
+  }
   switch (column_info.type) {
   case FieldType::INT64: {
     auto value = str_length == 0 ? 0u : Convert<int64_t>(str, str_length);
-    current_memory_chunk_->Write(chunk_offset, value);
+    chunk->Write(chunk_offset, value);
     break;
   }
   case FieldType::DOUBLE: {
     auto value = str_length == 0 ? 0u : Convert<double>(str, str_length);
-    current_memory_chunk_->Write(chunk_offset, value);
+    chunk->Write(chunk_offset, value);
     break;
   }
   case FieldType::STRING:
-    current_memory_chunk_->Write(chunk_offset, str, str_length);
+    chunk->Write(chunk_offset, str, str_length);
+    break;
+  case FieldType::VARSTRING:
+    chunk->Write(chunk_offset, document_memory_chunk.arena.Append(str, str_length));
+    break;
+  case FieldType::CATEGORY:
+    if (dictionaries.empty()) {
+      dictionaries.resize(num_cols_);
+    }
+    chunk->Write(chunk_offset, dictionaries[column].Intern(str, str_length));
+    break;
   default:
     break;
   }
@@ -71,55 +457,143 @@ void Document::Write(size_t row, size_t column, const char* str, size_t str_leng
 template <typename T>
 void Document::Get(const std::string& column, std::vector<T>& column_result) const {
   static_assert(std::is_same<T, int64_t>::value || std::is_same<T, double>::value ||
-                    std::is_same<T, std::string>::value,
-                "Given type must be one of int64_t, double, std::string");
+                    std::is_same<T, std::string>::value ||
+                    std::is_same<T, int32_t>::value,
+                "Given type must be one of int64_t, double, std::string, int32_t");
   assert(column_result.size() == this->NumRows());
-  int column_index = -1;
-  for (int idx = 0; idx < static_cast<int>(field_names_.size()); idx++) {
-    if (field_names_[idx] == column) {
-      column_index = idx;
-      break;
+  const auto column_index = ColumnIndex(column);
+  const auto& column_info = column_infos_[column_index];
+  if (!GetMatches<T>(column_info.type)) {
+    throw std::invalid_argument(std::string("can't get column ") + column +
+                                " as a column of another type");
+  }
+  const auto& dictionary = dictionaries_[column_index];
+  const size_t row_stride = layout_ == Layout::ROW
+                                ? actual_row_byte_size_
+                                : static_cast<size_t>(column_info.size);
+  // blocks of rows of every chunk, read by a single parallel loop
+  struct RowBlock {
+    const DocumentMemoryChunk* chunk;
+    size_t begin_row;
+    size_t end_row;
+    size_t row_offset;
+  };
+  std::vector<RowBlock> row_blocks;
+  size_t row_offset = 0u;
+  for (const auto& document_memory_chunk : buffer_) {
+    const auto num_rows = document_memory_chunk.num_rows;
+    if (num_rows == 0u) {
+      continue;
+    }
+    if (layout_ == Layout::COLUMN && static_cast<size_t>(column_info.size) == sizeof(T) &&
+        CopyContiguous(document_memory_chunk.chunk->ReadCharPtr(
+                           CellOffset(document_memory_chunk, 0u, column_index)),
+                       num_rows, &column_result[row_offset])) {
+      row_offset += num_rows;
+      continue;
     }
+    for (size_t begin_row = 0u; begin_row < num_rows; begin_row += kRowsPerBlock) {
+      row_blocks.push_back(RowBlock{&document_memory_chunk, begin_row,
+                                    std::min(begin_row + kRowsPerBlock, num_rows),
+                                    row_offset + begin_row});
+    }
+    row_offset += num_rows;
   }
 
-  if (column_index < 0) {
-    throw std::invalid_argument(std::string("no column with name ") + column);
+  Pool().ParallelFor(row_blocks.size(), num_threads_, [&](size_t idx) {
+    const auto& row_block = row_blocks[idx];
+    const auto& document_memory_chunk = *row_block.chunk;
+    const auto column_start = CellOffset(document_memory_chunk, 0u, column_index);
+    for (size_t row = row_block.begin_row; row < row_block.end_row; ++row) {
+      column_result[row - row_block.begin_row + row_block.row_offset] =
+          ReadCell<T>(*document_memory_chunk.chunk, document_memory_chunk.arena,
+                      dictionary, column_info.type, column_start + row * row_stride);
+    }
+  });
+}
+
+size_t Document::AddChunk(size_t num_rows) {
+  AppendChunk(NewChunk(num_rows));
+  return buffer_.size() - 1;
+}
+
+Document::ChunkWriter Document::ReserveChunk(size_t num_rows, uint64_t sequence) {
+  std::unique_ptr<ReservedChunk> reserved(
+      new ReservedChunk{sequence, NewChunk(num_rows), nullptr});
+  reserved_chunks_.Push(reserved.get());
+  return ChunkWriter(this, reserved.release());
+}
+
+void Document::StitchChunks() {
+  std::vector<std::unique_ptr<ReservedChunk>> reserved_chunks;
+  for (auto reserved = reserved_chunks_.TakeAll(); reserved != nullptr;) {
+    const auto next = reserved->next;
+    reserved_chunks.emplace_back(reserved);
+    reserved = next;
+  }
+  std::sort(reserved_chunks.begin(), reserved_chunks.end(),
+            [](const std::unique_ptr<ReservedChunk>& lhs,
+               const std::unique_ptr<ReservedChunk>& rhs) {
+              return lhs->sequence < rhs->sequence;
+            });
+  buffer_.reserve(buffer_.size() + reserved_chunks.size());
+  for (auto& reserved : reserved_chunks) {
+    AppendChunk(std::move(reserved->chunk));
+    // in sequence order, so CATEGORY codes don't depend on thread timing
+    FinishChunk(buffer_.size() - 1);
   }
+}
 
-  const auto& column_info = column_infos_[column_index];
-  const auto column_offset = column_info.offset;
-  auto row_offset = 0u;
-  // use multi thread
-  if (num_threads_ > 1) {
-    for (const auto& document_memory_chunk : buffer_) {
-      auto current_chunk = document_memory_chunk.chunk.get();
-      omp_set_num_threads(num_threads_);
-#pragma omp parallel for
-      for (size_t row = 0u; row < document_memory_chunk.num_rows; ++row) {
-        column_result[row + row_offset] =
-            current_chunk->Read<T>(row * actual_row_byte_size_ + column_offset);
-      }
-      row_offset += document_memory_chunk.num_rows;
-    }
-  } else {
-    for (const auto& document_memory_chunk : buffer_) {
-      auto current_chunk = document_memory_chunk.chunk.get();
-      for (size_t row = 0u; row < document_memory_chunk.num_rows; ++row) {
-        column_result[row + row_offset] =
-            current_chunk->Read<T>(row * actual_row_byte_size_ + column_offset);
-      }
-      row_offset += document_memory_chunk.num_rows;
+void Document::ChunkWriter::Shrink(size_t num_rows) {
+  if (num_rows > chunk_->chunk.num_rows) {
+    throw std::invalid_argument(std::string("can't grow reserved chunk ") +
+                                std::to_string(chunk_->sequence) + " to " +
+                                std::to_string(num_rows) + " rows");
+  }
+  chunk_->chunk.num_rows = num_rows;
+}
+
+Document::DocumentMemoryChunk Document::NewChunk(size_t num_rows) const {
+  std::vector<size_t> column_offsets;
+  size_t chunk_size = num_rows * actual_row_byte_size_;
+  if (layout_ == Layout::COLUMN) {
+    // every column array starts on its own cache line
+    column_offsets.reserve(column_infos_.size());
+    chunk_size = 0u;
+    for (const auto& column_info : column_infos_) {
+      column_offsets.push_back(chunk_size);
+      chunk_size += Align64(num_rows * column_info.size);
     }
   }
+  std::unique_ptr<MemoryChunk> new_memory_chunk(new MemoryChunk(chunk_size, allocator_));
+  const size_t validity_words = (num_rows + 63) / 64;
+  return DocumentMemoryChunk{
+      std::move(new_memory_chunk), num_rows, std::move(column_offsets), StringArena(),
+      std::vector<CategoryDictionary>(), validity_words,
+      std::vector<uint64_t>(validity_words * column_infos_.size(), 0u)};
 }
 
-void Document::AddChunk(size_t num_rows) {
-  std::unique_ptr<MemoryChunk> new_memory_chunk(
-      new MemoryChunk(num_rows * actual_row_byte_size_));
+void Document::AppendChunk(DocumentMemoryChunk&& chunk) {
   const size_t last_chunk_size = buffer_.empty() ? 0u : buffer_.back().num_rows;
-  buffer_.push_back(DocumentMemoryChunk{std::move(new_memory_chunk), num_rows});
+  buffer_.push_back(std::move(chunk));
   current_row_offset_in_chunk_ += last_chunk_size;
-  current_memory_chunk_ = buffer_.back().chunk.get();
+  current_memory_chunk_ = &buffer_.back();
+}
+
+void Document::Clear() {
+  buffer_.clear();
+  reserved_chunks_ = ReservedChunks();
+  std::vector<CategoryDictionary>(column_infos_.size()).swap(dictionaries_);
+  current_memory_chunk_ = nullptr;
+  current_row_offset_in_chunk_ = 0;
+}
+
+size_t Document::ColumnIndex(const std::string& column) const {
+  const auto found = column_indices_.find(column);
+  if (found == column_indices_.end()) {
+    throw std::invalid_argument(std::string("no column with name ") + column);
+  }
+  return found->second;
 }
 
 size_t Document::NumRows() const {
@@ -175,6 +649,560 @@ void Document::GetAsDouble(const std::string& column, std::vector<double>& resul
   this->Get<double>(column, result);
 }
 
+std::vector<int32_t> Document::GetCategoryCodes(const std::string& column) const {
+  Dictionary(column);
+  std::vector<int32_t> column_result(this->NumRows());
+  this->Get<int32_t>(column, column_result);
+  return column_result;
+}
+
+void Document::GetCategoryCodes(const std::string& column,
+                                std::vector<int32_t>& result) const {
+  Dictionary(column);
+  if (result.size() != this->NumRows()) {
+    throw std::invalid_argument(
+        std::string("given output vector of size ") + std::to_string(result.size()) +
+        "doesn't match with row count " + std::to_string(this->NumRows()));
+  }
+  this->Get<int32_t>(column, result);
+}
+
+std::vector<bool> Document::GetValidity(const std::string& column) const {
+  const auto column_index = ColumnIndex(column);
+  std::vector<bool> validity;
+  validity.reserve(NumRows());
+  for (const auto& document_memory_chunk : buffer_) {
+    const auto bitmap = document_memory_chunk.Validity(column_index);
+    for (size_t row = 0u; row < document_memory_chunk.num_rows; ++row) {
+      validity.push_back(((bitmap[row / 64] >> (row % 64)) & 1u) != 0u);
+    }
+  }
+  return validity;
+}
+
+size_t Document::NullCount(const std::string& column) const {
+  const auto column_index = ColumnIndex(column);
+  size_t num_valid = 0u;
+  for (const auto& document_memory_chunk : buffer_) {
+    const auto bitmap = document_memory_chunk.Validity(column_index);
+    const auto num_rows = document_memory_chunk.num_rows;
+    for (size_t word = 0u; word < num_rows / 64; ++word) {
+      num_valid += static_cast<size_t>(__builtin_popcountll(bitmap[word]));
+    }
+    if (num_rows % 64 != 0u) {
+      const uint64_t last_bits = (uint64_t{1u} << (num_rows % 64)) - 1u;
+      num_valid +=
+          static_cast<size_t>(__builtin_popcountll(bitmap[num_rows / 64] & last_bits));
+    }
+  }
+  return NumRows() - num_valid;
+}
+
+void Document::GetColumns(const ColumnBatch& batch) const {
+  using Kind = ColumnBatch::Kind;
+  struct BatchColumn {
+    size_t column_index;
+    Kind kind;
+    // data of the output vector
+    void* data;
+  };
+  std::vector<BatchColumn> columns;
+  columns.reserve(batch.entries_.size());
+  for (const auto& entry : batch.entries_) {
+    const auto column_index = ColumnIndex(entry.column);
+    const auto type = column_infos_[column_index].type;
+    bool matches = false;
+    switch (entry.kind) {
+    case Kind::INT64:
+      matches = GetMatches<int64_t>(type);
+      break;
+    case Kind::DOUBLE:
+      matches = GetMatches<double>(type);
+      break;
+    case Kind::STRING:
+      matches = GetMatches<std::string>(type);
+      break;
+    case Kind::CATEGORY_CODES:
+      matches = GetMatches<int32_t>(type);
+      break;
+    }
+    if (!matches) {
+      throw std::invalid_argument(std::string("can't get column ") + entry.column +
+                                  " as a column of another type");
+    }
+    columns.push_back(BatchColumn{column_index, entry.kind, nullptr});
+  }
+  const auto num_rows = NumRows();
+  for (size_t idx = 0u; idx < columns.size(); ++idx) {
+    auto& column = columns[idx];
+    auto output = batch.entries_[idx].output;
+    switch (column.kind) {
+    case Kind::INT64:
+      static_cast<std::vector<int64_t>*>(output)->resize(num_rows);
+      column.data = static_cast<std::vector<int64_t>*>(output)->data();
+      break;
+    case Kind::DOUBLE:
+      static_cast<std::vector<double>*>(output)->resize(num_rows);
+      column.data = static_cast<std::vector<double>*>(output)->data();
+      break;
+    case Kind::STRING:
+      static_cast<std::vector<std::string>*>(output)->resize(num_rows);
+      column.data = static_cast<std::vector<std::string>*>(output)->data();
+      break;
+    case Kind::CATEGORY_CODES:
+      static_cast<std::vector<int32_t>*>(output)->resize(num_rows);
+      column.data = static_cast<std::vector<int32_t>*>(output)->data();
+      break;
+    }
+  }
+  if (columns.empty()) {
+    return;
+  }
+
+  // Row blocks are tiled so that a tile of rows stays in cache while each column
+  // is copied out of it in turn. The cells of a column of Layout::COLUMN are
+  // contiguous already, so its blocks are copied whole.
+  const size_t tile_rows =
+      layout_ == Layout::ROW
+          ? std::max(size_t{1u},
+                     std::min(kRowsPerBlock, kTileBytes / actual_row_byte_size_))
+          : kRowsPerBlock;
+  struct RowBlock {
+    const DocumentMemoryChunk* chunk;
+    size_t begin_row;
+    size_t end_row;
+    size_t row_offset;
+  };
+  std::vector<RowBlock> row_blocks;
+  size_t row_offset = 0u;
+  for (const auto& document_memory_chunk : buffer_) {
+    const auto chunk_rows = document_memory_chunk.num_rows;
+    for (size_t begin_row = 0u; begin_row < chunk_rows; begin_row += kRowsPerBlock) {
+      row_blocks.push_back(RowBlock{&document_memory_chunk, begin_row,
+                                    std::min(begin_row + kRowsPerBlock, chunk_rows),
+                                    row_offset + begin_row});
+    }
+    row_offset += chunk_rows;
+  }
+
+  Pool().ParallelFor(row_blocks.size(), num_threads_, [&](size_t idx) {
+    const auto& row_block = row_blocks[idx];
+    const auto& document_memory_chunk = *row_block.chunk;
+    const auto& chunk = *document_memory_chunk.chunk;
+    const auto& arena = document_memory_chunk.arena;
+    for (size_t begin_row = row_block.begin_row; begin_row < row_block.end_row;
+         begin_row += tile_rows) {
+      const auto end_row = std::min(begin_row + tile_rows, row_block.end_row);
+      const auto output_row = begin_row - row_block.begin_row + row_block.row_offset;
+      for (const auto& column : columns) {
+        const auto& column_info = column_infos_[column.column_index];
+        const auto& dictionary = dictionaries_[column.column_index];
+        const auto first_cell =
+            CellOffset(document_memory_chunk, 0u, column.column_index);
+        const size_t row_stride = layout_ == Layout::ROW
+                                      ? actual_row_byte_size_
+                                      : static_cast<size_t>(column_info.size);
+        switch (column.kind) {
+        case Kind::INT64:
+          ReadRows(chunk, arena, dictionary, column_info.type, first_cell, row_stride,
+                   begin_row, end_row, static_cast<int64_t*>(column.data) + output_row);
+          break;
+        case Kind::DOUBLE:
+          ReadRows(chunk, arena, dictionary, column_info.type, first_cell, row_stride,
+                   begin_row, end_row, static_cast<double*>(column.data) + output_row);
+          break;
+        case Kind::STRING:
+          ReadRows(chunk, arena, dictionary, column_info.type, first_cell, row_stride,
+                   begin_row, end_row,
+                   static_cast<std::string*>(column.data) + output_row);
+          break;
+        case Kind::CATEGORY_CODES:
+          ReadRows(chunk, arena, dictionary, column_info.type, first_cell, row_stride,
+                   begin_row, end_row, static_cast<int32_t*>(column.data) + output_row);
+          break;
+        }
+      }
+    }
+  });
+}
+
+std::vector<Document::ChunkRows> Document::ChunkRowBlocks() const {
+  std::vector<ChunkRows> row_blocks;
+  for (size_t chunk_index = 0u; chunk_index < buffer_.size(); ++chunk_index) {
+    const auto chunk_rows = buffer_[chunk_index].num_rows;
+    for (size_t begin_row = 0u; begin_row < chunk_rows; begin_row += kRowsPerBlock) {
+      row_blocks.push_back(ChunkRows{chunk_index, begin_row,
+                                     std::min(begin_row + kRowsPerBlock, chunk_rows)});
+    }
+  }
+  return row_blocks;
+}
+
+template <typename T>
+ColumnAggregate<T> Document::Aggregate(const std::string& column) const {
+  const auto column_index = ColumnIndex(column);
+  if (!ViewTypeHelper<T>::Matches(column_infos_[column_index].type)) {
+    throw std::invalid_argument(std::string("can't aggregate column ") + column +
+                                " of another type");
+  }
+  const auto row_blocks = ChunkRowBlocks();
+
+  std::vector<Accumulator<T>> partials(row_blocks.size());
+  Pool().ParallelFor(row_blocks.size(), num_threads_, [&](size_t idx) {
+    const auto& row_block = row_blocks[idx];
+    AccumulateRows(GetColumnView<T>(column_index, row_block.chunk_index),
+                   row_block.begin_row, row_block.end_row, partials[idx]);
+  });
+  Accumulator<T> accumulator;
+  for (const auto& partial : partials) {
+    accumulator.Merge(partial);
+  }
+  return accumulator.Result();
+}
+
+template <typename T>
+std::map<std::string, ColumnAggregate<T>> Document::AggregateBy(
+    const std::string& column, const std::string& key_column) const {
+  const auto column_index = ColumnIndex(column);
+  if (!ViewTypeHelper<T>::Matches(column_infos_[column_index].type)) {
+    throw std::invalid_argument(std::string("can't aggregate column ") + column +
+                                " of another type");
+  }
+  const auto key_index = ColumnIndex(key_column);
+  const auto key_type = column_infos_[key_index].type;
+  const bool category_keys = key_type == FieldType::CATEGORY;
+  if (!category_keys && key_type != FieldType::STRING &&
+      key_type != FieldType::VARSTRING) {
+    throw std::invalid_argument(std::string("can't group by column ") + key_column +
+                                ", which isn't STRING, VARSTRING or CATEGORY");
+  }
+  const auto row_blocks = ChunkRowBlocks();
+
+  // Groups of a block are indexed by key code: the code of a CATEGORY key, or the
+  // code a string key gets in a dictionary of the block's own.
+  struct Partial {
+    CategoryDictionary keys;
+    std::vector<Accumulator<T>> groups;
+  };
+  std::vector<Partial> partials(row_blocks.size());
+  Pool().ParallelFor(row_blocks.size(), num_threads_, [&](size_t idx) {
+    const auto& row_block = row_blocks[idx];
+    auto& partial = partials[idx];
+    const auto view = GetColumnView<T>(column_index, row_block.chunk_index);
+    const auto category_view =
+        category_keys ? GetColumnView<int32_t>(key_index, row_block.chunk_index)
+                      : ColumnView<int32_t>();
+    const auto string_view =
+        category_keys ? ColumnView<StringRef>()
+                      : GetColumnView<StringRef>(key_index, row_block.chunk_index);
+    for (size_t row = row_block.begin_row; row < row_block.end_row; ++row) {
+      size_t code = 0u;
+      if (category_keys) {
+        code = static_cast<size_t>(category_view[row]);
+      } else {
+        const auto key = string_view[row];
+        code = static_cast<size_t>(partial.keys.Intern(key.data, key.size));
+      }
+      if (code >= partial.groups.size()) {
+        partial.groups.resize(code + 1u);
+      }
+      auto& group = partial.groups[code];
+      ++group.num_rows;
+      if (view.IsValid(row)) {
+        group.Add(view[row]);
+      }
+    }
+  });
+
+  CategoryDictionary keys;
+  std::vector<Accumulator<T>> groups;
+  for (const auto& partial : partials) {
+    for (size_t code = 0u; code < partial.groups.size(); ++code) {
+      size_t merged_code = code;
+      if (!category_keys) {
+        const auto key = partial.keys.Get(static_cast<int32_t>(code));
+        merged_code = static_cast<size_t>(keys.Intern(key.data, key.size));
+      }
+      if (merged_code >= groups.size()) {
+        groups.resize(merged_code + 1u);
+      }
+      groups[merged_code].Merge(partial.groups[code]);
+    }
+  }
+  const auto& key_dictionary = category_keys ? dictionaries_[key_index] : keys;
+  std::map<std::string, ColumnAggregate<T>> result;
+  for (size_t code = 0u; code < groups.size(); ++code) {
+    // a CATEGORY value of no row, e.g. of a cleared one
+    if (groups[code].num_rows == 0u) {
+      continue;
+    }
+    result.emplace(key_dictionary.Get(static_cast<int32_t>(code)).ToString(),
+                   groups[code].Result());
+  }
+  return result;
+}
+
+ColumnAggregate<int64_t> Document::AggregateInt64(const std::string& column) const {
+  return Aggregate<int64_t>(column);
+}
+
+ColumnAggregate<double> Document::AggregateDouble(const std::string& column) const {
+  return Aggregate<double>(column);
+}
+
+std::map<std::string, ColumnAggregate<int64_t>> Document::AggregateInt64By(
+    const std::string& column, const std::string& key_column) const {
+  return AggregateBy<int64_t>(column, key_column);
+}
+
+std::map<std::string, ColumnAggregate<double>> Document::AggregateDoubleBy(
+    const std::string& column, const std::string& key_column) const {
+  return AggregateBy<double>(column, key_column);
+}
+
+const CategoryDictionary& Document::Dictionary(const std::string& column) const {
+  const auto column_index = ColumnIndex(column);
+  if (column_infos_[column_index].type != FieldType::CATEGORY) {
+    throw std::invalid_argument(std::string("not a CATEGORY column ") + column);
+  }
+  return dictionaries_[column_index];
+}
+
+void Document::Save(const std::string& path, const std::string& tag) const {
+  FileWriter writer(path);
+  writer.WriteBytes(kFileMagic, sizeof(kFileMagic));
+  writer.Write(kFileVersion);
+  writer.Write(kByteOrderMark);
+  writer.Write(static_cast<uint32_t>(layout_));
+  writer.WriteString(tag.data(), tag.size());
+
+  writer.Write(static_cast<uint64_t>(column_infos_.size()));
+  for (size_t column = 0u; column < column_infos_.size(); ++column) {
+    writer.Write(static_cast<uint32_t>(column_infos_[column].type));
+    writer.WriteString(field_names_[column].data(), field_names_[column].size());
+  }
+  for (size_t column = 0u; column < column_infos_.size(); ++column) {
+    if (column_infos_[column].type != FieldType::CATEGORY) {
+      continue;
+    }
+    // in code order, so that Load() interns the same codes
+    const auto& dictionary = dictionaries_[column];
+    writer.Write(static_cast<uint64_t>(dictionary.Size()));
+    for (size_t code = 0u; code < dictionary.Size(); ++code) {
+      const auto value = dictionary.Get(static_cast<int32_t>(code));
+      writer.WriteString(value.data, value.size);
+    }
+  }
+
+  writer.Write(static_cast<uint64_t>(buffer_.size()));
+  for (size_t chunk_index = 0u; chunk_index < buffer_.size(); ++chunk_index) {
+    const auto& document_memory_chunk = buffer_[chunk_index];
+    if (!document_memory_chunk.dictionaries.empty()) {
+      throw std::logic_error(std::string("can't save unfinished chunk ") +
+                             std::to_string(chunk_index));
+    }
+    // a reused spare chunk may be bigger than its cells
+    size_t chunk_size = document_memory_chunk.num_rows * actual_row_byte_size_;
+    if (layout_ == Layout::COLUMN) {
+      chunk_size = column_infos_.empty()
+                       ? 0u
+                       : document_memory_chunk.column_offsets.back() +
+                             document_memory_chunk.num_rows * column_infos_.back().size;
+    }
+    writer.Write(static_cast<uint64_t>(document_memory_chunk.num_rows));
+    writer.Write(static_cast<uint64_t>(chunk_size));
+    for (const auto column_offset : document_memory_chunk.column_offsets) {
+      writer.Write(static_cast<uint64_t>(column_offset));
+    }
+    writer.Write(static_cast<uint64_t>(document_memory_chunk.validity_words));
+    writer.WriteBytes(
+        reinterpret_cast<const char*>(document_memory_chunk.validity.data()),
+        document_memory_chunk.validity.size() * sizeof(uint64_t));
+    const auto& arena = document_memory_chunk.arena;
+    writer.WriteString(arena.Size() == 0u ? nullptr : arena.Data(0u), arena.Size());
+    writer.PadTo64();
+    const char* const cells = document_memory_chunk.chunk->ReadCharPtr(0u);
+    const auto num_rows = document_memory_chunk.num_rows;
+    if (layout_ == Layout::ROW) {
+      std::vector<size_t> string_offsets;
+      for (const auto& column_info : column_infos_) {
+        if (column_info.type == FieldType::STRING) {
+          string_offsets.push_back(static_cast<size_t>(column_info.offset));
+        }
+      }
+      const size_t row_size =
+          column_infos_.empty() ? 0u
+                                : static_cast<size_t>(column_infos_.back().offset +
+                                                      column_infos_.back().size);
+      WriteRows(writer, cells, num_rows, actual_row_byte_size_, row_size, string_offsets);
+      continue;
+    }
+    // columns are followed by the cells of the rows the chunk was reserved for
+    // beyond num_rows, up to the next column
+    for (size_t column = 0u; column < column_infos_.size(); ++column) {
+      const auto cell_size = static_cast<size_t>(column_infos_[column].size);
+      const auto column_offset = document_memory_chunk.column_offsets[column];
+      WriteRows(writer, cells + column_offset, num_rows, cell_size, cell_size,
+                column_infos_[column].type == FieldType::STRING ? std::vector<size_t>{0u}
+                                                                : std::vector<size_t>());
+      const auto column_end = column + 1u < column_infos_.size()
+                                  ? document_memory_chunk.column_offsets[column + 1u]
+                                  : chunk_size;
+      writer.WriteZeros(column_end - column_offset - num_rows * cell_size);
+    }
+  }
+  writer.Close();
+}
+
+Document Document::Load(const std::string& path, const std::string& expected_tag,
+                        std::shared_ptr<ChunkAllocator> allocator) {
+  // chunks share the mapping, which lives as long as any of them
+  std::shared_ptr<MappedFile> file(new MappedFile(path, true));
+  FileReader reader(path, *file);
+  if (file->Size() < sizeof(kFileMagic) ||
+      std::memcmp(reader.ReadBytes(sizeof(kFileMagic)), kFileMagic,
+                  sizeof(kFileMagic)) != 0) {
+    throw std::runtime_error(path + " is not a saved Document");
+  }
+  const auto version = reader.Read<uint32_t>();
+  if (version != kFileVersion || reader.Read<uint32_t>() != kByteOrderMark) {
+    throw std::runtime_error(path + " was saved by an incompatible version");
+  }
+  const auto layout_value = reader.Read<uint32_t>();
+  if (layout_value > static_cast<uint32_t>(Layout::COLUMN)) {
+    throw std::runtime_error(path + " has an unknown layout");
+  }
+  const auto layout = static_cast<Layout>(layout_value);
+  const auto tag = reader.ReadString();
+  if (!expected_tag.empty() && tag != expected_tag) {
+    throw std::runtime_error(path + " has tag " + tag + " instead of " + expected_tag);
+  }
+
+  const auto num_columns = reader.Read<uint64_t>();
+  std::vector<std::string> field_names;
+  std::vector<FieldType> field_types;
+  for (uint64_t column = 0u; column < num_columns; ++column) {
+    const auto type = reader.Read<uint32_t>();
+    if (type >= static_cast<uint32_t>(FieldType::SKIP)) {
+      throw std::runtime_error(path + " has a column of unknown type");
+    }
+    field_types.push_back(static_cast<FieldType>(type));
+    field_names.push_back(reader.ReadString());
+  }
+  Document doc(field_names, field_types, layout, std::move(allocator));
+  const auto corrupt = [&path](const std::string& what) {
+    return std::runtime_error(path + " is corrupt: " + what);
+  };
+  for (size_t column = 0u; column < field_types.size(); ++column) {
+    if (field_types[column] != FieldType::CATEGORY) {
+      continue;
+    }
+    const auto num_values = reader.Read<uint64_t>();
+    for (uint64_t code = 0u; code < num_values; ++code) {
+      const auto value = reader.ReadString();
+      // a value saved twice would shift the codes of every later one
+      if (static_cast<uint64_t>(doc.dictionaries_[column].Intern(
+              value.data(), value.size())) != code) {
+        throw corrupt("dictionary of " + field_names[column]);
+      }
+    }
+  }
+
+  // sizes and offsets are checked before anything is read through them, so that a
+  // corrupt file throws rather than being read out of bounds
+  const auto num_chunks = reader.Read<uint64_t>();
+  for (uint64_t chunk_index = 0u; chunk_index < num_chunks; ++chunk_index) {
+    const auto num_rows = reader.Read<uint64_t>();
+    const auto chunk_size = reader.Read<uint64_t>();
+    // a row takes at least a byte of cells
+    if (!field_types.empty() && num_rows > file->Size()) {
+      throw corrupt("row count");
+    }
+    std::vector<size_t> column_offsets;
+    if (layout == Layout::COLUMN) {
+      // column arrays are 64 byte aligned, in column order, and end the chunk
+      size_t columns_end = 0u;
+      for (size_t column = 0u; column < field_types.size(); ++column) {
+        const auto column_offset = reader.Read<uint64_t>();
+        if (column_offset % 64u != 0u || column_offset < columns_end ||
+            column_offset > chunk_size) {
+          throw corrupt("column offset");
+        }
+        column_offsets.push_back(column_offset);
+        columns_end = column_offset + num_rows * doc.column_infos_[column].size;
+      }
+      if (columns_end != chunk_size) {
+        throw corrupt("chunk size");
+      }
+    } else if (chunk_size != num_rows * doc.actual_row_byte_size_) {
+      throw corrupt("chunk size");
+    }
+    const auto validity_words = reader.Read<uint64_t>();
+    if (validity_words < (num_rows + 63u) / 64u ||
+        validity_words >
+            file->Size() / sizeof(uint64_t) / std::max<size_t>(1u, num_columns)) {
+      throw corrupt("validity size");
+    }
+    const auto validity_size = validity_words * field_types.size();
+    const char* validity_bytes = reader.ReadBytes(validity_size * sizeof(uint64_t));
+    std::vector<uint64_t> validity(validity_size);
+    std::memcpy(validity.data(), validity_bytes, validity_size * sizeof(uint64_t));
+    StringArena arena;
+    const auto arena_size = reader.Read<uint64_t>();
+    arena.Append(reader.ReadBytes(arena_size), arena_size);
+    reader.SkipTo64();
+    std::unique_ptr<MemoryChunk> chunk(
+        new MemoryChunk(reader.ReadBytes(chunk_size), chunk_size, file));
+
+    DocumentMemoryChunk document_memory_chunk{
+        std::move(chunk), num_rows, std::move(column_offsets), std::move(arena),
+        std::vector<CategoryDictionary>(), validity_words, std::move(validity)};
+    if (!doc.CellsValid(document_memory_chunk)) {
+      throw corrupt(std::string("cells of chunk ") + std::to_string(chunk_index));
+    }
+    doc.AppendChunk(std::move(document_memory_chunk));
+  }
+  return doc;
+}
+
+bool Document::CellsValid(const DocumentMemoryChunk& document_memory_chunk) const {
+  const auto& chunk = *document_memory_chunk.chunk;
+  for (size_t column = 0u; column < column_infos_.size(); ++column) {
+    const auto type = column_infos_[column].type;
+    for (size_t row = 0u; row < document_memory_chunk.num_rows; ++row) {
+      const auto offset =
+          static_cast<int>(CellOffset(document_memory_chunk, row, column));
+      switch (type) {
+      case FieldType::STRING:
+        // the last byte holds kMaxStringLength - length
+        if (static_cast<unsigned char>(*chunk.ReadCharPtr(
+                offset + static_cast<int>(MemoryChunk::kMaxStringLength))) >
+            MemoryChunk::kMaxStringLength) {
+          return false;
+        }
+        break;
+      case FieldType::VARSTRING: {
+        const auto slot = chunk.ReadStringSlot(offset);
+        if (uint64_t{slot.offset} + slot.size > document_memory_chunk.arena.Size()) {
+          return false;
+        }
+        break;
+      }
+      case FieldType::CATEGORY: {
+        const auto code = chunk.ReadInt32(offset);
+        if (code < 0 || static_cast<size_t>(code) >= dictionaries_[column].Size()) {
+          return false;
+        }
+        break;
+      }
+      default:
+        break;
+      }
+    }
+  }
+  return true;
+}
+
 void Document::Dump(std::ostream& os) const {
   for (size_t i = 0; i < field_names_.size(); i++) {
     if (i != 0) {
@@ -190,8 +1218,13 @@ void Document::Dump(std::ostream& os) const {
         if (column_idx != 0) {
           os << ',';
         }
+        // nulls are dumped as the empty cells they were
+        const auto validity = one_buffer.Validity(column_idx);
+        if (((validity[row_idx / 64] >> (row_idx % 64)) & 1u) == 0u) {
+          continue;
+        }
         const auto& column_info = column_infos_[column_idx];
-        const auto offset = row_idx * actual_row_byte_size_ + column_info.offset;
+        const auto offset = CellOffset(one_buffer, row_idx, column_idx);
         switch (column_info.type) {
         case FieldType::INT64:
           os << current_chunk->ReadInt64(offset);
@@ -200,7 +1233,11 @@ void Document::Dump(std::ostream& os) const {
           os << current_chunk->ReadDouble(offset);
           break;
         case FieldType::STRING:
-          os << current_chunk->ReadString(offset);
+        case FieldType::VARSTRING:
+        case FieldType::CATEGORY:
+          os << ReadCell<std::string>(*current_chunk, one_buffer.arena,
+                                      dictionaries_[column_idx], column_info.type,
+                                      offset);
           break;
         default:
           break;
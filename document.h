@@ -1,41 +1,221 @@
 #ifndef __DOCUMENT_H__
 #define __DOCUMENT_H__
 
+#include <atomic>
+#include <limits>
+#include <map>
 #include <memory>
 #include <ostream>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "allocator.h"
 #include "base.h"
+#include "category.h"
 #include "chunk.h"
+#include "thread_pool.h"
+#include "view.h"
 
 namespace csv {
 
+template <typename T>
+class ChunkedColumn;
+
+// Layout decides how cells are placed in a chunk.
+// ROW keeps each row contiguous (64 byte aligned), COLUMN keeps each column of a
+// chunk contiguous so that scanning or extracting one column reads only its bytes.
+enum class Layout { ROW = 0, COLUMN };
+
+// ColumnBatch names columns for Document::GetColumns() to extract together, and
+// the vector each goes to. A column is extracted as by the GetAs*() method of the
+// same name, and its vector resized to the document's row count. The vectors must
+// outlive the batch.
+class ColumnBatch {
+public:
+  ColumnBatch& AddInt64(const std::string& column, std::vector<int64_t>& output) {
+    return Add(column, Kind::INT64, &output);
+  }
+  ColumnBatch& AddDouble(const std::string& column, std::vector<double>& output) {
+    return Add(column, Kind::DOUBLE, &output);
+  }
+  ColumnBatch& AddString(const std::string& column, std::vector<std::string>& output) {
+    return Add(column, Kind::STRING, &output);
+  }
+  ColumnBatch& AddCategoryCodes(const std::string& column, std::vector<int32_t>& output) {
+    return Add(column, Kind::CATEGORY_CODES, &output);
+  }
+  size_t Size() const { return entries_.size(); }
+
+private:
+  friend class Document;
+  enum class Kind { INT64 = 0, DOUBLE, STRING, CATEGORY_CODES };
+  struct Entry {
+    std::string column;
+    Kind kind;
+    // a std::vector of the type of kind
+    void* output;
+  };
+
+  ColumnBatch& Add(const std::string& column, Kind kind, void* output) {
+    entries_.push_back(Entry{column, kind, output});
+    return *this;
+  }
+
+  std::vector<Entry> entries_;
+};
+
+// ColumnAggregate holds aggregates of an INT64 or DOUBLE column, or of a group of
+// its rows, as computed by Document::Aggregate*(). Nulls count in num_rows only.
+template <typename T>
+struct ColumnAggregate {
+  // rows aggregated, nulls included
+  size_t num_rows;
+  // valid cells, which sum, min and max are of. INT64 sums wrap around on
+  // overflow; min and max are 0 when there is no valid cell.
+  size_t count;
+  T sum;
+  T min;
+  T max;
+
+  // Mean() returns sum / count, NaN when count is 0
+  double Mean() const {
+    return count == 0u ? std::numeric_limits<double>::quiet_NaN()
+                       : static_cast<double>(sum) / static_cast<double>(count);
+  }
+};
+
 // Document holds parsed CSV content.
 // Parsed content can ge retreived using GetAs* methods.
 // To get contents from Document fast, set number of threads to bigger numbers
-// using SetNumThreads() (default = 1).
+// using SetNumThreads() (default = 1). They are taken from the document's thread
+// pool, DefaultThreadPool() unless SetThreadPool() gives another.
 class Document {
 public:
+  // Chunk memory comes from allocator, by default a PooledChunkAllocator of the
+  // document's own
   Document(const std::vector<std::string>& field_names,
-           const std::vector<FieldType>& field_types);
+           const std::vector<FieldType>& field_types, Layout layout = Layout::ROW,
+           std::shared_ptr<ChunkAllocator> allocator = nullptr);
   const std::vector<std::string>& FieldNames() const { return field_names_; }
+  Layout GetLayout() const { return layout_; }
 
   int NumThreads() const { return num_threads_; }
   void SetNumThreads(int num_threads) {
     num_threads_ = num_threads;
   }
+  // SetThreadPool() sets the pool Get*() run on, DefaultThreadPool() when null
+  void SetThreadPool(std::shared_ptr<ThreadPool> thread_pool) {
+    thread_pool_ = std::move(thread_pool);
+  }
 
   void Write(size_t row, size_t column, const char *str, size_t str_length);
-  void AddChunk(size_t num_rows);
+  // WriteToChunk() writes a cell of given chunk. Different chunks can be written
+  // concurrently, as long as no chunk is being added at the same time.
+  // CATEGORY cells are coded against a dictionary local to the chunk until
+  // FinishChunk() is called.
+  void WriteToChunk(size_t chunk_index, size_t row_in_chunk, size_t column,
+                    const char *str, size_t str_length);
+  // FinishChunk() merges the chunk local dictionaries of a chunk written with
+  // WriteToChunk() into the document's and recodes its CATEGORY cells. Must not run
+  // concurrently with anything else; finishing chunks in order keeps codes in order
+  // of first appearance.
+  void FinishChunk(size_t chunk_index);
+  // ShrinkChunk() drops rows at the end of a chunk, e.g. rows a filter rejected.
+  // Can run concurrently for different chunks, like WriteToChunk().
+  void ShrinkChunk(size_t chunk_index, size_t num_rows);
+  // AddChunk() returns index of the added chunk
+  size_t AddChunk(size_t num_rows);
+
+  // ReserveChunk() creates a chunk of num_rows rows, written through the returned
+  // ChunkWriter, which StitchChunks() later adds to the document. Unlike AddChunk(),
+  // it is lock free and may be called by any number of threads at once, e.g. one per
+  // parsed piece or input file, each writing its own chunk. sequence decides where
+  // the chunk goes and must differ between chunks stitched together.
+  class ChunkWriter;
+  ChunkWriter ReserveChunk(size_t num_rows, uint64_t sequence);
+  // StitchChunks() adds every reserved chunk after the document's chunks, in
+  // sequence order whatever order they were reserved in, and finishes them (see
+  // FinishChunk()). Their ChunkWriters must be done. Must not run concurrently with
+  // anything else.
+  void StitchChunks();
+  // Clear() removes every row. Chunk memory goes back to the allocator, whose pool
+  // hands it out to later AddChunk() calls again. Cells of a chunk are not zeroed.
+  // Reserved chunks which are not stitched yet are dropped.
+  void Clear();
   size_t NumRows() const;
+  // GetAs*() throw std::invalid_argument for a column of another type. GetAsString()
+  // reads STRING, VARSTRING and CATEGORY columns.
   std::vector<int64_t> GetAsInt64(const std::string& column) const;
   void GetAsInt64(const std::string& column, std::vector<int64_t>& result) const;
   std::vector<std::string> GetAsString(const std::string& column) const;
   void GetAsString(const std::string& column, std::vector<std::string>& result) const;
   std::vector<double> GetAsDouble(const std::string& column) const;
   void GetAsDouble(const std::string& column, std::vector<double>& result) const;
+  // GetCategoryCodes() returns the codes of a CATEGORY column, which index its
+  // Dictionary(). GetAsString() returns the decoded values.
+  std::vector<int32_t> GetCategoryCodes(const std::string& column) const;
+  void GetCategoryCodes(const std::string& column, std::vector<int32_t>& result) const;
+  const CategoryDictionary& Dictionary(const std::string& column) const;
+  // Empty cells are stored as 0 or an empty string and marked null in a validity
+  // bitmap kept per chunk and column. GetValidity() returns whether each row of a
+  // column is valid (not null), NullCount() how many are null.
+  std::vector<bool> GetValidity(const std::string& column) const;
+  size_t NullCount(const std::string& column) const;
+  // GetColumns() extracts every column of batch in one pass over the chunks, each
+  // block of rows being read once for all of them rather than once per column, so
+  // getting many columns costs little more than getting the widest one. Throws
+  // std::invalid_argument before writing anything if a column doesn't exist or
+  // can't be got as asked, as GetAs*() would.
+  void GetColumns(const ColumnBatch& batch) const;
+
+  // AggregateInt64() and AggregateDouble() aggregate an INT64 or DOUBLE column where
+  // its cells are, without copying them out: row blocks of every chunk are
+  // aggregated in parallel, then merged in row order so that results don't depend
+  // on the threads. The *By() variants aggregate each group of rows which share a
+  // value of key_column, a STRING, VARSTRING or CATEGORY column, by that value
+  // (nulls being the empty string). Throw std::invalid_argument for columns of other
+  // types.
+  ColumnAggregate<int64_t> AggregateInt64(const std::string& column) const;
+  ColumnAggregate<double> AggregateDouble(const std::string& column) const;
+  std::map<std::string, ColumnAggregate<int64_t>> AggregateInt64By(
+      const std::string& column, const std::string& key_column) const;
+  std::map<std::string, ColumnAggregate<double>> AggregateDoubleBy(
+      const std::string& column, const std::string& key_column) const;
+
+  // ColumnIndex() returns the index of the column with given name, in constant time
+  size_t ColumnIndex(const std::string& column) const;
+  FieldType ColumnType(size_t column_index) const {
+    return column_infos_[column_index].type;
+  }
+  size_t NumChunks() const { return buffer_.size(); }
+  size_t NumRowsInChunk(size_t chunk_index) const {
+    return buffer_[chunk_index].num_rows;
+  }
+  // GetColumnView() returns a view of a column in one chunk without copying anything.
+  // T must match the column type: int64_t, double, StringRef or int32_t (CATEGORY).
+  template <typename T>
+  ColumnView<T> GetColumnView(size_t column_index, size_t chunk_index) const;
+  // GetChunkedColumn() returns views of a column over every chunk
+  template <typename T>
+  ChunkedColumn<T> GetChunkedColumn(const std::string& column) const;
 
   void Dump(std::ostream& os) const;
+
+  // Save() writes the document to a binary file: a versioned header with the
+  // columns, dictionaries and per chunk row counts, then every chunk's cells as
+  // they are in memory, with the bytes no cell uses (row padding, the tail of
+  // STRING cells, unused rows) zeroed. tag is stored along, e.g. to tell what the
+  // file caches. Chunks written with WriteToChunk() must be finished first.
+  void Save(const std::string& path, const std::string& tag = std::string()) const;
+  // Load() reads a file written by Save(). Chunk cells are not copied but mapped
+  // copy on write from the file. Throws std::runtime_error if the file is not a
+  // saved Document of this version, is truncated or corrupt (every size, offset,
+  // string and code is checked) or, unless expected_tag is empty, its tag differs.
+  // Chunks added later come from allocator, as for the constructor.
+  static Document Load(const std::string& path,
+                       const std::string& expected_tag = std::string(),
+                       std::shared_ptr<ChunkAllocator> allocator = nullptr);
 private:
   struct ColumnInfo {
     FieldType type;
@@ -45,24 +225,240 @@ private:
   struct DocumentMemoryChunk {
     std::unique_ptr<MemoryChunk> chunk;
     size_t num_rows;
+    // where each column starts in chunk, only for Layout::COLUMN
+    std::vector<size_t> column_offsets;
+    // strings of VARSTRING cells
+    StringArena arena;
+    // per column dictionaries of CATEGORY cells written by WriteToChunk(), empty
+    // once the chunk is finished
+    std::vector<CategoryDictionary> dictionaries;
+    // validity bitmaps, validity_words words per column (fixed by AddChunk(), a
+    // shrunk chunk keeps them)
+    size_t validity_words;
+    std::vector<uint64_t> validity;
+
+    const uint64_t* Validity(size_t column) const {
+      return validity.data() + column * validity_words;
+    }
+  };
+
+  // ReservedChunk is a chunk reserved by ReserveChunk() and not stitched yet
+  struct ReservedChunk {
+    uint64_t sequence;
+    DocumentMemoryChunk chunk;
+    ReservedChunk* next;
   };
+  // ReservedChunks is a lock free stack of reserved chunks, which it owns
+  class ReservedChunks {
+  public:
+    ReservedChunks() : head_(nullptr) {}
+    ReservedChunks(ReservedChunks&& other) : head_(other.head_.exchange(nullptr)) {}
+    ReservedChunks& operator=(ReservedChunks&& other) {
+      Delete(TakeAll());
+      head_.store(other.head_.exchange(nullptr));
+      return *this;
+    }
+    ~ReservedChunks() { Delete(TakeAll()); }
+
+    void Push(ReservedChunk* reserved) {
+      reserved->next = head_.load(std::memory_order_relaxed);
+      while (!head_.compare_exchange_weak(reserved->next, reserved,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+      }
+    }
+    // TakeAll() returns the stack, linked by next, and leaves it empty
+    ReservedChunk* TakeAll() {
+      return head_.exchange(nullptr, std::memory_order_acquire);
+    }
 
+  private:
+    static void Delete(ReservedChunk* reserved) {
+      while (reserved != nullptr) {
+        auto next = reserved->next;
+        delete reserved;
+        reserved = next;
+      }
+    }
+
+    std::atomic<ReservedChunk*> head_;
+  };
+
+  // NewChunk() allocates a chunk of num_rows rows
+  DocumentMemoryChunk NewChunk(size_t num_rows) const;
+  // AppendChunk() adds chunk after the other chunks
+  void AppendChunk(DocumentMemoryChunk&& chunk);
   // Get() assigns column's result to output.
   // This method only should be used internally in document.cpp
   // Expects: output.size() == NumRows()
   template <typename T>
   void Get(const std::string& column, std::vector<T>& output) const;
-  
+  // ChunkRows are rows [begin_row, end_row) of a chunk
+  struct ChunkRows {
+    size_t chunk_index;
+    size_t begin_row;
+    size_t end_row;
+  };
+  // ChunkRowBlocks() splits the rows of every chunk into blocks, one per task of a
+  // parallel loop
+  std::vector<ChunkRows> ChunkRowBlocks() const;
+  // Aggregate() and AggregateBy() back Aggregate*() and Aggregate*By()
+  template <typename T>
+  ColumnAggregate<T> Aggregate(const std::string& column) const;
+  template <typename T>
+  std::map<std::string, ColumnAggregate<T>> AggregateBy(
+      const std::string& column, const std::string& key_column) const;
+  // CATEGORY cells are coded against dictionaries
+  void WriteCell(DocumentMemoryChunk& chunk,
+                 std::vector<CategoryDictionary>& dictionaries, size_t row_in_chunk,
+                 size_t column, const char *str, size_t str_length);
+  // WriteValue() writes a cell of an INT64 or DOUBLE column converted already
+  template <typename T>
+  void WriteValue(DocumentMemoryChunk& chunk, size_t row_in_chunk, size_t column,
+                  T value, bool valid) {
+    if (valid) {
+      chunk.validity[column * chunk.validity_words + row_in_chunk / 64] |=
+          uint64_t{1u} << (row_in_chunk % 64);
+    }
+    chunk.chunk->Write(static_cast<int>(CellOffset(chunk, row_in_chunk, column)), value);
+  }
+  ThreadPool& Pool() const { return thread_pool_ ? *thread_pool_ : *DefaultThreadPool(); }
+  // CellsValid() tells whether the STRING, VARSTRING and CATEGORY cells of a loaded
+  // chunk are within their cell, arena and dictionary
+  bool CellsValid(const DocumentMemoryChunk& chunk) const;
+  // CellOffset() returns the byte offset of a cell in chunk
+  size_t CellOffset(const DocumentMemoryChunk& chunk, size_t row_in_chunk,
+                    size_t column) const {
+    return layout_ == Layout::ROW
+               ? row_in_chunk * actual_row_byte_size_ + column_infos_[column].offset
+               : chunk.column_offsets[column] + row_in_chunk * column_infos_[column].size;
+  }
+
   std::vector<std::string> field_names_;
+  // the first column of each name
+  std::unordered_map<std::string, size_t> column_indices_;
   size_t num_cols_;
+  Layout layout_;
   size_t actual_row_byte_size_;
+  std::shared_ptr<ChunkAllocator> allocator_;
   std::vector<ColumnInfo> column_infos_;
   std::vector<DocumentMemoryChunk> buffer_;
-  MemoryChunk *current_memory_chunk_;
+  ReservedChunks reserved_chunks_;
+  // per column, empty for columns other than CATEGORY
+  std::vector<CategoryDictionary> dictionaries_;
+  DocumentMemoryChunk *current_memory_chunk_;
   int current_row_offset_in_chunk_;
   int num_threads_;
+  std::shared_ptr<ThreadPool> thread_pool_;
+};
+
+// ChunkWriter writes the cells of a chunk reserved by Document::ReserveChunk(), like
+// Document::WriteToChunk() does for added chunks.
+class Document::ChunkWriter {
+public:
+  void Write(size_t row_in_chunk, size_t column, const char *str, size_t str_length) {
+    document_->WriteCell(chunk_->chunk, chunk_->chunk.dictionaries, row_in_chunk, column,
+                         str, str_length);
+  }
+  // WriteInt64() and WriteDouble() write a cell of an INT64 or DOUBLE column which
+  // was converted already, e.g. by a RecordFilter. valid is false for an empty cell.
+  void WriteInt64(size_t row_in_chunk, size_t column, int64_t value, bool valid) {
+    document_->WriteValue(chunk_->chunk, row_in_chunk, column, value, valid);
+  }
+  void WriteDouble(size_t row_in_chunk, size_t column, double value, bool valid) {
+    document_->WriteValue(chunk_->chunk, row_in_chunk, column, value, valid);
+  }
+  // Shrink() drops rows at the end of the chunk, like Document::ShrinkChunk()
+  void Shrink(size_t num_rows);
+  size_t NumRows() const { return chunk_->chunk.num_rows; }
+
+private:
+  friend class Document;
+  ChunkWriter(Document* document, ReservedChunk* chunk)
+      : document_(document), chunk_(chunk) {}
+
+  Document* document_;
+  ReservedChunk* chunk_;
 };
 
+// ChunkedColumn iterates a column of a Document chunk by chunk, yielding one
+// ColumnView per chunk. The Document must outlive it.
+template <typename T>
+class ChunkedColumn {
+public:
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ColumnView<T>;
+    using difference_type = ptrdiff_t;
+    using pointer = const ColumnView<T>*;
+    using reference = ColumnView<T>;
+
+    Iterator(const ChunkedColumn* column, size_t chunk_index)
+        : column_(column), chunk_index_(chunk_index) {}
+    ColumnView<T> operator*() const { return column_->Chunk(chunk_index_); }
+    Iterator& operator++() {
+      ++chunk_index_;
+      return *this;
+    }
+    bool operator==(const Iterator& other) const {
+      return chunk_index_ == other.chunk_index_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return chunk_index_ != other.chunk_index_;
+    }
+
+  private:
+    const ChunkedColumn* column_;
+    size_t chunk_index_;
+  };
+
+  ChunkedColumn(const Document* document, size_t column_index)
+      : document_(document), column_index_(column_index) {}
+
+  size_t NumChunks() const { return document_->NumChunks(); }
+  ColumnView<T> Chunk(size_t chunk_index) const {
+    return document_->GetColumnView<T>(column_index_, chunk_index);
+  }
+
+  Iterator begin() const { return Iterator(this, 0u); }
+  Iterator end() const { return Iterator(this, NumChunks()); }
+
+private:
+  const Document* document_;
+  size_t column_index_;
+};
+
+template <typename T>
+ColumnView<T> Document::GetColumnView(size_t column_index, size_t chunk_index) const {
+  const auto& column_info = column_infos_[column_index];
+  if (!ViewTypeHelper<T>::Matches(column_info.type)) {
+    throw std::invalid_argument(std::string("view type doesn't match type of column ") +
+                                field_names_[column_index]);
+  }
+  const auto& document_memory_chunk = buffer_[chunk_index];
+  const size_t row_stride = layout_ == Layout::ROW
+                                ? actual_row_byte_size_
+                                : static_cast<size_t>(column_info.size);
+  return ColumnView<T>(document_memory_chunk.chunk.get(),
+                       CellOffset(document_memory_chunk, 0u, column_index),
+                       document_memory_chunk.num_rows, row_stride,
+                       column_info.type == FieldType::VARSTRING
+                           ? &document_memory_chunk.arena
+                           : nullptr,
+                       document_memory_chunk.Validity(column_index));
+}
+
+template <typename T>
+ChunkedColumn<T> Document::GetChunkedColumn(const std::string& column) const {
+  const auto column_index = ColumnIndex(column);
+  if (!ViewTypeHelper<T>::Matches(column_infos_[column_index].type)) {
+    throw std::invalid_argument(std::string("view type doesn't match type of column ") +
+                                column);
+  }
+  return ChunkedColumn<T>(this, column_index);
+}
+
 } // namespace csv
 
 #endif
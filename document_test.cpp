@@ -2,8 +2,22 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+
 namespace {
 
+struct TempFileHandle {
+  std::string file_name;
+  TempFileHandle(): file_name(std::tmpnam(nullptr)) {}
+  ~TempFileHandle() { if (!file_name.empty()) std::remove(file_name.c_str()); }
+};
+
 // columns: [id, name, age, grade]
 // column types: [int, string, int, double]
 
@@ -156,4 +170,780 @@ TEST(TestDocument, TestDump) {
       dumped.c_str());
 }
 
+TEST(TestDocument, TestColumnLayout) {
+  csv::Document doc(std::vector<std::string>{"id", "name", "age", "grade"},
+                    std::vector<csv::FieldType>{
+                        csv::FieldType::INT64, csv::FieldType::STRING,
+                        csv::FieldType::INT64, csv::FieldType::DOUBLE},
+                    csv::Layout::COLUMN);
+  EXPECT_EQ(csv::Layout::COLUMN, doc.GetLayout());
+  doc.AddChunk(3);
+  // [0, "A", 20, 2.7]
+  doc.Write(0, 0, "0", 1);
+  doc.Write(0, 1, "A", 1);
+  doc.Write(0, 2, "20", 2);
+  doc.Write(0, 3, "2.7", 3);
+
+  // [1, "B", 19, 4.1]
+  doc.Write(1, 0, "1", 1);
+  doc.Write(1, 1, "B", 1);
+  doc.Write(1, 2, "19", 2);
+  doc.Write(1, 3, "4.1", 3);
+
+  // [2, "AB", 9, 4.12]
+  doc.Write(2, 0, "2", 1);
+  doc.Write(2, 1, "AB", 2);
+  doc.Write(2, 2, "9", 1);
+  doc.Write(2, 3, "4.12", 4);
+
+  doc.AddChunk(1);
+  // [3, "ABCD", 24, 3.1415]
+  doc.Write(3, 0, "3", 1);
+  doc.Write(3, 1, "ABCD", 4);
+  doc.Write(3, 2, "24", 2);
+  doc.Write(3, 3, "3.1415", 6);
+
+  std::vector<int64_t> ids = doc.GetAsInt64("id");
+  std::vector<std::string> names = doc.GetAsString("name");
+  std::vector<double> grades = doc.GetAsDouble("grade");
+  std::vector<int64_t> ages = doc.GetAsInt64("age");
+  ASSERT_EQ(4u, doc.NumRows());
+  EXPECT_EQ((std::vector<int64_t>{0, 1, 2, 3}), ids);
+  EXPECT_EQ((std::vector<std::string>{"A", "B", "AB", "ABCD"}), names);
+  EXPECT_EQ((std::vector<double>{2.7, 4.1, 4.12, 3.1415}), grades);
+  EXPECT_EQ((std::vector<int64_t>{20, 19, 9, 24}), ages);
+
+  std::ostringstream os;
+  doc.Dump(os);
+  EXPECT_EQ(std::string("id,name,age,grade\n"
+                        "0,A,20,2.7\n"
+                        "1,B,19,4.1\n"
+                        "2,AB,9,4.12\n"
+                        "3,ABCD,24,3.1415\n"),
+            os.str());
+}
+
+TEST(TestDocument, TestGetMismatchedType) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "status", "grade", "name"},
+                      std::vector<csv::FieldType>{
+                          csv::FieldType::INT64, csv::FieldType::CATEGORY,
+                          csv::FieldType::DOUBLE, csv::FieldType::VARSTRING},
+                      layout);
+    doc.AddChunk(64);
+    for (size_t row = 0u; row < 64u; ++row) {
+      doc.Write(row, 0, "1", 1);
+      doc.Write(row, 1, "OK", 2);
+      doc.Write(row, 2, "1.5", 3);
+      doc.Write(row, 3, "x", 1);
+    }
+    // cells of other widths than asked for are never read
+    EXPECT_THROW(doc.GetAsInt64("status"), std::invalid_argument);
+    EXPECT_THROW(doc.GetAsInt64("grade"), std::invalid_argument);
+    EXPECT_THROW(doc.GetAsDouble("id"), std::invalid_argument);
+    EXPECT_THROW(doc.GetAsString("id"), std::invalid_argument);
+    EXPECT_THROW(doc.GetCategoryCodes("name"), std::invalid_argument);
+    std::vector<int64_t> ids(64u);
+    EXPECT_THROW(doc.GetAsInt64("name", ids), std::invalid_argument);
+
+    EXPECT_EQ(std::vector<std::string>(64u, "OK"), doc.GetAsString("status"));
+    EXPECT_EQ(std::vector<std::string>(64u, "x"), doc.GetAsString("name"));
+    EXPECT_EQ(std::vector<int64_t>(64u, 1), doc.GetAsInt64("id"));
+  }
+}
+
+TEST(TestDocument, TestColumnViews) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "name", "grade"},
+                      std::vector<csv::FieldType>{csv::FieldType::INT64,
+                                                  csv::FieldType::STRING,
+                                                  csv::FieldType::DOUBLE},
+                      layout);
+    doc.AddChunk(2);
+    doc.Write(0, 0, "0", 1);
+    doc.Write(0, 1, "A", 1);
+    doc.Write(0, 2, "2.7", 3);
+    doc.Write(1, 0, "1", 1);
+    doc.Write(1, 1, "B", 1);
+    doc.Write(1, 2, "4.1", 3);
+    doc.AddChunk(1);
+    doc.Write(2, 0, "2", 1);
+    doc.Write(2, 1, "AB", 2);
+    doc.Write(2, 2, "4.12", 4);
+
+    ASSERT_EQ(2u, doc.NumChunks());
+    auto ids = doc.GetColumnView<int64_t>(0, 0);
+    ASSERT_EQ(2u, ids.Size());
+    EXPECT_EQ(0, ids[0]);
+    EXPECT_EQ(1, ids[1]);
+    EXPECT_EQ(layout == csv::Layout::COLUMN, ids.Contiguous());
+    if (ids.Contiguous()) {
+      EXPECT_EQ(1, ids.Data()[1]);
+    }
+
+    std::vector<int64_t> all_ids;
+    std::vector<std::string> all_names;
+    std::vector<double> all_grades;
+    for (const auto& view : doc.GetChunkedColumn<int64_t>("id")) {
+      all_ids.insert(all_ids.end(), view.begin(), view.end());
+    }
+    for (const auto& view : doc.GetChunkedColumn<csv::StringRef>("name")) {
+      for (const auto name : view) {
+        all_names.push_back(name.ToString());
+      }
+    }
+    for (const auto& view : doc.GetChunkedColumn<double>("grade")) {
+      all_grades.insert(all_grades.end(), view.begin(), view.end());
+    }
+    EXPECT_EQ((std::vector<int64_t>{0, 1, 2}), all_ids);
+    EXPECT_EQ((std::vector<std::string>{"A", "B", "AB"}), all_names);
+    EXPECT_EQ((std::vector<double>{2.7, 4.1, 4.12}), all_grades);
+
+    EXPECT_THROW(doc.GetChunkedColumn<double>("id"), std::invalid_argument);
+    EXPECT_THROW(doc.GetChunkedColumn<int64_t>("unknown"), std::invalid_argument);
+  }
+}
+
+TEST(TestDocument, TestVarString) {
+  const std::string long_name(300, 'x');
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "name"},
+                      std::vector<csv::FieldType>{csv::FieldType::INT64,
+                                                  csv::FieldType::VARSTRING},
+                      layout);
+    doc.AddChunk(2);
+    doc.Write(0, 0, "0", 1);
+    doc.Write(0, 1, "KR", 2);
+    doc.Write(1, 0, "1", 1);
+    doc.Write(1, 1, long_name.c_str(), long_name.size());
+    doc.AddChunk(1);
+    doc.Write(2, 0, "2", 1);
+    doc.Write(2, 1, "", 0);
+
+    EXPECT_EQ((std::vector<std::string>{"KR", long_name, ""}), doc.GetAsString("name"));
+
+    std::vector<std::string> names;
+    for (const auto& view : doc.GetChunkedColumn<csv::StringRef>("name")) {
+      for (const auto name : view) {
+        names.push_back(name.ToString());
+      }
+    }
+    EXPECT_EQ((std::vector<std::string>{"KR", long_name, ""}), names);
+
+    std::ostringstream os;
+    doc.Dump(os);
+    EXPECT_EQ("id,name\n0,KR\n1," + long_name + "\n2,\n", os.str());
+  }
+}
+
+TEST(TestDocument, TestCategory) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"status", "id"},
+                      std::vector<csv::FieldType>{csv::FieldType::CATEGORY,
+                                                  csv::FieldType::INT64},
+                      layout);
+    doc.AddChunk(3);
+    doc.Write(0, 0, "OK", 2);
+    doc.Write(0, 1, "0", 1);
+    doc.Write(1, 0, "FAIL", 4);
+    doc.Write(1, 1, "1", 1);
+    doc.Write(2, 0, "OK", 2);
+    doc.Write(2, 1, "2", 1);
+
+    // chunks written concurrently code against their own dictionary until finished
+    const auto first = doc.AddChunk(2);
+    const auto second = doc.AddChunk(2);
+    doc.WriteToChunk(second, 0, 0, "", 0);
+    doc.WriteToChunk(second, 0, 1, "5", 1);
+    doc.WriteToChunk(second, 1, 0, "OK", 2);
+    doc.WriteToChunk(second, 1, 1, "6", 1);
+    doc.WriteToChunk(first, 0, 0, "RETRY", 5);
+    doc.WriteToChunk(first, 0, 1, "3", 1);
+    doc.WriteToChunk(first, 1, 0, "FAIL", 4);
+    doc.WriteToChunk(first, 1, 1, "4", 1);
+    doc.FinishChunk(first);
+    doc.FinishChunk(second);
+
+    const auto& dictionary = doc.Dictionary("status");
+    ASSERT_EQ(4u, dictionary.Size());
+    EXPECT_EQ("OK", dictionary.Get(0).ToString());
+    EXPECT_EQ("FAIL", dictionary.Get(1).ToString());
+    EXPECT_EQ("RETRY", dictionary.Get(2).ToString());
+    EXPECT_EQ("", dictionary.Get(3).ToString());
+
+    EXPECT_EQ((std::vector<int32_t>{0, 1, 0, 2, 1, 3, 0}),
+              doc.GetCategoryCodes("status"));
+    EXPECT_EQ((std::vector<std::string>{"OK", "FAIL", "OK", "RETRY", "FAIL", "", "OK"}),
+              doc.GetAsString("status"));
+    EXPECT_EQ((std::vector<int64_t>{0, 1, 2, 3, 4, 5, 6}), doc.GetAsInt64("id"));
+
+    std::vector<int32_t> codes;
+    for (const auto& view : doc.GetChunkedColumn<int32_t>("status")) {
+      EXPECT_EQ(layout == csv::Layout::COLUMN, view.Contiguous());
+      codes.insert(codes.end(), view.begin(), view.end());
+    }
+    EXPECT_EQ((std::vector<int32_t>{0, 1, 0, 2, 1, 3, 0}), codes);
+
+    std::ostringstream os;
+    doc.Dump(os);
+    EXPECT_EQ("status,id\nOK,0\nFAIL,1\nOK,2\nRETRY,3\nFAIL,4\n,5\nOK,6\n", os.str());
+
+    EXPECT_THROW(doc.Dictionary("id"), std::invalid_argument);
+    EXPECT_THROW(doc.GetCategoryCodes("id"), std::invalid_argument);
+  }
+}
+
+TEST(TestDocument, TestClear) {
+  csv::Document doc(std::vector<std::string>{"id", "status"},
+                    std::vector<csv::FieldType>{csv::FieldType::INT64,
+                                                csv::FieldType::CATEGORY});
+  doc.AddChunk(2);
+  doc.Write(0, 0, "0", 1);
+  doc.Write(0, 1, "OK", 2);
+  doc.Write(1, 0, "1", 1);
+  doc.Write(1, 1, "FAIL", 4);
+
+  doc.Clear();
+  EXPECT_EQ(0u, doc.NumRows());
+  EXPECT_EQ(0u, doc.NumChunks());
+  EXPECT_EQ(0u, doc.Dictionary("status").Size());
+
+  doc.AddChunk(1);
+  doc.Write(0, 0, "7", 1);
+  doc.Write(0, 1, "RETRY", 5);
+  EXPECT_EQ((std::vector<int64_t>{7}), doc.GetAsInt64("id"));
+  EXPECT_EQ((std::vector<int32_t>{0}), doc.GetCategoryCodes("status"));
+  EXPECT_EQ((std::vector<std::string>{"RETRY"}), doc.GetAsString("status"));
+}
+
+TEST(TestDocument, TestValidity) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "grade", "name"},
+                      std::vector<csv::FieldType>{csv::FieldType::INT64,
+                                                  csv::FieldType::DOUBLE,
+                                                  csv::FieldType::STRING},
+                      layout);
+    // enough rows for more than one bitmap word
+    constexpr size_t num_rows = 130u;
+    doc.AddChunk(num_rows - 1);
+    for (size_t row = 0u; row < num_rows; ++row) {
+      if (row == num_rows - 1) {
+        doc.AddChunk(1);
+      }
+      const auto id = std::to_string(row);
+      // every third id and every grade but the first are missing
+      doc.Write(row, 0, id.c_str(), row % 3 == 0 ? 0u : id.size());
+      doc.Write(row, 1, "0.5", row == 0u ? 3u : 0u);
+      doc.Write(row, 2, "x", 1);
+    }
+
+    const auto validity = doc.GetValidity("id");
+    ASSERT_EQ(num_rows, validity.size());
+    const auto ids = doc.GetAsInt64("id");
+    for (size_t row = 0u; row < num_rows; ++row) {
+      EXPECT_EQ(row % 3 != 0u, validity[row]);
+      // nulls still read as 0
+      EXPECT_EQ(row % 3 == 0u ? 0 : static_cast<int64_t>(row), ids[row]);
+    }
+    EXPECT_EQ(44u, doc.NullCount("id"));
+    EXPECT_EQ(num_rows - 1, doc.NullCount("grade"));
+    EXPECT_EQ(0u, doc.NullCount("name"));
+
+    size_t row = 0u;
+    for (const auto& view : doc.GetChunkedColumn<int64_t>("id")) {
+      ASSERT_NE(nullptr, view.Validity());
+      for (size_t idx = 0u; idx < view.Size(); ++idx, ++row) {
+        EXPECT_EQ(row % 3 != 0u, view.IsValid(idx));
+      }
+    }
+    EXPECT_EQ(num_rows, row);
+
+    std::ostringstream os;
+    doc.Dump(os);
+    EXPECT_EQ(0u, os.str().find("id,grade,name\n,0.5,x\n1,,x\n2,,x\n,,x\n"));
+  }
+}
+
+TEST(TestDocument, TestSaveLoad) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "grade", "name", "note", "status"},
+                      std::vector<csv::FieldType>{csv::FieldType::INT64,
+                                                  csv::FieldType::DOUBLE,
+                                                  csv::FieldType::STRING,
+                                                  csv::FieldType::VARSTRING,
+                                                  csv::FieldType::CATEGORY},
+                      layout);
+    const std::vector<std::vector<std::string>> rows{{"1", "1.5", "KR", "first", "OK"},
+                                                     {"", "2.5", "", "", "FAIL"},
+                                                     {"3", "", "US", "third", "OK"},
+                                                     {"4", "4.5", "JP", "fourth", ""}};
+    doc.AddChunk(2);
+    for (size_t row = 0u; row < rows.size(); ++row) {
+      if (row == 2u) {
+        doc.AddChunk(3);
+      }
+      for (size_t column = 0u; column < rows[row].size(); ++column) {
+        doc.Write(row, column, rows[row][column].data(), rows[row][column].size());
+      }
+    }
+    // the last chunk holds fewer rows than it has memory for
+    doc.ShrinkChunk(1u, 2u);
+
+    TempFileHandle file_handle;
+    doc.Save(file_handle.file_name, "tag");
+    auto loaded = csv::Document::Load(file_handle.file_name, "tag");
+    EXPECT_EQ(layout, loaded.GetLayout());
+    EXPECT_EQ(doc.FieldNames(), loaded.FieldNames());
+    ASSERT_EQ(2u, loaded.NumChunks());
+    EXPECT_EQ(2u, loaded.NumRowsInChunk(1u));
+    EXPECT_EQ(doc.GetAsInt64("id"), loaded.GetAsInt64("id"));
+    EXPECT_EQ(doc.GetAsDouble("grade"), loaded.GetAsDouble("grade"));
+    EXPECT_EQ(doc.GetAsString("name"), loaded.GetAsString("name"));
+    EXPECT_EQ(doc.GetAsString("note"), loaded.GetAsString("note"));
+    EXPECT_EQ(doc.GetCategoryCodes("status"), loaded.GetCategoryCodes("status"));
+    EXPECT_EQ(doc.GetAsString("status"), loaded.GetAsString("status"));
+    EXPECT_EQ(doc.GetValidity("note"), loaded.GetValidity("note"));
+    std::ostringstream expected, actual;
+    doc.Dump(expected);
+    loaded.Dump(actual);
+    EXPECT_EQ(expected.str(), actual.str());
+
+    // a loaded document can be written to, without changing the file
+    loaded.Write(3, 0, "40", 2);
+    EXPECT_EQ(40, loaded.GetAsInt64("id").back());
+    EXPECT_EQ(4, csv::Document::Load(file_handle.file_name).GetAsInt64("id").back());
+    loaded.AddChunk(1);
+    loaded.Write(4, 4, "NEW", 3);
+    EXPECT_EQ("NEW", loaded.GetAsString("status").back());
+
+    EXPECT_THROW(csv::Document::Load(file_handle.file_name, "other"), std::runtime_error);
+  }
+}
+
+// DirtyAllocator hands out memory filled with kDirtyByte, like a pooled buffer
+// which held cells of another Document
+class DirtyAllocator : public csv::ChunkAllocator {
+public:
+  static constexpr char kDirtyByte = static_cast<char>(0xA5);
+
+  char* Allocate(size_t size, size_t& capacity) override {
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, 64u, size == 0u ? 64u : size) != 0) {
+      throw std::bad_alloc();
+    }
+    std::memset(buffer, kDirtyByte, size);
+    capacity = size;
+    return static_cast<char*>(buffer);
+  }
+  void Deallocate(char* buffer, size_t) override { std::free(buffer); }
+};
+
+TEST(TestDocument, TestSaveUnusedBytes) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "name", "status"},
+                      std::vector<csv::FieldType>{csv::FieldType::INT64,
+                                                  csv::FieldType::STRING,
+                                                  csv::FieldType::CATEGORY},
+                      layout, std::make_shared<DirtyAllocator>());
+    // rows are padded, STRING cells are mostly unused, and the chunk has memory
+    // for more rows than it holds
+    const auto chunk_index = doc.AddChunk(10);
+    for (size_t row = 0u; row < 3u; ++row) {
+      const auto value = std::to_string(row);
+      for (size_t column = 0u; column < 3u; ++column) {
+        doc.WriteToChunk(chunk_index, row, column, value.data(), value.size());
+      }
+    }
+    doc.ShrinkChunk(chunk_index, 3u);
+    doc.FinishChunk(chunk_index);
+
+    TempFileHandle file_handle;
+    doc.Save(file_handle.file_name);
+    std::string saved;
+    {
+      std::ifstream file_in(file_handle.file_name, std::ios::binary);
+      saved.assign(std::istreambuf_iterator<char>(file_in),
+                   std::istreambuf_iterator<char>());
+    }
+    EXPECT_EQ(std::string::npos, saved.find(std::string(4u, DirtyAllocator::kDirtyByte)));
+    EXPECT_EQ(doc.GetAsString("name"),
+              csv::Document::Load(file_handle.file_name).GetAsString("name"));
+  }
+}
+
+TEST(TestDocument, TestLoadInvalid) {
+  TempFileHandle file_handle;
+  EXPECT_THROW(csv::Document::Load(file_handle.file_name), std::runtime_error);
+  std::ofstream(file_handle.file_name) << "id,name\n1,KR\n";
+  EXPECT_THROW(csv::Document::Load(file_handle.file_name), std::runtime_error);
+
+  csv::Document doc(std::vector<std::string>{"id"},
+                    std::vector<csv::FieldType>{csv::FieldType::INT64});
+  doc.AddChunk(100);
+  doc.Save(file_handle.file_name);
+  std::string saved;
+  {
+    std::ifstream file_in(file_handle.file_name, std::ios::binary);
+    saved.assign(std::istreambuf_iterator<char>(file_in),
+                 std::istreambuf_iterator<char>());
+  }
+  std::ofstream(file_handle.file_name, std::ios::binary)
+      << saved.substr(0u, saved.size() - 8u);
+  EXPECT_THROW(csv::Document::Load(file_handle.file_name), std::runtime_error);
+}
+
+TEST(TestDocument, TestLoadCorrupt) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "name", "note", "status"},
+                      std::vector<csv::FieldType>{
+                          csv::FieldType::INT64, csv::FieldType::STRING,
+                          csv::FieldType::VARSTRING, csv::FieldType::CATEGORY},
+                      layout);
+    for (size_t num_rows : {70u, 3u}) {
+      const auto chunk_index = doc.AddChunk(num_rows);
+      for (size_t row = 0u; row < num_rows; ++row) {
+        const auto value = std::to_string(row % 4u);
+        for (size_t column = 0u; column < 4u; ++column) {
+          doc.WriteToChunk(chunk_index, row, column, value.data(), value.size());
+        }
+      }
+      doc.FinishChunk(chunk_index);
+    }
+    TempFileHandle file_handle;
+    doc.Save(file_handle.file_name);
+    std::string saved;
+    {
+      std::ifstream file_in(file_handle.file_name, std::ios::binary);
+      saved.assign(std::istreambuf_iterator<char>(file_in),
+                 std::istreambuf_iterator<char>());
+    }
+    auto load = [&file_handle](const std::string& content) {
+      std::ofstream(file_handle.file_name, std::ios::binary | std::ios::trunc) << content;
+      return csv::Document::Load(file_handle.file_name);
+    };
+    EXPECT_EQ(doc.GetAsString("note"), load(saved).GetAsString("note"));
+
+    // truncated anywhere
+    for (size_t size = 0u; size < saved.size(); size += 7u) {
+      EXPECT_THROW(load(saved.substr(0u, size)), std::runtime_error) << size;
+    }
+
+    // the layout, after the magic, version, byte order mark
+    auto corrupted = saved;
+    corrupted[16] = 7;
+    EXPECT_THROW(load(corrupted), std::runtime_error);
+
+    // a dictionary value saved twice, which would shift later codes
+    const std::string length_one("\x01\0\0\0\0\0\0\0", 8u);
+    const auto values = saved.find("0" + length_one + "1");
+    ASSERT_NE(std::string::npos, values);
+    corrupted = saved;
+    corrupted[values + 9u] = '0';
+    try {
+      load(corrupted);
+      ADD_FAILURE() << "a duplicate dictionary value is loaded";
+    } catch (const std::runtime_error& error) {
+      EXPECT_NE(nullptr, std::strstr(error.what(), "dictionary of status"))
+          << error.what();
+    }
+
+    // the cells of the last chunk, at the end of the file: a CATEGORY code past the
+    // dictionary, a VARSTRING past the arena, or a STRING longer than its cell. Rows
+    // are 128 bytes of id, name, note and status at 0, 8, 72 and 80; columns are
+    // arrays of 3 cells at 0, 64, 256 and 320 of a 332 byte chunk.
+    const bool row_layout = layout == csv::Layout::ROW;
+    const size_t status_code = row_layout ? saved.size() - 128u + 80u : saved.size() - 4u;
+    const size_t note_slot = row_layout ? saved.size() - 128u + 72u : saved.size() - 76u;
+    const size_t name_length =
+        row_layout ? saved.size() - 128u + 8u + 63u : saved.size() - 268u + 63u;
+    for (const auto offset : {status_code, note_slot, name_length}) {
+      corrupted = saved;
+      corrupted[offset] = static_cast<char>(200);
+      EXPECT_THROW(load(corrupted), std::runtime_error) << offset;
+    }
+  }
+}
+
+TEST(TestDocument, TestReserveChunk) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "status"},
+                      std::vector<csv::FieldType>{csv::FieldType::INT64,
+                                                  csv::FieldType::CATEGORY},
+                      layout);
+    doc.AddChunk(1);
+    doc.Write(0, 0, "-1", 2);
+    doc.Write(0, 1, "FIRST", 5);
+
+    // chunks reserved and written concurrently in any order, the last one shrunk
+    constexpr int num_chunks = 64;
+    constexpr size_t rows_per_chunk = 100u;
+    csv::ThreadPool thread_pool(8);
+    thread_pool.ParallelFor(num_chunks, 0, [&doc](size_t task) {
+      const int idx = num_chunks - 1 - static_cast<int>(task);
+      auto chunk = doc.ReserveChunk(rows_per_chunk, static_cast<uint64_t>(idx) * 10u);
+      for (size_t row = 0u; row < rows_per_chunk; ++row) {
+        const auto id = std::to_string(idx * rows_per_chunk + row);
+        const auto status = std::string("S") + std::to_string(idx % 7);
+        chunk.Write(row, 0, id.data(), id.size());
+        chunk.Write(row, 1, status.data(), status.size());
+      }
+      if (idx == num_chunks - 1) {
+        chunk.Shrink(rows_per_chunk / 2);
+      }
+    });
+    EXPECT_EQ(1u, doc.NumChunks());
+    doc.StitchChunks();
+    ASSERT_EQ(static_cast<size_t>(num_chunks + 1), doc.NumChunks());
+
+    const auto ids = doc.GetAsInt64("id");
+    ASSERT_EQ(1u + num_chunks * rows_per_chunk - rows_per_chunk / 2, ids.size());
+    for (size_t row = 0u; row < ids.size(); ++row) {
+      EXPECT_EQ(static_cast<int64_t>(row) - 1, ids[row]);
+    }
+    // codes in order of first appearance, in sequence order
+    const auto& dictionary = doc.Dictionary("status");
+    ASSERT_EQ(8u, dictionary.Size());
+    EXPECT_EQ("FIRST", dictionary.Get(0).ToString());
+    for (int32_t code = 1; code < 8; ++code) {
+      EXPECT_EQ(std::string("S") + std::to_string(code - 1),
+                dictionary.Get(code).ToString());
+    }
+
+    // rows written by Write() go after the stitched ones
+    doc.AddChunk(1);
+    doc.Write(ids.size(), 0, "7", 1);
+    doc.Write(ids.size(), 1, "LAST", 4);
+    EXPECT_EQ(7, doc.GetAsInt64("id").back());
+  }
+}
+
+TEST(TestDocument, TestClearReserved) {
+  csv::Document doc(std::vector<std::string>{"id"},
+                    std::vector<csv::FieldType>{csv::FieldType::INT64});
+  doc.ReserveChunk(10u, 0u);
+  doc.Clear();
+  doc.StitchChunks();
+  EXPECT_EQ(0u, doc.NumChunks());
+}
+
+TEST(TestDocument, TestGetColumns) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "name", "status", "grade", "code"},
+                      std::vector<csv::FieldType>{
+                          csv::FieldType::INT64, csv::FieldType::VARSTRING,
+                          csv::FieldType::CATEGORY, csv::FieldType::DOUBLE,
+                          csv::FieldType::STRING},
+                      layout);
+    doc.SetThreadPool(std::make_shared<csv::ThreadPool>(4));
+    doc.SetNumThreads(4);
+    // chunks of several row blocks, of one row, and empty
+    size_t id = 0u;
+    for (size_t num_rows : {40000u, 1u, 0u, 7000u}) {
+      const auto chunk_index = doc.AddChunk(num_rows);
+      for (size_t row = 0u; row < num_rows; ++row, ++id) {
+        const auto id_str = std::to_string(id);
+        const auto name = std::string("name") + std::to_string(id * 7u);
+        const auto status = std::string("S") + std::to_string(id % 5u);
+        const auto grade = std::to_string(id) + ".5";
+        doc.WriteToChunk(chunk_index, row, 0, id_str.data(), id_str.size());
+        doc.WriteToChunk(chunk_index, row, 1, name.data(), name.size());
+        doc.WriteToChunk(chunk_index, row, 2, status.data(), status.size());
+        doc.WriteToChunk(chunk_index, row, 3, grade.data(), grade.size());
+        // some empty
+        doc.WriteToChunk(chunk_index, row, 4, status.data(),
+                         id % 3u == 0u ? 0u : status.size());
+      }
+      doc.FinishChunk(chunk_index);
+    }
+
+    std::vector<int64_t> ids;
+    std::vector<std::string> names;
+    std::vector<int32_t> status_codes;
+    std::vector<std::string> statuses;
+    std::vector<double> grades;
+    std::vector<std::string> codes;
+    // stale content is replaced
+    std::vector<double> stale_grades(3u, -1.0);
+    csv::ColumnBatch batch;
+    batch.AddInt64("id", ids)
+        .AddString("name", names)
+        .AddCategoryCodes("status", status_codes)
+        .AddString("status", statuses)
+        .AddDouble("grade", grades)
+        .AddString("code", codes)
+        .AddDouble("grade", stale_grades);
+    EXPECT_EQ(7u, batch.Size());
+    doc.GetColumns(batch);
+
+    ASSERT_EQ(47001u, ids.size());
+    EXPECT_EQ(doc.GetAsInt64("id"), ids);
+    EXPECT_EQ(doc.GetAsString("name"), names);
+    EXPECT_EQ(doc.GetCategoryCodes("status"), status_codes);
+    EXPECT_EQ(doc.GetAsString("status"), statuses);
+    EXPECT_EQ(doc.GetAsDouble("grade"), grades);
+    EXPECT_EQ(doc.GetAsString("code"), codes);
+    EXPECT_EQ(grades, stale_grades);
+    EXPECT_EQ(46000, ids[46000]);
+    EXPECT_EQ("S1", codes[40001]);
+    EXPECT_EQ("", codes[40002]);
+
+    // nothing is written when a column can't be extracted
+    std::vector<int64_t> untouched(2u, 5);
+    csv::ColumnBatch missing;
+    missing.AddInt64("id", untouched).AddInt64("nothing", untouched);
+    EXPECT_THROW(doc.GetColumns(missing), std::invalid_argument);
+    csv::ColumnBatch not_category;
+    not_category.AddInt64("id", untouched).AddCategoryCodes("name", status_codes);
+    EXPECT_THROW(doc.GetColumns(not_category), std::invalid_argument);
+    // cells of other widths than asked for are never read
+    std::vector<double> doubles;
+    std::vector<std::string> strings;
+    for (const auto& mismatched :
+         {csv::ColumnBatch().AddInt64("id", untouched).AddInt64("status", untouched),
+          csv::ColumnBatch().AddInt64("id", untouched).AddInt64("grade", untouched),
+          csv::ColumnBatch().AddInt64("id", untouched).AddDouble("id", doubles),
+          csv::ColumnBatch().AddInt64("id", untouched).AddString("id", strings),
+          csv::ColumnBatch().AddInt64("id", untouched).AddString("grade", strings)}) {
+      EXPECT_THROW(doc.GetColumns(mismatched), std::invalid_argument);
+    }
+    EXPECT_EQ(std::vector<int64_t>(2u, 5), untouched);
+    EXPECT_TRUE(doubles.empty());
+    EXPECT_TRUE(strings.empty());
+
+    doc.GetColumns(csv::ColumnBatch());
+  }
+}
+
+TEST(TestDocument, TestAggregate) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(
+        std::vector<std::string>{"id", "grade", "country", "status", "city"},
+        std::vector<csv::FieldType>{csv::FieldType::INT64, csv::FieldType::DOUBLE,
+                                    csv::FieldType::STRING, csv::FieldType::CATEGORY,
+                                    csv::FieldType::VARSTRING},
+        layout);
+    doc.SetThreadPool(std::make_shared<csv::ThreadPool>(4));
+    doc.SetNumThreads(4);
+    const std::vector<std::string> countries{"KR", "US", "", "FR"};
+    int64_t id = -1000;
+    for (size_t num_rows : {40000u, 3u, 0u, 7000u}) {
+      const auto chunk_index = doc.AddChunk(num_rows);
+      for (size_t row = 0u; row < num_rows; ++row, ++id) {
+        // ids are null in runs, grades here and there
+        const auto id_str = id / 100 % 5 == 0 ? std::string() : std::to_string(id);
+        const auto grade =
+            id % 7 == 0 ? std::string() : std::to_string(id % 1000) + ".25";
+        const auto& country =
+            countries[static_cast<size_t>(id + 1000) % countries.size()];
+        const auto status = std::string("S") + std::to_string((id + 1000) % 3);
+        doc.WriteToChunk(chunk_index, row, 0, id_str.data(), id_str.size());
+        doc.WriteToChunk(chunk_index, row, 1, grade.data(), grade.size());
+        doc.WriteToChunk(chunk_index, row, 2, country.data(), country.size());
+        doc.WriteToChunk(chunk_index, row, 3, status.data(), status.size());
+        doc.WriteToChunk(chunk_index, row, 4, country.data(), country.size());
+      }
+      doc.FinishChunk(chunk_index);
+    }
+
+    // the same aggregates over the extracted cells
+    const auto ids = doc.GetAsInt64("id");
+    const auto id_validity = doc.GetValidity("id");
+    const auto grades = doc.GetAsDouble("grade");
+    const auto grade_validity = doc.GetValidity("grade");
+    const auto country_values = doc.GetAsString("country");
+    const auto statuses = doc.GetAsString("status");
+    const csv::ColumnAggregate<int64_t> none{0u, 0u, 0, 0, 0};
+    auto id_expected = none;
+    std::map<std::string, csv::ColumnAggregate<int64_t>> ids_by_status;
+    std::map<std::string, size_t> grade_counts_by_country;
+    double grade_sum = 0.0;
+    for (size_t row = 0u; row < ids.size(); ++row) {
+      auto& group = ids_by_status.emplace(statuses[row], none).first->second;
+      ++id_expected.num_rows;
+      ++group.num_rows;
+      if (id_validity[row]) {
+        for (auto aggregate : {&id_expected, &group}) {
+          const bool first = aggregate->count == 0u;
+          aggregate->min = first ? ids[row] : std::min(aggregate->min, ids[row]);
+          aggregate->max = first ? ids[row] : std::max(aggregate->max, ids[row]);
+          ++aggregate->count;
+          aggregate->sum += ids[row];
+        }
+      }
+      if (grade_validity[row]) {
+        grade_sum += grades[row];
+        ++grade_counts_by_country[country_values[row]];
+      }
+    }
+    ASSERT_GT(doc.NullCount("id"), 0u);
+
+    const auto id_aggregate = doc.AggregateInt64("id");
+    EXPECT_EQ(47003u, id_aggregate.num_rows);
+    EXPECT_EQ(id_expected.count, id_aggregate.count);
+    EXPECT_EQ(id_expected.sum, id_aggregate.sum);
+    EXPECT_EQ(id_expected.min, id_aggregate.min);
+    EXPECT_EQ(id_expected.max, id_aggregate.max);
+    EXPECT_DOUBLE_EQ(static_cast<double>(id_expected.sum) / id_expected.count,
+                     id_aggregate.Mean());
+
+    const auto grade_aggregate = doc.AggregateDouble("grade");
+    EXPECT_EQ(grades.size() - doc.NullCount("grade"), grade_aggregate.count);
+    EXPECT_NEAR(grade_sum, grade_aggregate.sum, 1e-6 * std::abs(grade_sum));
+    EXPECT_DOUBLE_EQ(-999.25, grade_aggregate.min);
+    EXPECT_DOUBLE_EQ(999.25, grade_aggregate.max);
+    // the same whatever the threads
+    EXPECT_EQ(grade_aggregate.sum, doc.AggregateDouble("grade").sum);
+
+    const auto by_status = doc.AggregateInt64By("id", "status");
+    ASSERT_EQ(3u, by_status.size());
+    for (const auto& group : by_status) {
+      const auto& expected = ids_by_status.at(group.first);
+      EXPECT_EQ(expected.num_rows, group.second.num_rows);
+      EXPECT_EQ(expected.count, group.second.count);
+      EXPECT_EQ(expected.sum, group.second.sum);
+      EXPECT_EQ(expected.min, group.second.min);
+      EXPECT_EQ(expected.max, group.second.max);
+    }
+
+    // STRING and VARSTRING keys, nulls being the empty string
+    for (const auto key_column : {"country", "city"}) {
+      const auto by_country = doc.AggregateDoubleBy("grade", key_column);
+      ASSERT_EQ(4u, by_country.size());
+      EXPECT_EQ(1u, by_country.count(""));
+      size_t num_rows = 0u;
+      for (const auto& group : by_country) {
+        EXPECT_EQ(grade_counts_by_country[group.first], group.second.count);
+        num_rows += group.second.num_rows;
+      }
+      EXPECT_EQ(ids.size(), num_rows);
+    }
+
+    EXPECT_THROW(doc.AggregateInt64("grade"), std::invalid_argument);
+    EXPECT_THROW(doc.AggregateDouble("country"), std::invalid_argument);
+    EXPECT_THROW(doc.AggregateDouble("nothing"), std::invalid_argument);
+    EXPECT_THROW(doc.AggregateInt64By("id", "grade"), std::invalid_argument);
+    EXPECT_THROW(doc.AggregateInt64By("status", "country"), std::invalid_argument);
+
+    // a cleared document
+    doc.Clear();
+    const auto empty = doc.AggregateDouble("grade");
+    EXPECT_EQ(0u, empty.num_rows);
+    EXPECT_EQ(0u, empty.count);
+    EXPECT_EQ(0.0, empty.min);
+    EXPECT_TRUE(std::isnan(empty.Mean()));
+    EXPECT_TRUE(doc.AggregateInt64By("id", "status").empty());
+  }
+}
+
+TEST(TestDocument, TestColumnIndex) {
+  csv::Document doc(std::vector<std::string>{"id", "name", "id"},
+                    std::vector<csv::FieldType>{csv::FieldType::INT64,
+                                                csv::FieldType::STRING,
+                                                csv::FieldType::INT64});
+  EXPECT_EQ(0u, doc.ColumnIndex("id"));
+  EXPECT_EQ(1u, doc.ColumnIndex("name"));
+  EXPECT_THROW(doc.ColumnIndex("nam"), std::invalid_argument);
+  EXPECT_THROW(doc.ColumnIndex(""), std::invalid_argument);
+}
+
 }  // anonymous namespace
@@ -0,0 +1,257 @@
+#include "filter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace csv {
+
+struct Filter::Node {
+  enum class Kind { COMPARE = 0, AND, OR };
+  enum class ValueKind { INT64 = 0, DOUBLE, STRING };
+
+  Kind kind;
+  // COMPARE
+  std::string column;
+  CompareOp op;
+  ValueKind value_kind;
+  int64_t int_value;
+  double double_value;
+  std::string string_value;
+  // AND, OR
+  std::shared_ptr<const Node> lhs;
+  std::shared_ptr<const Node> rhs;
+};
+
+namespace {
+
+using Node = Filter::Node;
+
+std::shared_ptr<Node> NewCompareNode(const std::string& column, CompareOp op,
+                                     Node::ValueKind value_kind) {
+  std::shared_ptr<Node> node(new Node());
+  node->kind = Node::Kind::COMPARE;
+  node->column = column;
+  node->op = op;
+  node->value_kind = value_kind;
+  node->int_value = 0;
+  node->double_value = 0.0;
+  return node;
+}
+
+template <typename T>
+bool Compare(CompareOp op, const T& lhs, const T& rhs) {
+  switch (op) {
+  case CompareOp::EQ:
+    return lhs == rhs;
+  case CompareOp::NE:
+    return !(lhs == rhs);
+  case CompareOp::LT:
+    return lhs < rhs;
+  case CompareOp::LE:
+    return !(rhs < lhs);
+  case CompareOp::GT:
+    return rhs < lhs;
+  case CompareOp::GE:
+    return !(lhs < rhs);
+  default:
+    return false;
+  }
+}
+
+// CompareString() compares like std::string::compare(), without building one
+int CompareString(const char* str, size_t str_length, const std::string& value) {
+  const auto common = std::min(str_length, value.size());
+  const int result = common == 0u ? 0 : std::memcmp(str, value.data(), common);
+  if (result != 0) {
+    return result;
+  }
+  return str_length < value.size() ? -1 : (str_length > value.size() ? 1 : 0);
+}
+
+bool IsStringType(FieldType type) {
+  return type == FieldType::STRING || type == FieldType::VARSTRING ||
+         type == FieldType::CATEGORY;
+}
+
+}  // namespace
+
+Filter Filter::Compare(const std::string& column, CompareOp op, int64_t value) {
+  auto node = NewCompareNode(column, op, Node::ValueKind::INT64);
+  node->int_value = value;
+  node->double_value = static_cast<double>(value);
+  return Filter(node);
+}
+
+Filter Filter::Compare(const std::string& column, CompareOp op, double value) {
+  auto node = NewCompareNode(column, op, Node::ValueKind::DOUBLE);
+  node->double_value = value;
+  return Filter(node);
+}
+
+Filter Filter::Compare(const std::string& column, CompareOp op,
+                       const std::string& value) {
+  auto node = NewCompareNode(column, op, Node::ValueKind::STRING);
+  node->string_value = value;
+  return Filter(node);
+}
+
+Filter Filter::And(const Filter& lhs, const Filter& rhs) {
+  if (lhs.Empty() || rhs.Empty()) {
+    return lhs.Empty() ? rhs : lhs;
+  }
+  std::shared_ptr<Node> node(new Node());
+  node->kind = Node::Kind::AND;
+  node->lhs = lhs.root_;
+  node->rhs = rhs.root_;
+  return Filter(node);
+}
+
+Filter Filter::Or(const Filter& lhs, const Filter& rhs) {
+  // an empty filter keeps everything
+  if (lhs.Empty() || rhs.Empty()) {
+    return Filter();
+  }
+  std::shared_ptr<Node> node(new Node());
+  node->kind = Node::Kind::OR;
+  node->lhs = lhs.root_;
+  node->rhs = rhs.root_;
+  return Filter(node);
+}
+
+RecordFilter::RecordFilter(const Filter& filter,
+                           const std::vector<std::string>& column_names,
+                           const std::vector<FieldType>& field_types)
+    : filter_(filter),
+      leaves_by_column_(column_names.size()),
+      convert_as_(column_names.size(), CompareAs::STRING),
+      last_column_(0u),
+      int_values_(column_names.size()),
+      double_values_(column_names.size()) {
+  if (filter.Empty()) {
+    return;
+  }
+  Flatten(*filter.root_, column_names, field_types);
+  // cells are converted once, as the column's type, so a number compares as an
+  // INT64 only with an INT64 constant and cell
+  for (size_t column = 0u; column < leaves_by_column_.size(); ++column) {
+    for (const auto idx : leaves_by_column_[column]) {
+      auto& flat_node = nodes_[idx];
+      if (flat_node.compare_as != CompareAs::STRING) {
+        const bool int64 = convert_as_[column] == CompareAs::INT64 &&
+                           flat_node.node->value_kind == Node::ValueKind::INT64;
+        flat_node.compare_as = int64 ? CompareAs::INT64 : CompareAs::DOUBLE;
+      }
+    }
+  }
+  results_.resize(nodes_.size());
+}
+
+size_t RecordFilter::Flatten(const Filter::Node& node,
+                             const std::vector<std::string>& column_names,
+                             const std::vector<FieldType>& field_types) {
+  FlatNode flat_node{&node, 0u, 0u, CompareAs::INT64};
+  if (node.kind != Node::Kind::COMPARE) {
+    flat_node.lhs = Flatten(*node.lhs, column_names, field_types);
+    flat_node.rhs = Flatten(*node.rhs, column_names, field_types);
+    nodes_.push_back(flat_node);
+    return nodes_.size() - 1;
+  }
+
+  const auto found = std::find(column_names.begin(), column_names.end(), node.column);
+  if (found == column_names.end()) {
+    throw std::invalid_argument(std::string("no column with name ") + node.column);
+  }
+  const auto column = static_cast<size_t>(found - column_names.begin());
+  const auto field_type = field_types[column];
+  if (node.value_kind == Node::ValueKind::STRING) {
+    if (field_type != FieldType::SKIP && !IsStringType(field_type)) {
+      throw std::invalid_argument(std::string("can't compare a string with column ") +
+                                  node.column);
+    }
+    flat_node.compare_as = CompareAs::STRING;
+  } else {
+    if (IsStringType(field_type)) {
+      throw std::invalid_argument(std::string("can't compare a number with column ") +
+                                  node.column);
+    }
+    // a SKIP column is converted as its constants are, as a DOUBLE if any is one
+    auto& convert_as = convert_as_[column];
+    if (field_type == FieldType::DOUBLE ||
+        (field_type == FieldType::SKIP && node.value_kind == Node::ValueKind::DOUBLE)) {
+      convert_as = CompareAs::DOUBLE;
+    } else if (convert_as != CompareAs::DOUBLE) {
+      convert_as = CompareAs::INT64;
+    }
+    flat_node.compare_as = convert_as;
+  }
+
+  nodes_.push_back(flat_node);
+  leaves_by_column_[column].push_back(nodes_.size() - 1);
+  last_column_ = std::max(last_column_, column);
+  return nodes_.size() - 1;
+}
+
+void RecordFilter::SetCell(size_t column, const char* str, size_t str_length) {
+  const auto& leaves = leaves_by_column_[column];
+  // an empty cell is a null, which compares false with anything as in SQL
+  if (str_length == 0u) {
+    int_values_[column] = 0;
+    double_values_[column] = 0.0;
+    for (const auto idx : leaves) {
+      results_[idx] = false;
+    }
+    return;
+  }
+  // once per cell, however many comparisons use it
+  switch (convert_as_[column]) {
+  case CompareAs::INT64:
+    int_values_[column] = Convert<int64_t>(str, str_length);
+    double_values_[column] = static_cast<double>(int_values_[column]);
+    break;
+  case CompareAs::DOUBLE:
+    double_values_[column] = Convert<double>(str, str_length);
+    break;
+  default:
+    break;
+  }
+  for (const auto idx : leaves) {
+    const auto& flat_node = nodes_[idx];
+    const auto& node = *flat_node.node;
+    bool result = false;
+    switch (flat_node.compare_as) {
+    case CompareAs::INT64:
+      result = Compare(node.op, int_values_[column], node.int_value);
+      break;
+    case CompareAs::DOUBLE:
+      result = Compare(node.op, double_values_[column], node.double_value);
+      break;
+    case CompareAs::STRING:
+      result = Compare(node.op, CompareString(str, str_length, node.string_value), 0);
+      break;
+    }
+    results_[idx] = result;
+  }
+}
+
+bool RecordFilter::Accept() {
+  if (nodes_.empty()) {
+    return true;
+  }
+  for (size_t idx = 0u; idx < nodes_.size(); ++idx) {
+    const auto& flat_node = nodes_[idx];
+    switch (flat_node.node->kind) {
+    case Node::Kind::AND:
+      results_[idx] = results_[flat_node.lhs] && results_[flat_node.rhs];
+      break;
+    case Node::Kind::OR:
+      results_[idx] = results_[flat_node.lhs] || results_[flat_node.rhs];
+      break;
+    default:
+      break;
+    }
+  }
+  return results_.back() != 0;
+}
+
+}  // namespace csv
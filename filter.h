@@ -0,0 +1,111 @@
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base.h"
+
+namespace csv {
+
+enum class CompareOp { EQ = 0, NE, LT, LE, GT, GE };
+
+// Filter is a predicate on records of a CSV file: comparisons of a column with a
+// constant, composed with And() and Or(). An empty Filter keeps every record.
+// Columns are named as in the CSV header and may be FieldType::SKIP columns.
+// An empty cell is a null, which compares false with any constant whatever the
+// operator, as in SQL: neither Compare(c, EQ, 0) nor Compare(c, NE, 0) keeps it.
+class Filter {
+public:
+  Filter() = default;
+
+  static Filter Compare(const std::string& column, CompareOp op, int64_t value);
+  static Filter Compare(const std::string& column, CompareOp op, double value);
+  static Filter Compare(const std::string& column, CompareOp op,
+                        const std::string& value);
+  static Filter Compare(const std::string& column, CompareOp op, const char* value) {
+    return Compare(column, op, std::string(value));
+  }
+  static Filter And(const Filter& lhs, const Filter& rhs);
+  static Filter Or(const Filter& lhs, const Filter& rhs);
+
+  bool Empty() const { return !root_; }
+
+  // a node of the expression, opaque outside filter.cpp
+  struct Node;
+
+private:
+  friend class RecordFilter;
+
+  explicit Filter(std::shared_ptr<const Node> root) : root_(std::move(root)) {}
+
+  std::shared_ptr<const Node> root_;
+};
+
+// RecordFilter evaluates a Filter while a record is being tokenized: each compared
+// cell is converted as soon as SetCell() is given it, and Accept() decides once the
+// last compared column (LastColumn()) has been set. Cells after it never need to
+// be looked at for a rejected record.
+// A RecordFilter keeps the state of one record, so every thread needs a copy.
+class RecordFilter {
+public:
+  RecordFilter() : last_column_(0u) {}
+  // throws std::invalid_argument for unknown columns or a constant which can't be
+  // compared with its column (a number with a string column or the other way)
+  RecordFilter(const Filter& filter, const std::vector<std::string>& column_names,
+               const std::vector<FieldType>& field_types);
+
+  bool Empty() const { return nodes_.empty(); }
+  size_t LastColumn() const { return last_column_; }
+  bool Compares(size_t column) const {
+    return column < leaves_by_column_.size() && !leaves_by_column_[column].empty();
+  }
+
+  void SetCell(size_t column, const char* str, size_t str_length);
+  // Accept() returns whether the current record is kept
+  bool Accept();
+  // Converted() returns whether SetCell() converts the cells of column to a number
+  // (those of INT64 and DOUBLE columns which are compared with one). Int64Value() or
+  // DoubleValue(), by the type of the column, then return that number for the
+  // current record, 0 for an empty cell, so it needn't be converted again.
+  bool Converted(size_t column) const {
+    return column < convert_as_.size() && convert_as_[column] != CompareAs::STRING;
+  }
+  int64_t Int64Value(size_t column) const { return int_values_[column]; }
+  double DoubleValue(size_t column) const { return double_values_[column]; }
+
+private:
+  // how a cell is compared with the constant
+  enum class CompareAs { INT64 = 0, DOUBLE, STRING };
+
+  // nodes are stored children first, so evaluating them in order works bottom up
+  struct FlatNode {
+    const Filter::Node* node;
+    size_t lhs;
+    size_t rhs;
+    CompareAs compare_as;
+  };
+
+  size_t Flatten(const Filter::Node& node, const std::vector<std::string>& column_names,
+                 const std::vector<FieldType>& field_types);
+
+  // keeps the nodes alive
+  Filter filter_;
+  std::vector<FlatNode> nodes_;
+  std::vector<std::vector<size_t>> leaves_by_column_;
+  // how the cells of a column are converted, STRING when they are not
+  std::vector<CompareAs> convert_as_;
+  size_t last_column_;
+  // converted cells of the current record
+  std::vector<int64_t> int_values_;
+  std::vector<double> double_values_;
+  // result of every node for the current record
+  std::vector<char> results_;
+};
+
+}  // namespace csv
+
+#endif
@@ -0,0 +1,142 @@
+#include "filter.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+using CompareOp = csv::CompareOp;
+using Filter = csv::Filter;
+using FieldType = csv::FieldType;
+
+const std::vector<std::string> kColumnNames{"id", "grade", "country", "note"};
+const std::vector<FieldType> kFieldTypes{FieldType::INT64, FieldType::DOUBLE,
+                                         FieldType::STRING, FieldType::SKIP};
+
+// Accepts() runs a record of cells through filter
+bool Accepts(const Filter& filter, const std::vector<std::string>& cells) {
+  csv::RecordFilter record_filter(filter, kColumnNames, kFieldTypes);
+  for (size_t column = 0u; column < cells.size(); ++column) {
+    if (record_filter.Compares(column)) {
+      record_filter.SetCell(column, cells[column].data(), cells[column].size());
+    }
+  }
+  return record_filter.Accept();
+}
+
+TEST(TestFilter, Compare) {
+  const std::vector<std::string> record{"10", "2.5", "KR", "x"};
+  EXPECT_TRUE(Accepts(Filter::Compare("id", CompareOp::EQ, int64_t{10}), record));
+  EXPECT_FALSE(Accepts(Filter::Compare("id", CompareOp::NE, int64_t{10}), record));
+  EXPECT_TRUE(Accepts(Filter::Compare("id", CompareOp::LT, int64_t{11}), record));
+  EXPECT_FALSE(Accepts(Filter::Compare("id", CompareOp::LT, int64_t{10}), record));
+  EXPECT_TRUE(Accepts(Filter::Compare("id", CompareOp::LE, int64_t{10}), record));
+  EXPECT_TRUE(Accepts(Filter::Compare("id", CompareOp::GT, int64_t{9}), record));
+  EXPECT_TRUE(Accepts(Filter::Compare("id", CompareOp::GE, int64_t{10}), record));
+  EXPECT_FALSE(Accepts(Filter::Compare("id", CompareOp::GE, int64_t{11}), record));
+
+  // an int64 column compared with a double is compared as double
+  EXPECT_TRUE(Accepts(Filter::Compare("id", CompareOp::LT, 10.5), record));
+  EXPECT_TRUE(Accepts(Filter::Compare("grade", CompareOp::GT, int64_t{2}), record));
+  EXPECT_FALSE(Accepts(Filter::Compare("grade", CompareOp::GT, 2.5), record));
+
+  EXPECT_TRUE(Accepts(Filter::Compare("country", CompareOp::EQ, "KR"), record));
+  EXPECT_FALSE(Accepts(Filter::Compare("country", CompareOp::EQ, "K"), record));
+  EXPECT_TRUE(Accepts(Filter::Compare("country", CompareOp::LT, "US"), record));
+  EXPECT_TRUE(Accepts(Filter::Compare("country", CompareOp::GT, "K"), record));
+
+  // SKIP columns can be compared, as what the constant is
+  EXPECT_TRUE(Accepts(Filter::Compare("note", CompareOp::EQ, "x"), record));
+  EXPECT_TRUE(Accepts(Filter::Compare("note", CompareOp::NE, "y"), record));
+
+}
+
+TEST(TestFilter, EmptyCells) {
+  // nulls compare false whatever the operator
+  const std::vector<std::string> record{"", "", "", ""};
+  for (auto op : {CompareOp::EQ, CompareOp::NE, CompareOp::LT, CompareOp::LE,
+                  CompareOp::GT, CompareOp::GE}) {
+    EXPECT_FALSE(Accepts(Filter::Compare("id", op, int64_t{0}), record));
+    EXPECT_FALSE(Accepts(Filter::Compare("id", op, 0.0), record));
+    EXPECT_FALSE(Accepts(Filter::Compare("grade", op, -1.0), record));
+    EXPECT_FALSE(Accepts(Filter::Compare("country", op, ""), record));
+    EXPECT_FALSE(Accepts(Filter::Compare("note", op, "x"), record));
+  }
+  // but may be kept through Or()
+  EXPECT_TRUE(Accepts(Filter::Or(Filter::Compare("id", CompareOp::GT, int64_t{-1}),
+                                 Filter::Compare("country", CompareOp::EQ, "KR")),
+                      std::vector<std::string>{"", "1", "KR", "x"}));
+}
+
+TEST(TestFilter, AndOr) {
+  const std::vector<std::string> record{"10", "2.5", "KR", "x"};
+  const auto is_kr = Filter::Compare("country", CompareOp::EQ, "KR");
+  const auto is_us = Filter::Compare("country", CompareOp::EQ, "US");
+  const auto big_id = Filter::Compare("id", CompareOp::GT, int64_t{5});
+
+  EXPECT_TRUE(Accepts(Filter::And(is_kr, big_id), record));
+  EXPECT_FALSE(Accepts(Filter::And(is_us, big_id), record));
+  EXPECT_TRUE(Accepts(Filter::Or(is_us, big_id), record));
+  EXPECT_FALSE(Accepts(Filter::Or(is_us, Filter::Compare("grade", CompareOp::LT, 1.0)),
+                       record));
+  EXPECT_TRUE(Accepts(Filter::And(Filter::Or(is_us, is_kr), Filter::And(big_id, big_id)),
+                      record));
+
+  // an empty filter keeps everything
+  EXPECT_TRUE(Accepts(Filter(), record));
+  EXPECT_FALSE(Accepts(Filter::And(Filter(), is_us), record));
+  EXPECT_TRUE(Accepts(Filter::Or(Filter(), is_us), record));
+}
+
+TEST(TestFilter, LastColumn) {
+  csv::RecordFilter record_filter(
+      Filter::And(Filter::Compare("grade", CompareOp::GT, 1.0),
+                  Filter::Compare("id", CompareOp::GT, int64_t{1})),
+      kColumnNames, kFieldTypes);
+  EXPECT_EQ(1u, record_filter.LastColumn());
+  EXPECT_TRUE(record_filter.Compares(0u));
+  EXPECT_TRUE(record_filter.Compares(1u));
+  EXPECT_FALSE(record_filter.Compares(2u));
+}
+
+TEST(TestFilter, Converted) {
+  // a compared number is converted once, as its column's type, and kept
+  csv::RecordFilter record_filter(
+      Filter::And(Filter::Compare("id", CompareOp::GT, int64_t{1}),
+                  Filter::Compare("id", CompareOp::LT, 10.5)),
+      kColumnNames, kFieldTypes);
+  EXPECT_TRUE(record_filter.Converted(0u));
+  EXPECT_FALSE(record_filter.Converted(1u));
+  EXPECT_FALSE(record_filter.Converted(2u));
+  record_filter.SetCell(0u, "10", 2u);
+  EXPECT_EQ(10, record_filter.Int64Value(0u));
+  EXPECT_TRUE(record_filter.Accept());
+  record_filter.SetCell(0u, "", 0u);
+  EXPECT_EQ(0, record_filter.Int64Value(0u));
+  EXPECT_FALSE(record_filter.Accept());
+
+  // a SKIP column compared with a double and an int64 is converted as a double
+  const std::vector<std::string> record{"1", "2.5", "KR", "7"};
+  EXPECT_TRUE(Accepts(Filter::And(Filter::Compare("note", CompareOp::EQ, int64_t{7}),
+                                  Filter::Compare("note", CompareOp::LT, 7.5)),
+                      record));
+  EXPECT_FALSE(Accepts(Filter::And(Filter::Compare("note", CompareOp::EQ, int64_t{7}),
+                                   Filter::Compare("note", CompareOp::GT, 7.5)),
+                       record));
+}
+
+TEST(TestFilter, Invalid) {
+  EXPECT_THROW(csv::RecordFilter(Filter::Compare("nothing", CompareOp::EQ, int64_t{1}),
+                                 kColumnNames, kFieldTypes),
+               std::invalid_argument);
+  EXPECT_THROW(csv::RecordFilter(Filter::Compare("id", CompareOp::EQ, "1"), kColumnNames,
+                                 kFieldTypes),
+               std::invalid_argument);
+  EXPECT_THROW(csv::RecordFilter(Filter::Compare("country", CompareOp::EQ, int64_t{1}),
+                                 kColumnNames, kFieldTypes),
+               std::invalid_argument);
+}
+
+}  // anonymous namespace
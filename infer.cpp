@@ -0,0 +1,179 @@
+#include "infer.h"
+
+#include "decompress.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace csv {
+
+namespace {
+
+// decompressed beyond the samples of a compressed file, for its header
+constexpr size_t kMaxHeaderSize = 64 * 1024;
+
+// ColumnKind is ordered: a column ends up as the widest kind of its cells
+enum class ColumnKind { EMPTY = 0, INT64, DOUBLE, STRING };
+
+ColumnKind CellKind(const char* cell, size_t cell_size) {
+  if (cell_size == 0u) {
+    return ColumnKind::EMPTY;
+  }
+  int64_t int_value = 0;
+  if (ParseInt64(cell, cell_size, int_value) == ParseStatus::OK) {
+    return ColumnKind::INT64;
+  }
+  double double_value = 0.0;
+  if (ParseDouble(cell, cell_size, double_value) == ParseStatus::OK) {
+    return ColumnKind::DOUBLE;
+  }
+  return ColumnKind::STRING;
+}
+
+FieldType ToFieldType(ColumnKind kind) {
+  switch (kind) {
+  case ColumnKind::INT64:
+    return FieldType::INT64;
+  case ColumnKind::DOUBLE:
+    return FieldType::DOUBLE;
+  default:
+    // unsampled cells may be of any length, which a STRING cell can't hold
+    return FieldType::VARSTRING;
+  }
+}
+
+// SampleKinds() widens kinds with the records of [begin, end). A record cut by end
+// is ignored unless is_last, as is any record without kinds.size() cells.
+void SampleKinds(const char* begin, const char* end, bool is_last,
+                 const ReadOptions& options, std::vector<ColumnKind>& kinds) {
+  const size_t column_size = kinds.size();
+  std::vector<ColumnKind> record_kinds(column_size);
+  size_t column = 0u;
+  bool quoted = false;
+  const char* cell_start = begin;
+
+  auto end_cell = [&](const char* cell_end) {
+    if (column < column_size) {
+      record_kinds[column] =
+          CellKind(cell_start, static_cast<size_t>(cell_end - cell_start));
+    }
+    ++column;
+  };
+  auto end_record = [&](const char* record_end) {
+    const char* cell_end = record_end;
+    if (cell_end > cell_start && *(cell_end - 1) == '\r') {
+      --cell_end;
+    }
+    // an empty record
+    if (column == 0u && cell_end == cell_start) {
+      return;
+    }
+    end_cell(cell_end);
+    if (column == column_size) {
+      for (size_t idx = 0u; idx < column_size; ++idx) {
+        kinds[idx] = std::max(kinds[idx], record_kinds[idx]);
+      }
+    }
+  };
+
+  for (const char* position = begin; position < end; ++position) {
+    const char current_char = *position;
+    if (current_char == options.quotechar) {
+      quoted = !quoted;
+    } else if (!quoted && current_char == options.separator) {
+      end_cell(position);
+      cell_start = position + 1;
+    } else if (!quoted && current_char == '\n') {
+      end_record(position);
+      column = 0u;
+      cell_start = position + 1;
+    }
+  }
+  if (is_last && cell_start < end) {
+    end_record(end);
+  }
+}
+
+}  // namespace
+
+std::vector<FieldType> InferFieldTypes(const std::string& path,
+                                       const ReadOptions& options, size_t num_samples,
+                                       size_t sample_size) {
+  std::vector<std::string> column_names;
+  std::unique_ptr<MappedFile> file;
+  std::vector<char> head;
+  const char* data = nullptr;
+  const char* end = nullptr;
+  bool is_whole_file = true;
+  const auto compression = DetectCompression(path);
+  if (compression == Compression::NONE) {
+    std::ifstream file_in(path);
+    column_names = ColumnNames(file_in, path, options);
+    file.reset(new MappedFile(path));
+    data = file->Data();
+    end = data + file->Size();
+  } else {
+    // a compressed file can't be read at random: its head is sampled instead
+    const auto buffer =
+        OpenDecompressed(path, compression, options.num_threads, &options.Pool());
+    head.resize(std::max(num_samples, size_t{1u}) * sample_size + kMaxHeaderSize);
+    const auto head_size = static_cast<size_t>(
+        buffer->sgetn(head.data(), static_cast<std::streamsize>(head.size())));
+    is_whole_file = head_size < head.size();
+    head.resize(head_size);
+    data = head.data();
+    end = data + head.size();
+    const auto line_end = std::find(data, end, '\n');
+    std::istringstream header_in(std::string(data, line_end));
+    column_names = ColumnNames(header_in, path, options);
+  }
+  const char* header_end =
+      static_cast<const char*>(std::memchr(data, '\n', static_cast<size_t>(end - data)));
+  const char* const records_begin = header_end == nullptr ? end : header_end + 1;
+  const auto records_size = static_cast<size_t>(end - records_begin);
+
+  num_samples = std::max(num_samples, size_t{1u});
+  // samples would overlap
+  if (num_samples * sample_size > records_size) {
+    num_samples = std::max(size_t{1u}, records_size / std::max(sample_size, size_t{1u}));
+  }
+
+  std::vector<std::vector<ColumnKind>> sample_kinds(
+      num_samples, std::vector<ColumnKind>(column_names.size(), ColumnKind::EMPTY));
+  options.Pool().ParallelFor(num_samples, options.num_threads, [&](size_t idx) {
+    const char* sample_begin = records_begin + records_size / num_samples * idx;
+    const char* sample_end =
+        static_cast<size_t>(end - sample_begin) > sample_size ? sample_begin + sample_size
+                                                              : end;
+    if (file) {
+      file->WillNeed(static_cast<size_t>(sample_begin - data),
+                     static_cast<size_t>(sample_end - sample_begin));
+    }
+    if (idx != 0u) {
+      // skip the rest of the record the sample starts in
+      const auto newline = static_cast<const char*>(std::memchr(
+          sample_begin, '\n', static_cast<size_t>(sample_end - sample_begin)));
+      sample_begin = newline == nullptr ? sample_end : newline + 1;
+    }
+    SampleKinds(sample_begin, sample_end, is_whole_file && sample_end == end, options,
+                sample_kinds[idx]);
+  });
+
+  std::vector<FieldType> field_types;
+  field_types.reserve(column_names.size());
+  for (size_t column = 0u; column < column_names.size(); ++column) {
+    auto kind = ColumnKind::EMPTY;
+    for (const auto& kinds : sample_kinds) {
+      kind = std::max(kind, kinds[column]);
+    }
+    field_types.push_back(ToFieldType(kind));
+  }
+  return field_types;
+}
+
+}  // namespace csv
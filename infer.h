@@ -0,0 +1,34 @@
+#ifndef __INFER_H__
+#define __INFER_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "base.h"
+#include "read.h"
+
+namespace csv {
+
+constexpr size_t kDefaultNumSamples = 16u;
+constexpr size_t kDefaultSampleSize = 64 * 1024;  // 64KB
+
+// InferFieldTypes() guesses the type of every column of a CSV file from the
+// records found in num_samples windows of sample_size bytes spread evenly over the
+// file, tokenized in parallel. Only those windows are read; of a compressed file
+// (see decompress.h), which can't be read at random, only its head of as many bytes.
+// A column is INT64 when all its sampled cells are integers, DOUBLE when they are
+// numbers, otherwise VARSTRING, as cells outside the samples may be longer than a
+// STRING cell holds. Empty cells don't count; a column without any sampled value
+// is VARSTRING. The types are a guess: ReadCSV() widens a column a cell outside the
+// samples doesn't fit, while callers reading with them otherwise get an error.
+// A window starting in the middle of a quoted cell can't be told apart from one
+// that doesn't, so records with the wrong number of cells are ignored.
+std::vector<FieldType> InferFieldTypes(const std::string& path,
+                                       const ReadOptions& options = ReadOptions(),
+                                       size_t num_samples = kDefaultNumSamples,
+                                       size_t sample_size = kDefaultSampleSize);
+
+}  // namespace csv
+
+#endif
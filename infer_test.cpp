@@ -0,0 +1,125 @@
+#include "infer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace {
+
+using FieldType = csv::FieldType;
+
+struct TempFileHandle {
+  std::string file_name;
+  TempFileHandle(): file_name(std::tmpnam(nullptr)) {}
+  ~TempFileHandle() { if (!file_name.empty()) std::remove(file_name.c_str()); }
+};
+
+TEST(TestInfer, InferFieldTypes) {
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,grade,name,empty,mixed,long\r\n";
+  ofs << "1,1.5,KR,,1," << std::string(70, 'l') << "\r\n";
+  ofs << "2,2,\"a,b\",,x,s\r\n";
+  ofs << "-3,1e3,US,,2.5,s";
+  ofs.close();
+
+  EXPECT_EQ((std::vector<FieldType>{FieldType::INT64, FieldType::DOUBLE,
+                                    FieldType::VARSTRING, FieldType::VARSTRING,
+                                    FieldType::VARSTRING, FieldType::VARSTRING}),
+            csv::InferFieldTypes(file_handle.file_name));
+}
+
+TEST(TestInfer, InferFieldTypesSampled) {
+  // many samples, most of them starting in the middle of a record, some in the
+  // middle of a quoted cell holding separators and newlines
+  constexpr int64_t num_rows = 100000;
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id|note|grade\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ofs << row << "|\"1|2\n3|4\"|" << row << ".25\n";
+  }
+  ofs.close();
+
+  csv::ReadOptions options('"', '|', 4);
+  for (size_t num_samples : {1u, 7u, 64u}) {
+    EXPECT_EQ((std::vector<FieldType>{FieldType::INT64, FieldType::VARSTRING,
+                                      FieldType::DOUBLE}),
+              csv::InferFieldTypes(file_handle.file_name, options, num_samples, 4096u));
+  }
+
+  auto document = csv::ReadCSV(file_handle.file_name, options);
+  ASSERT_EQ(static_cast<size_t>(num_rows), document.NumRows());
+  EXPECT_EQ(num_rows - 1, document.GetAsInt64("id").back());
+  EXPECT_DOUBLE_EQ(num_rows - 0.75, document.GetAsDouble("grade").back());
+}
+
+TEST(TestInfer, LongStringOutsideSamples) {
+  // a cell longer than a STRING cell holds, far from every sample
+  constexpr int64_t num_rows = 200000;
+  constexpr int64_t long_row = 123457;
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,name\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ofs << row << ',' << (row == long_row ? std::string(100, 'x') : "short") << '\n';
+  }
+  ofs.close();
+
+  const auto field_types =
+      csv::InferFieldTypes(file_handle.file_name, csv::ReadOptions(), 2u, 1024u);
+  EXPECT_EQ((std::vector<FieldType>{FieldType::INT64, FieldType::VARSTRING}),
+            field_types);
+  auto document = csv::ReadCSV(file_handle.file_name, field_types);
+  ASSERT_EQ(static_cast<size_t>(num_rows), document.NumRows());
+  EXPECT_EQ(std::string(100, 'x'), document.GetAsString("name")[long_row]);
+}
+
+TEST(TestInfer, NumberOutsideSamples) {
+  // cells which don't fit the sampled types, each between two samples of records
+  // of the same size
+  constexpr int64_t num_rows = 200000;
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,count,grade,score\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ofs << 100000 + row << ',' << (row == num_rows / 32 ? "1.5" : "1") << ','
+        << (row == num_rows * 3 / 32 ? "n/a" : "2.5") << ','
+        << (row == num_rows * 5 / 32 ? "x" : "3") << '\n';
+  }
+  ofs.close();
+
+  csv::ReadOptions options('"', ',', 4);
+  EXPECT_EQ((std::vector<FieldType>{FieldType::INT64, FieldType::INT64,
+                                    FieldType::DOUBLE, FieldType::INT64}),
+            csv::InferFieldTypes(file_handle.file_name, options));
+  const auto field_types = csv::InferFieldTypes(file_handle.file_name, options);
+  EXPECT_THROW(csv::ReadCSV(file_handle.file_name, field_types, options),
+               std::invalid_argument);
+
+  // ReadCSV() widens the columns and parses the file again
+  for (bool files : {false, true}) {
+    const auto document =
+        files ? csv::ReadCSVFiles({file_handle.file_name}, options)
+              : csv::ReadCSV(file_handle.file_name, options);
+    ASSERT_EQ(static_cast<size_t>(num_rows), document.NumRows());
+    EXPECT_EQ(FieldType::INT64, document.ColumnType(0u));
+    EXPECT_EQ(FieldType::DOUBLE, document.ColumnType(1u));
+    EXPECT_EQ(FieldType::VARSTRING, document.ColumnType(2u));
+    EXPECT_EQ(FieldType::VARSTRING, document.ColumnType(3u));
+    EXPECT_DOUBLE_EQ(1.5, document.GetAsDouble("count")[num_rows / 32]);
+    EXPECT_EQ("n/a", document.GetAsString("grade")[num_rows * 3 / 32]);
+  }
+}
+
+TEST(TestInfer, HeaderOnly) {
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "a,b\n";
+  ofs.close();
+
+  EXPECT_EQ((std::vector<FieldType>{FieldType::VARSTRING, FieldType::VARSTRING}),
+            csv::InferFieldTypes(file_handle.file_name));
+}
+
+}  // anonymous namespace
@@ -0,0 +1,116 @@
+#include "input.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "decompress.h"
+
+namespace csv {
+
+namespace {
+
+// ReadFully() calls read() until size bytes are read or the end is reached
+size_t ReadFully(int fd, char* buffer, size_t size, const std::string& name) {
+  size_t total = 0u;
+  while (total < size) {
+    const ssize_t read_size = read(fd, buffer + total, size - total);
+    if (read_size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("Failed to read ") + name + ": " +
+                               std::strerror(errno));
+    }
+    if (read_size == 0) {
+      break;
+    }
+    total += static_cast<size_t>(read_size);
+  }
+  return total;
+}
+
+}  // namespace
+
+FileSource::FileSource(const std::string& path) : InputSource(path), fd_(-1), size_(0u) {
+  fd_ = open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    throw std::runtime_error(std::string("Failed to open ") + path + ": " +
+                             std::strerror(errno));
+  }
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) == 0) {
+    size_ = static_cast<size_t>(file_stat.st_size);
+  }
+  // only a hint: doubles the kernel's read ahead
+  posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+FileSource::~FileSource() { close(fd_); }
+
+size_t FileSource::Read(char* buffer, size_t size) {
+  return ReadFully(fd_, buffer, size, Name());
+}
+
+size_t MappedSource::Read(char* buffer, size_t size) {
+  size = std::min(size, file_.Size() - offset_);
+  std::memcpy(buffer, file_.Data() + offset_, size);
+  offset_ += size;
+  return size;
+}
+
+size_t MemorySource::Read(char* buffer, size_t size) {
+  size = std::min(size, size_ - offset_);
+  std::memcpy(buffer, data_ + offset_, size);
+  offset_ += size;
+  return size;
+}
+
+size_t StreamSource::Read(char* buffer, size_t size) {
+  if (buffer_ == nullptr) {
+    return 0u;
+  }
+  // sgetn() stops early only at the end
+  return static_cast<size_t>(buffer_->sgetn(buffer, static_cast<std::streamsize>(size)));
+}
+
+size_t DescriptorSource::Read(char* buffer, size_t size) {
+  return ReadFully(fd_, buffer, size, Name());
+}
+
+std::unique_ptr<InputSource> OpenSource(const std::string& path, bool use_mmap,
+                                        int num_threads, ThreadPool* thread_pool) {
+  const auto compression = DetectCompression(path);
+  if (compression != Compression::NONE) {
+    return std::unique_ptr<InputSource>(new StreamSource(
+        OpenDecompressed(path, compression, num_threads, thread_pool), path));
+  }
+  if (use_mmap) {
+    return std::unique_ptr<InputSource>(new MappedSource(path));
+  }
+  return std::unique_ptr<InputSource>(new FileSource(path));
+}
+
+std::vector<char> ReadAll(InputSource& source) {
+  constexpr size_t kMinReadSize = 4 * 1024 * 1024;
+  std::vector<char> content;
+  size_t size = 0u;
+  for (;;) {
+    content.resize(std::max(size + kMinReadSize, std::max(source.Size() + 1, size * 2)));
+    const auto read_size = content.size() - size;
+    const auto actual_size = source.Read(content.data() + size, read_size);
+    size += actual_size;
+    if (actual_size < read_size) {
+      break;
+    }
+  }
+  content.resize(size);
+  return content;
+}
+
+}  // namespace csv
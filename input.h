@@ -0,0 +1,143 @@
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+namespace csv {
+
+// InputSource is what a CSV is parsed from. A source either holds its whole content
+// in memory, which is then parsed in place, or is read front to back into blocks.
+// A source is read once, by a single reader.
+class InputSource {
+public:
+  explicit InputSource(std::string name) : name_(std::move(name)) {}
+  virtual ~InputSource() = default;
+
+  InputSource(const InputSource&) = delete;
+  InputSource& operator=(const InputSource&) = delete;
+
+  // Name() names the source in error messages, e.g. by its path
+  const std::string& Name() const { return name_; }
+
+  // Data() returns the whole content when it is in memory, otherwise nullptr
+  virtual const char* Data() const { return nullptr; }
+  // Size() returns the size of the content, or 0 when it isn't known up front
+  virtual size_t Size() const = 0;
+  // WillNeed() hints that [offset, offset + length) of Data() is parsed next
+  virtual void WillNeed(size_t, size_t) const {}
+
+  // Read() copies the next bytes of the content into buffer and returns how many.
+  // Fewer than size are returned only at the end. Throws std::runtime_error when
+  // reading fails.
+  virtual size_t Read(char* buffer, size_t size) = 0;
+
+private:
+  const std::string name_;
+};
+
+// FileSource reads a file with plain read() calls into the caller's blocks, the
+// kernel being told the file is read sequentially.
+class FileSource : public InputSource {
+public:
+  explicit FileSource(const std::string& path);
+  ~FileSource() override;
+
+  size_t Size() const override { return size_; }
+  size_t Read(char* buffer, size_t size) override;
+
+private:
+  int fd_;
+  size_t size_;
+};
+
+// MappedSource parses a file in place from a read-only memory map of it.
+class MappedSource : public InputSource {
+public:
+  explicit MappedSource(const std::string& path)
+      : InputSource(path), file_(path), offset_(0u) {}
+
+  const char* Data() const override { return file_.Data(); }
+  size_t Size() const override { return file_.Size(); }
+  void WillNeed(size_t offset, size_t length) const override {
+    file_.WillNeed(offset, length);
+  }
+  size_t Read(char* buffer, size_t size) override;
+
+private:
+  MappedFile file_;
+  size_t offset_;
+};
+
+// MemorySource parses a buffer in place, without copying it. The buffer must
+// outlive the source.
+class MemorySource : public InputSource {
+public:
+  MemorySource(const char* data, size_t size, std::string name = "<memory>")
+      : InputSource(std::move(name)), data_(data), size_(size), offset_(0u) {}
+
+  const char* Data() const override { return data_; }
+  size_t Size() const override { return size_; }
+  size_t Read(char* buffer, size_t size) override;
+
+private:
+  const char* const data_;
+  const size_t size_;
+  size_t offset_;
+};
+
+// StreamSource reads an std::istream which needn't be seekable, e.g. std::cin,
+// straight through its stream buffer. The stream must outlive the source.
+class StreamSource : public InputSource {
+public:
+  explicit StreamSource(std::istream& in, std::string name = "<stream>")
+      : InputSource(std::move(name)), buffer_(in.rdbuf()) {}
+  // this StreamSource owns its stream buffer, e.g. a decompressing one
+  StreamSource(std::unique_ptr<std::streambuf> buffer, std::string name)
+      : InputSource(std::move(name)), owned_buffer_(std::move(buffer)),
+        buffer_(owned_buffer_.get()) {}
+
+  size_t Size() const override { return 0u; }
+  size_t Read(char* buffer, size_t size) override;
+
+private:
+  std::unique_ptr<std::streambuf> owned_buffer_;
+  std::streambuf* buffer_;
+};
+
+// DescriptorSource reads a file descriptor which needn't be seekable, e.g. a pipe or
+// a socket, with read() calls. The descriptor isn't closed by the source.
+class DescriptorSource : public InputSource {
+public:
+  explicit DescriptorSource(int fd, std::string name = "<descriptor>")
+      : InputSource(std::move(name)), fd_(fd) {}
+
+  size_t Size() const override { return 0u; }
+  size_t Read(char* buffer, size_t size) override;
+
+private:
+  const int fd_;
+};
+
+// OpenSource() returns the fastest source for a file: a decompressing StreamSource
+// for a gzip or zstd compressed file (see decompress.h), otherwise a MappedSource
+// when use_mmap is set, otherwise a FileSource. num_threads and thread_pool go to
+// OpenDecompressed().
+std::unique_ptr<InputSource> OpenSource(const std::string& path, bool use_mmap,
+                                        int num_threads,
+                                        ThreadPool* thread_pool = nullptr);
+
+// ReadAll() reads what is left of a source into memory
+std::vector<char> ReadAll(InputSource& source);
+
+}  // namespace csv
+
+#endif
@@ -0,0 +1,94 @@
+#include "input.h"
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct TempFileHandle {
+  std::string file_name;
+  TempFileHandle(): file_name(std::tmpnam(nullptr)) {}
+  ~TempFileHandle() { if (!file_name.empty()) std::remove(file_name.c_str()); }
+};
+
+// ReadInPieces() reads a source piece_size bytes at a time
+std::string ReadInPieces(csv::InputSource& source, size_t piece_size) {
+  std::string content;
+  std::string piece(piece_size, '\0');
+  for (;;) {
+    const auto read_size = source.Read(&piece[0], piece_size);
+    content.append(piece, 0u, read_size);
+    if (read_size < piece_size) {
+      return content;
+    }
+  }
+}
+
+const std::string kContent = "id,name\n1,a\n2,b\n";
+
+TEST(TestInputSource, FileSources) {
+  TempFileHandle file_handle;
+  std::ofstream(file_handle.file_name) << kContent;
+
+  csv::FileSource file_source(file_handle.file_name);
+  EXPECT_EQ(file_handle.file_name, file_source.Name());
+  EXPECT_EQ(nullptr, file_source.Data());
+  EXPECT_EQ(kContent.size(), file_source.Size());
+  EXPECT_EQ(kContent, ReadInPieces(file_source, 5u));
+
+  csv::MappedSource mapped_source(file_handle.file_name);
+  ASSERT_NE(nullptr, mapped_source.Data());
+  EXPECT_EQ(kContent, std::string(mapped_source.Data(), mapped_source.Size()));
+  EXPECT_EQ(kContent, ReadInPieces(mapped_source, 4u));
+
+  EXPECT_EQ(nullptr, csv::OpenSource(file_handle.file_name, false, 1)->Data());
+  EXPECT_NE(nullptr, csv::OpenSource(file_handle.file_name, true, 1)->Data());
+  EXPECT_THROW(csv::FileSource("/nonexistent/file.csv"), std::runtime_error);
+}
+
+TEST(TestInputSource, MemorySource) {
+  csv::MemorySource source(kContent.data(), kContent.size());
+  // not copied
+  EXPECT_EQ(kContent.data(), source.Data());
+  EXPECT_EQ(kContent.size(), source.Size());
+  EXPECT_EQ(kContent, ReadInPieces(source, 3u));
+}
+
+TEST(TestInputSource, StreamSources) {
+  std::istringstream in(kContent);
+  csv::StreamSource stream_source(in);
+  EXPECT_EQ(nullptr, stream_source.Data());
+  EXPECT_EQ(0u, stream_source.Size());
+  EXPECT_EQ(kContent, ReadInPieces(stream_source, 5u));
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  // more than a pipe holds at once, written in small pieces
+  std::string content;
+  for (int row = 0; row < 100000; ++row) {
+    content += std::to_string(row) + ",a\n";
+  }
+  std::thread writer([&]() {
+    for (size_t offset = 0u; offset < content.size(); offset += 1000u) {
+      const auto size = std::min(size_t{1000u}, content.size() - offset);
+      ASSERT_EQ(static_cast<ssize_t>(size), write(fds[1], content.data() + offset, size));
+    }
+    close(fds[1]);
+  });
+  csv::DescriptorSource descriptor_source(fds[0]);
+  const auto read = csv::ReadAll(descriptor_source);
+  writer.join();
+  close(fds[0]);
+  EXPECT_EQ(content, std::string(read.begin(), read.end()));
+}
+
+}  // anonymous namespace
@@ -0,0 +1,75 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace csv {
+
+namespace {
+
+inline size_t PageSize() { return static_cast<size_t>(sysconf(_SC_PAGESIZE)); }
+
+}  // namespace
+
+MappedFile::MappedFile(const std::string& path, bool copy_on_write)
+    : data_(nullptr), size_(0u) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(std::string("Failed to open ") + path + ": " +
+                             std::strerror(errno));
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    const int error = errno;
+    close(fd);
+    throw std::runtime_error(std::string("Failed to stat ") + path + ": " +
+                             std::strerror(error));
+  }
+
+  size_ = static_cast<size_t>(file_stat.st_size);
+  if (size_ == 0u) {
+    // mmap() rejects zero length mappings
+    close(fd);
+    return;
+  }
+
+  const int protection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* mapped = mmap(nullptr, size_, protection, MAP_PRIVATE, fd, 0);
+  const int error = errno;
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error(std::string("Failed to mmap ") + path + ": " +
+                             std::strerror(error));
+  }
+
+  if (!copy_on_write) {
+    madvise(mapped, size_, MADV_SEQUENTIAL);
+  }
+  data_ = static_cast<char*>(mapped);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+
+void MappedFile::WillNeed(size_t offset, size_t length) const {
+  if (data_ == nullptr || offset >= size_) {
+    return;
+  }
+  // madvise() requires a page aligned address
+  const size_t aligned_offset = offset - offset % PageSize();
+  length = std::min(length + (offset - aligned_offset), size_ - aligned_offset);
+  madvise(data_ + aligned_offset, length, MADV_WILLNEED);
+}
+
+}  // namespace csv
@@ -0,0 +1,37 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+#include <string>
+
+namespace csv {
+
+// MappedFile maps a whole file read-only into memory.
+// The mapping is hinted as sequential so the kernel reads ahead aggressively and
+// drops already consumed pages first.
+// A copy_on_write mapping may be written through MutableData() instead: written
+// pages become private copies and the file is never changed.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& path, bool copy_on_write = false);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* Data() const { return data_; }
+  // only for copy_on_write mappings
+  char* MutableData() const { return data_; }
+  size_t Size() const { return size_; }
+
+  // WillNeed() asks the kernel to start reading [offset, offset + length) now.
+  void WillNeed(size_t offset, size_t length) const;
+
+private:
+  char* data_;
+  size_t size_;
+};
+
+}  // namespace csv
+
+#endif
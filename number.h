@@ -0,0 +1,40 @@
+#ifndef __NUMBER_H__
+#define __NUMBER_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace csv {
+
+enum class ParseStatus { OK = 0, INVALID, OUT_OF_RANGE };
+
+// ParseInt64() parses [str, str + len) as a decimal integer with an optional sign.
+// Spaces and tabs around the number are ignored, anything else makes it INVALID.
+// Eight digits are converted at once (SWAR). Never reads past len, never allocates.
+ParseStatus ParseInt64(const char* str, size_t len, int64_t& value);
+
+// ParseDouble() parses [str, str + len) as a decimal floating point number
+// ("-1.5", ".5", "1e-3", "inf", "nan", ...), correctly rounded.
+// Up to 19 significant digits are converted with the Eisel-Lemire algorithm;
+// longer inputs fall back to strtod() on a stack copy. Never reads past len, never
+// allocates. OUT_OF_RANGE means the value overflowed to infinity.
+ParseStatus ParseDouble(const char* str, size_t len, double& value);
+
+// longest text FormatInt64() and FormatDouble() write
+constexpr size_t kMaxInt64Length = 20;
+constexpr size_t kMaxDoubleLength = 32;
+
+// FormatInt64() writes value in decimal to out, two digits at a time, and returns
+// the number of characters written. out is not null terminated.
+size_t FormatInt64(int64_t value, char* out);
+
+// FormatDouble() writes the shortest decimal text ParseDouble() reads back as value
+// exactly ("0.1", "2.5e-10", "-0", "nan", ...) to out and returns the number of
+// characters written. Values with up to 15 significant digits, at most 9 of them
+// after the point, are formatted from integers without snprintf(). out is not null
+// terminated.
+size_t FormatDouble(double value, char* out);
+
+}  // namespace csv
+
+#endif
@@ -0,0 +1,91 @@
+// Compares ParseInt64()/ParseDouble() with the atoll()/atof() based conversion
+// Convert<int64_t>/Convert<double> used before.
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "number.h"
+#include "stop_watch.h"
+
+namespace {
+
+struct Cell {
+  size_t offset;
+  size_t length;
+};
+
+// the previous Convert<int64_t>(const char*, size_t)
+int64_t LegacyConvertInt64(const char* str, size_t len) {
+  auto value = static_cast<int64_t>(std::atoll(str));
+  if (value == 0 && !(*str == '0' && len == 1)) {
+    throw std::invalid_argument(str);
+  }
+  return value;
+}
+
+// the previous Convert<double>(const char*, size_t)
+double LegacyConvertDouble(const char* str, size_t len) {
+  auto value = std::atof(str);
+  if (value == 0.0) {
+    return std::stoll(std::string(str, len));
+  }
+  return value;
+}
+
+// cells are separated by '|' the way they sit in a CSV record
+std::string MakeCells(size_t num_cells, bool doubles, std::vector<Cell>& cells) {
+  std::mt19937_64 random(3);
+  std::uniform_int_distribution<int64_t> value(1, 999999999999);
+  std::string content;
+  for (size_t idx = 0u; idx < num_cells; ++idx) {
+    std::string cell = std::to_string(value(random));
+    if (doubles) {
+      cell.insert(cell.size() - idx % 6 - 1, 1, '.');
+    }
+    cells.push_back(Cell{content.size(), cell.size()});
+    content += cell;
+    content += '|';
+  }
+  return content;
+}
+
+template <typename Function>
+void Run(const std::string& name, const std::string& content,
+         const std::vector<Cell>& cells, Function function) {
+  Stopwatch watch(name);
+  double checksum = 0.0;
+  watch.Start();
+  for (const auto& cell : cells) {
+    checksum += static_cast<double>(function(content.data() + cell.offset, cell.length));
+  }
+  watch.End();
+  std::cout << "  checksum: " << checksum << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t num_cells = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000u;
+
+  std::vector<Cell> int_cells;
+  const auto ints = MakeCells(num_cells, false, int_cells);
+  Run("legacy int64", ints, int_cells, LegacyConvertInt64);
+  Run("ParseInt64", ints, int_cells, [](const char* str, size_t len) {
+    int64_t value = 0;
+    csv::ParseInt64(str, len, value);
+    return value;
+  });
+
+  std::vector<Cell> double_cells;
+  const auto doubles = MakeCells(num_cells, true, double_cells);
+  Run("legacy double", doubles, double_cells, LegacyConvertDouble);
+  Run("ParseDouble", doubles, double_cells, [](const char* str, size_t len) {
+    double value = 0.0;
+    csv::ParseDouble(str, len, value);
+    return value;
+  });
+  return 0;
+}
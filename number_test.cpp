@@ -0,0 +1,226 @@
+#include "number.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+namespace {
+
+using csv::ParseStatus;
+
+ParseStatus ParseInt64(const std::string& str, int64_t& value) {
+  return csv::ParseInt64(str.data(), str.size(), value);
+}
+
+ParseStatus ParseDouble(const std::string& str, double& value) {
+  return csv::ParseDouble(str.data(), str.size(), value);
+}
+
+void ExpectSameAsStrtod(const std::string& str) {
+  double value = 0.0;
+  ASSERT_EQ(ParseStatus::OK, ParseDouble(str, value)) << str;
+  const double expected = std::strtod(str.c_str(), nullptr);
+  uint64_t expected_bits;
+  uint64_t actual_bits;
+  std::memcpy(&expected_bits, &expected, sizeof(double));
+  std::memcpy(&actual_bits, &value, sizeof(double));
+  EXPECT_EQ(expected_bits, actual_bits) << str;
+}
+
+TEST(TestParseInt64, Valid) {
+  int64_t value = -1;
+  EXPECT_EQ(ParseStatus::OK, ParseInt64("0", value));
+  EXPECT_EQ(0, value);
+  EXPECT_EQ(ParseStatus::OK, ParseInt64("-42", value));
+  EXPECT_EQ(-42, value);
+  EXPECT_EQ(ParseStatus::OK, ParseInt64("+42", value));
+  EXPECT_EQ(42, value);
+  EXPECT_EQ(ParseStatus::OK, ParseInt64(" 1234567890123 ", value));
+  EXPECT_EQ(1234567890123, value);
+  EXPECT_EQ(ParseStatus::OK, ParseInt64("0000000000000000000000012", value));
+  EXPECT_EQ(12, value);
+  EXPECT_EQ(ParseStatus::OK, ParseInt64("9223372036854775807", value));
+  EXPECT_EQ(std::numeric_limits<int64_t>::max(), value);
+  EXPECT_EQ(ParseStatus::OK, ParseInt64("-9223372036854775808", value));
+  EXPECT_EQ(std::numeric_limits<int64_t>::min(), value);
+}
+
+TEST(TestParseInt64, Invalid) {
+  int64_t value = 0;
+  EXPECT_EQ(ParseStatus::INVALID, ParseInt64("", value));
+  EXPECT_EQ(ParseStatus::INVALID, ParseInt64("-", value));
+  EXPECT_EQ(ParseStatus::INVALID, ParseInt64("12a", value));
+  EXPECT_EQ(ParseStatus::INVALID, ParseInt64("1.5", value));
+  EXPECT_EQ(ParseStatus::INVALID, ParseInt64("1 2", value));
+  EXPECT_EQ(ParseStatus::OUT_OF_RANGE, ParseInt64("9223372036854775808", value));
+  EXPECT_EQ(ParseStatus::OUT_OF_RANGE, ParseInt64("-9223372036854775809", value));
+  EXPECT_EQ(ParseStatus::OUT_OF_RANGE, ParseInt64("123456789012345678901", value));
+}
+
+TEST(TestParseInt64, NeverReadsPastLength) {
+  // the digits after len must not be consumed
+  const char str[] = "12345678|9";
+  int64_t value = 0;
+  EXPECT_EQ(ParseStatus::OK, csv::ParseInt64(str, 5, value));
+  EXPECT_EQ(12345, value);
+  EXPECT_EQ(ParseStatus::OK, csv::ParseInt64(str, 8, value));
+  EXPECT_EQ(12345678, value);
+}
+
+TEST(TestParseDouble, Valid) {
+  for (const char* str :
+       {"0", "-0", "0.0", "2.7", "4.12", "3.1415", ".5", "5.", "-1e10", "1E-5", "1e+22",
+        "1e23", "123456789012345678", "0.1", "0.2", "0.3", "2.2250738585072014e-308",
+        "4.9406564584124654e-324", "1.7976931348623157e308", "9007199254740993",
+        "0.000000000000000000000000000000000000000123456789",
+        "12345678901234567890123456789",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "7.2057594037927933e16", "2.5e-5", "1e-400"}) {
+    ExpectSameAsStrtod(str);
+  }
+}
+
+TEST(TestParseDouble, Random) {
+  std::mt19937_64 random(1234);
+  char buffer[64];
+  for (int trial = 0; trial < 100000; ++trial) {
+    uint64_t bits = random();
+    double value;
+    std::memcpy(&value, &bits, sizeof(double));
+    if (!std::isfinite(value)) {
+      continue;
+    }
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    ExpectSameAsStrtod(buffer);
+    std::snprintf(buffer, sizeof(buffer), "%.*e", static_cast<int>(trial % 17), value);
+    ExpectSameAsStrtod(buffer);
+  }
+}
+
+TEST(TestParseDouble, Invalid) {
+  double value = 0.0;
+  EXPECT_EQ(ParseStatus::INVALID, ParseDouble("", value));
+  EXPECT_EQ(ParseStatus::INVALID, ParseDouble(".", value));
+  EXPECT_EQ(ParseStatus::INVALID, ParseDouble("1e", value));
+  EXPECT_EQ(ParseStatus::INVALID, ParseDouble("1.2.3", value));
+  EXPECT_EQ(ParseStatus::INVALID, ParseDouble("abc", value));
+  EXPECT_EQ(ParseStatus::OUT_OF_RANGE, ParseDouble("1e309", value));
+  EXPECT_EQ(ParseStatus::OK, ParseDouble("-inf", value));
+  EXPECT_TRUE(std::isinf(value));
+  EXPECT_EQ(ParseStatus::OK, ParseDouble("NaN", value));
+  EXPECT_TRUE(std::isnan(value));
+}
+
+TEST(TestParseDouble, NeverReadsPastLength) {
+  const char str[] = "1.25|7e5";
+  double value = 0.0;
+  EXPECT_EQ(ParseStatus::OK, csv::ParseDouble(str, 4, value));
+  EXPECT_DOUBLE_EQ(1.25, value);
+  EXPECT_EQ(ParseStatus::OK, csv::ParseDouble(str, 3, value));
+  EXPECT_DOUBLE_EQ(1.2, value);
+}
+
+std::string FormatInt64(int64_t value) {
+  char buffer[csv::kMaxInt64Length];
+  return std::string(buffer, csv::FormatInt64(value, buffer));
+}
+
+std::string FormatDouble(double value) {
+  char buffer[csv::kMaxDoubleLength];
+  return std::string(buffer, csv::FormatDouble(value, buffer));
+}
+
+TEST(TestFormatInt64, Valid) {
+  EXPECT_EQ("0", FormatInt64(0));
+  EXPECT_EQ("7", FormatInt64(7));
+  EXPECT_EQ("-42", FormatInt64(-42));
+  EXPECT_EQ("100", FormatInt64(100));
+  EXPECT_EQ("1234567890123", FormatInt64(1234567890123));
+  EXPECT_EQ("9223372036854775807", FormatInt64(std::numeric_limits<int64_t>::max()));
+  EXPECT_EQ("-9223372036854775808", FormatInt64(std::numeric_limits<int64_t>::min()));
+
+  std::mt19937_64 random(99);
+  for (int trial = 0; trial < 10000; ++trial) {
+    const auto value = static_cast<int64_t>(random()) >> (trial % 64);
+    EXPECT_EQ(std::to_string(value), FormatInt64(value));
+  }
+}
+
+TEST(TestFormatDouble, Shortest) {
+  EXPECT_EQ("0", FormatDouble(0.0));
+  EXPECT_EQ("-0", FormatDouble(-0.0));
+  EXPECT_EQ("3", FormatDouble(3.0));
+  EXPECT_EQ("0.1", FormatDouble(0.1));
+  EXPECT_EQ("0.3", FormatDouble(0.3));
+  EXPECT_EQ("0.30000000000000004", FormatDouble(0.1 + 0.2));
+  EXPECT_EQ("-2.5", FormatDouble(-2.5));
+  EXPECT_EQ("1234.0625", FormatDouble(1234.0625));
+  // not exact multiples of a power of ten once scaled
+  EXPECT_EQ("17.95233166", FormatDouble(17.95233166));
+  EXPECT_EQ("0.03741657", FormatDouble(0.03741657));
+  EXPECT_EQ("4479.8087", FormatDouble(4479.8087));
+  EXPECT_EQ("0.000001", FormatDouble(1e-6));
+  EXPECT_EQ("1e-10", FormatDouble(1e-10));
+  EXPECT_EQ("1e+22", FormatDouble(1e22));
+  EXPECT_EQ("123456789012345", FormatDouble(123456789012345.0));
+  EXPECT_EQ("1.7976931348623157e+308", FormatDouble(std::numeric_limits<double>::max()));
+  EXPECT_EQ("5e-324", FormatDouble(std::numeric_limits<double>::denorm_min()));
+  EXPECT_EQ("inf", FormatDouble(std::numeric_limits<double>::infinity()));
+  EXPECT_EQ("-inf", FormatDouble(-std::numeric_limits<double>::infinity()));
+  EXPECT_EQ("nan", FormatDouble(std::numeric_limits<double>::quiet_NaN()));
+}
+
+TEST(TestFormatDouble, RoundTrip) {
+  std::mt19937_64 random(4321);
+  std::uniform_int_distribution<int64_t> decimal_digits(-999999999, 999999999);
+  for (int trial = 0; trial < 100000; ++trial) {
+    uint64_t bits = random();
+    double value;
+    std::memcpy(&value, &bits, sizeof(double));
+    // a few digits after the point, the usual content of a CSV file
+    const double decimal =
+        static_cast<double>(decimal_digits(random)) / std::pow(10.0, trial % 10);
+    for (double expected : {value, decimal}) {
+      if (std::isnan(expected)) {
+        continue;
+      }
+      const auto str = FormatDouble(expected);
+      double parsed = 0.0;
+      ASSERT_EQ(ParseStatus::OK, ParseDouble(str, parsed)) << str;
+      EXPECT_EQ(0, std::memcmp(&expected, &parsed, sizeof(double))) << str;
+      // no zeros end the fraction
+      const auto mantissa = str.substr(0u, str.find('e'));
+      const bool has_fraction = mantissa.find('.') != std::string::npos;
+      if (has_fraction) {
+        EXPECT_NE('0', mantissa.back()) << str;
+      }
+      // one significant digit less doesn't read back as expected
+      std::string digits;
+      for (const char c : mantissa) {
+        if (c >= '0' && c <= '9') {
+          digits += c;
+        }
+      }
+      digits.erase(0u, digits.find_first_not_of('0'));
+      if (!has_fraction) {
+        digits.erase(digits.find_last_not_of('0') + 1u);
+      }
+      const auto num_digits = static_cast<int>(digits.size());
+      if (num_digits > 1) {
+        char shorter[csv::kMaxDoubleLength];
+        const int shorter_length =
+            std::snprintf(shorter, sizeof(shorter), "%.*g", num_digits - 1, expected);
+        ASSERT_LT(shorter_length, static_cast<int>(sizeof(shorter)));
+        EXPECT_NE(expected, std::strtod(shorter, nullptr)) << str;
+      }
+    }
+  }
+}
+
+}  // namespace
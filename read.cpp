@@ -1,148 +1,329 @@
 #include "read.h"
 
-#include <omp.h>
+#include "infer.h"
+#include "scan.h"
+#include "split.h"
 
+#include <algorithm>
 #include <cassert>
-#include <cmath>
-#include <fstream>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace csv {
 
 namespace {
 
-constexpr size_t kMaxChunkSize = 256 * 1024 * 1024;  // 256MB
-
-size_t EstimateLineSize(std::istream& file_in) {
-  file_in.seekg(0, std::ios::beg);
-  std::string line;
-
-  // header
-  std::getline(file_in, line);
-
-  size_t total_line_size = 0u;
-  size_t num_lines = 0u;
-  // look up ten lines
-  for (; num_lines < 10u; num_lines++) {
-    if (!std::getline(file_in, line)) {
-      file_in.clear();
-      break;
+// pieces smaller than this are not worth a thread (and a chunk) of their own
+constexpr size_t kMinPieceSize = 1024 * 1024;  // 1MB
+// room in front of a prefetched block for the head of a record continuing from
+// the previous block
+constexpr size_t kPrefetchHeadroom = 1024 * 1024;  // 1MB
+constexpr size_t kNumPrefetchBuffers = 2u;
+// pieces ReadCSVFiles() splits its files into, at most, per thread
+constexpr size_t kMaxPiecesPerThread = 4u;
+// rows of the first chunk a filtered piece reserves; each next one doubles
+constexpr size_t kMinFilteredChunkRows = 16 * 1024;
+// document column of a FieldType::SKIP column
+constexpr size_t kSkippedColumn = static_cast<size_t>(-1);
+
+// ConversionError is what ParseRecords() throws for a cell of an INT64 or DOUBLE
+// column which isn't such a number. is_double tells whether it is a DOUBLE.
+class ConversionError : public std::invalid_argument {
+public:
+  ConversionError(const std::string& what, size_t column, bool is_double)
+      : std::invalid_argument(what), column(column), is_double(is_double) {}
+
+  size_t column;
+  bool is_double;
+};
+
+// ReadInferred() returns read(field_types) for field types from InferFieldTypes(),
+// which only sampled the file. When a cell outside the samples doesn't convert, its
+// column is widened, an INT64 one to DOUBLE if the cell is a number and otherwise to
+// VARSTRING, and the file is read again.
+template <typename Read>
+Document ReadInferred(std::vector<FieldType> field_types, Read read) {
+  for (;;) {
+    try {
+      return read(field_types);
+    } catch (const ConversionError& e) {
+      auto& field_type = field_types[e.column];
+      if (field_type == FieldType::INT64 && e.is_double) {
+        field_type = FieldType::DOUBLE;
+      } else if (field_type == FieldType::INT64 || field_type == FieldType::DOUBLE) {
+        field_type = FieldType::VARSTRING;
+      } else {
+        throw;
+      }
     }
-    total_line_size += line.size();
-  }
-  if (num_lines == 0u) {
-    return 0u;
   }
-  return static_cast<size_t>(
-      std::lround(static_cast<double>(total_line_size) / static_cast<double>(num_lines)));
 }
 
-size_t EstimateBufferLines(size_t file_size, size_t estimated_line_size) {
-  // +1 to prevent 0 estimation && times to prevent for wrong estimation
-  const auto estimated_buffer_lines =
-      2 * (std::lround(static_cast<double>(kMaxChunkSize) /
-                       static_cast<double>(estimated_line_size)) +
-           1);
-  const auto estimated_file_lines =
-      2 * (std::lround(static_cast<double>(file_size) /
-                       static_cast<double>(estimated_line_size)) +
-           1);
-  return std::min(estimated_buffer_lines, estimated_file_lines);
+// NextLine() returns the end of the line starting at begin, which is either a
+// newline or end.
+inline const char* NextLine(const char* begin, const char* end) {
+  const auto newline = static_cast<const char*>(
+      std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+  return newline == nullptr ? end : newline;
 }
 
-bool FillLines(std::istream& file_in, std::vector<std::string>& line_buffer,
-               size_t& num_read_lines) {
-  size_t read_bytes = 0u;
-  size_t line_buffer_size = line_buffer.size();
-  std::string line;
-  num_read_lines = 0u;
-
-  auto line_no = 0u;
-  while (read_bytes < kMaxChunkSize) {
-    if (!std::getline(file_in, line)) {
-      return true;
-    }
-
-    if (line.empty()) {
-      continue;
-    }
-
-    if (line_no >= line_buffer_size) {
-      line_buffer.resize(line_buffer.size() * 2);
-      line_buffer_size = line_buffer.size();
-    }
-
-    line_buffer[line_no++] = line;
-    num_read_lines++;
-    read_bytes += line.size();
-  }
-
-  return false;
+size_t NumPieces(size_t block_size, const ReadOptions& options) {
+  const auto num_threads = static_cast<size_t>(std::max(options.num_threads, 1));
+  return std::min(num_threads, std::max(size_t{1u}, block_size / kMinPieceSize));
 }
 
-void ParseOneChunk(const std::vector<std::string>& lines, size_t num_read_lines,
-                   size_t row_offset,
-                   const std::vector<FieldType>& field_types,
-                   const ReadOptions& options, Document& doc) {
+// ParseRecords() parses every record of a piece into chunks of doc it reserves and
+// returns the number of rows written, which is less than piece.num_rows when filter
+// rejects records. Without a filter there is one chunk of piece.num_rows rows; with
+// one, chunks are reserved as accepted rows need them, each twice as big as the
+// previous, so rejected records cost no chunk memory. Chunks are ordered by
+// first_sequence plus the number in the piece of their first record, so sequences
+// of consecutive pieces must be piece.num_rows apart at least. first_record is the
+// number of the piece's first record in the whole file. field_types has one entry
+// per CSV column, document_columns maps each CSV column to its Document column
+// (kSkippedColumn for SKIP).
+size_t ParseRecords(const Piece& piece, size_t first_record, uint64_t first_sequence,
+                    const std::vector<FieldType>& field_types,
+                    const std::vector<size_t>& document_columns,
+                    const RecordFilter& filter, const ReadOptions& options,
+                    Document& doc) {
   const auto column_size = field_types.size();
   const char quotechar = options.quotechar;
   const char separator = options.separator;
-  omp_set_num_threads(options.num_threads);
-#pragma omp parallel for schedule(dynamic)
-  for (size_t row_no = row_offset; row_no < row_offset + num_read_lines; ++row_no) {
-    const auto& line = lines[row_no - row_offset];
-    if (line.empty()) {
-      continue;
+  size_t num_records = 0u;
+  size_t column = 0u;
+
+  // With a filter, a record is decided at its last compared column. Cells before it
+  // wait in pending_cells and nothing of a rejected record is stored.
+  RecordFilter record_filter = filter;
+  const bool filtering = !filter.Empty();
+  const size_t decision_column = filter.LastColumn();
+  bool rejected = false;
+  std::vector<std::pair<const char*, size_t>> pending_cells(filtering ? decision_column
+                                                                      : 0u);
+
+  auto chunk = doc.ReserveChunk(
+      filtering ? std::min(piece.num_rows, kMinFilteredChunkRows) : piece.num_rows,
+      first_sequence);
+  size_t row_in_chunk = 0u;
+  size_t num_rows = 0u;  // of the chunks before chunk
+  // next_row() makes room for the row of an accepted record
+  auto next_row = [&]() {
+    if (row_in_chunk == chunk.NumRows()) {
+      num_rows += row_in_chunk;
+      chunk = doc.ReserveChunk(std::min(piece.num_rows - num_records, 2u * row_in_chunk),
+                               first_sequence + num_records);
+      row_in_chunk = 0u;
+    }
+  };
+  // finish() drops the rows chunk has left and returns the number of rows written
+  auto finish = [&]() {
+    if (row_in_chunk != chunk.NumRows()) {
+      chunk.Shrink(row_in_chunk);
+    }
+    return num_rows + row_in_chunk;
+  };
+
+  // conversion_error() reports a cell of csv_column which isn't a number
+  auto conversion_error = [&](size_t csv_column, const char* cell_begin,
+                              size_t cell_size) {
+    double value = 0.0;
+    return ConversionError(std::string("at row ") +
+                               std::to_string(first_record + num_records) + ", col " +
+                               std::to_string(csv_column) + ": can't convert \"" +
+                               std::string(cell_begin, cell_size) + '"',
+                           csv_column,
+                           ParseDouble(cell_begin, cell_size, value) == ParseStatus::OK);
+  };
+
+  auto store_cell = [&](size_t csv_column, const char* cell_begin, size_t cell_size) {
+    if (field_types[csv_column] == FieldType::STRING &&
+        cell_size >= FieldTypeHelper<FieldType::STRING>::size) {
+      throw std::runtime_error(std::string("at row ") +
+                               std::to_string(first_record + num_records) + ", col " +
+                               std::to_string(csv_column) +
+                               ": string length should be shorter than 64");
+    }
+    const auto document_column = document_columns[csv_column];
+    if (document_column == kSkippedColumn) {
+      return;
+    }
+    // a number the filter compared is not converted again
+    if (filtering && record_filter.Converted(csv_column)) {
+      if (field_types[csv_column] == FieldType::INT64) {
+        chunk.WriteInt64(row_in_chunk, document_column,
+                         record_filter.Int64Value(csv_column), cell_size != 0u);
+      } else {
+        chunk.WriteDouble(row_in_chunk, document_column,
+                          record_filter.DoubleValue(csv_column), cell_size != 0u);
+      }
+      return;
+    }
+    try {
+      chunk.Write(row_in_chunk, document_column, cell_begin, cell_size);
+    } catch (const std::invalid_argument&) {
+      throw conversion_error(csv_column, cell_begin, cell_size);
     }
+  };
 
-    const auto lineptr = line.c_str();
-    bool quoted = false;
-    size_t column = 0u;
-    int cell_start = 0;
-    int cell_end = 0;
-    // parse one line
-    for (; cell_end < static_cast<int>(line.size()); ++cell_end) {
-      const char current_char = lineptr[cell_end];
-      if (current_char == quotechar) {
-        if (cell_start == cell_end || lineptr[cell_start] == quotechar) {
-          quoted = !quoted;
-        }
-      } else if (current_char == separator && !quoted) {
-        if (field_types[column] == FieldType::STRING &&
-            static_cast<unsigned>(cell_end - cell_start) >=
-                FieldTypeHelper<FieldType::STRING>::size) {
-          throw std::runtime_error(std::string("at row ") + std::to_string(row_no) +
-                                   ", col " + std::to_string(column) +
-                                   ": string length should be shorter than 64");
+  auto write_cell = [&](const char* cell_begin, const char* cell_end) {
+    const auto cell_size = static_cast<size_t>(cell_end - cell_begin);
+    if (column >= column_size) {
+      throw std::runtime_error("column size doesn't match for row " +
+                               std::to_string(first_record + num_records));
+    }
+    if (!filtering) {
+      store_cell(column++, cell_begin, cell_size);
+      return;
+    }
+
+    if (record_filter.Compares(column)) {
+      try {
+        record_filter.SetCell(column, cell_begin, cell_size);
+      } catch (const std::invalid_argument&) {
+        throw conversion_error(column, cell_begin, cell_size);
+      }
+    }
+    if (column < decision_column) {
+      pending_cells[column] = std::make_pair(cell_begin, cell_size);
+    } else if (column == decision_column) {
+      rejected = !record_filter.Accept();
+      if (!rejected) {
+        next_row();
+        for (size_t pending = 0u; pending < decision_column; ++pending) {
+          store_cell(pending, pending_cells[pending].first,
+                     pending_cells[pending].second);
         }
-        doc.Write(row_no, column++, lineptr + cell_start, cell_end - cell_start);
-        cell_start = cell_end + 1;
+        store_cell(column, cell_begin, cell_size);
       }
+    } else if (!rejected) {
+      store_cell(column, cell_begin, cell_size);
     }
-
-    if (!quoted) {
-      doc.Write(row_no, column++, lineptr + cell_start, cell_end - cell_start);
+    ++column;
+  };
+
+  const char* record_start = piece.begin;
+  const char* cell_start = piece.begin;
+  // end_record() finishes the record ending at record_end (a newline or piece end)
+  auto end_record = [&](const char* record_end) {
+    if (!IsEmptyRecord(record_start, record_end)) {
+      const char* cell_end = *(record_end - 1) == '\r' ? record_end - 1 : record_end;
+      write_cell(cell_start, std::max(cell_start, cell_end));
+      if (column != column_size) {
+        throw std::runtime_error("column size doesn't match for row " +
+                                 std::to_string(first_record + num_records));
+      }
+      if (!rejected) {
+        row_in_chunk++;
+      }
+      num_records++;
+      rejected = false;
+    }
+    record_start = record_end + 1;
+    cell_start = record_start;
+    column = 0u;
+  };
+
+  // Structural characters come as bitmasks of kScanBlockSize bytes. Quoted bytes
+  // are masked out using the prefix xor of the quote mask, so a separator or a
+  // newline in a quoted cell never shows up.
+  const ScanFunction scan = SelectScanner();
+  const char* const end = piece.end;
+  char tail[kScanBlockSize];
+  uint64_t quoted_carry = 0u;
+  for (const char* block = piece.begin; block < end && num_records < piece.num_rows;
+       block += kScanBlockSize) {
+    const auto remaining = static_cast<size_t>(end - block);
+    const char* scanned = block;
+    uint64_t valid_bits = ~uint64_t{0u};
+    if (remaining < kScanBlockSize) {
+      std::memcpy(tail, block, remaining);
+      std::memset(tail + remaining, 0, kScanBlockSize - remaining);
+      scanned = tail;
+      valid_bits = (uint64_t{1u} << remaining) - 1u;
     }
 
-    if (column != column_size) {
-      throw std::runtime_error("column size doesn't match for row " +
-                               std::to_string(row_no));
+    StructuralMasks masks;
+    scan(scanned, separator, quotechar, masks);
+    const uint64_t quoted = PrefixXor(masks.quote) ^ quoted_carry;
+    quoted_carry = static_cast<uint64_t>(static_cast<int64_t>(quoted) >> 63);
+    uint64_t structurals = (masks.separator | masks.newline) & ~quoted & valid_bits;
+    while (structurals != 0u) {
+      const int bit = CountTrailingZeros(structurals);
+      structurals &= structurals - 1u;
+      const char* position = block + bit;
+      if ((masks.newline >> bit) & 1u) {
+        end_record(position);
+        if (num_records == piece.num_rows) {
+          return finish();
+        }
+      } else {
+        write_cell(cell_start, position);
+        cell_start = position + 1;
+      }
     }
   }
-}
 
-}  // namespace
+  // the last record of the input may miss its newline
+  if (num_records < piece.num_rows && record_start < end) {
+    end_record(end);
+  }
+  return finish();
+}
 
-std::vector<std::string> ColumnNames(std::istream& file_in, const std::string& path,
-                                     ReadOptions options) {
-  file_in.seekg(0, std::ios::beg);
-  std::string line;
-  if (!std::getline(file_in, line)) {
-    throw std::runtime_error(std::string("Failed to parse field names from ") + path);
+// ParseBlock() splits [begin, end) into pieces and parses all pieces in parallel,
+// each into chunks its thread reserves, then stitches the chunks into doc.
+// Returns where the parsed records end; when is_last is false, bytes after that
+// are the head of a record continuing in the next block. num_records counts the
+// records of the file parsed so far, rejected ones included.
+const char* ParseBlock(const char* begin, const char* end, bool is_last,
+                       const std::vector<FieldType>& field_types,
+                       const std::vector<size_t>& document_columns,
+                       const RecordFilter& filter, const ReadOptions& options,
+                       size_t& num_records, Document& doc) {
+  const char* records_end = begin;
+  const auto pieces = SplitRecords(begin, end, is_last,
+                                   NumPieces(static_cast<size_t>(end - begin), options),
+                                   options.quotechar, options.num_threads, records_end,
+                                   &options.Pool());
+
+  std::vector<size_t> first_records(pieces.size());
+  for (size_t idx = 0u; idx < pieces.size(); ++idx) {
+    first_records[idx] = num_records;
+    num_records += pieces[idx].num_rows;
   }
 
+  options.Pool().ParallelFor(pieces.size(), options.num_threads, [&](size_t idx) {
+    // the number of its first record orders the chunk of a piece, empty pieces aside
+    if (pieces[idx].num_rows == 0u) {
+      return;
+    }
+    ParseRecords(pieces[idx], first_records[idx], first_records[idx], field_types,
+                 document_columns, filter, options, doc);
+  });
+  doc.StitchChunks();
+
+  return records_end;
+}
+
+std::vector<std::string> ParseColumnNames(const char* line, size_t line_size,
+                                          const ReadOptions& options) {
+  if (line_size > 0u && line[line_size - 1] == '\r') {
+    --line_size;
+  }
   const char quotechar = options.quotechar;
   const char separator = options.separator;
 
@@ -150,63 +331,690 @@ std::vector<std::string> ColumnNames(std::istream& file_in, const std::string& p
   int cell_start = 0;
   int cell_end = 0;
   bool quoted = false;
-  for (size_t i = 0; i < line.size(); ++i) {
+  for (size_t i = 0; i < line_size; ++i) {
     const char current_char = line[i];
+    // every quote toggles, as in ParseRecords(), so that an escaped quote ("") in a
+    // name splits the header the way it would split a record
     if (current_char == quotechar) {
-      if (cell_start == cell_end || line[cell_end - 1] == quotechar) {
-        quoted = !quoted;
-      }
+      quoted = !quoted;
     } else if (current_char == separator && !quoted) {
-      column_names.push_back(line.substr(cell_start, cell_end - cell_start));
+      column_names.push_back(std::string(line + cell_start, cell_end - cell_start));
       cell_start = cell_end + 1;
     }
     cell_end++;
   }
 
   if (cell_start != cell_end) {
-    column_names.push_back(line.substr(cell_start, cell_end - cell_start));
+    column_names.push_back(std::string(line + cell_start, cell_end - cell_start));
   }
 
   return column_names;
 }
 
-Document ReadCSV(const std::string& path, const std::vector<FieldType>& field_types,
-                 ReadOptions options) {
-  std::ifstream file_in(path, std::ios::ate);
-  file_in.exceptions(std::ifstream::badbit);
-  const auto file_size = static_cast<size_t>(file_in.tellg());
-  const auto column_size = field_types.size();
-  const auto column_names = ColumnNames(file_in, path, options);
-  assert(column_size == column_names.size());
-  if (column_size != column_names.size()) {
+// ReadHeader() reads a source up to the end of its first line, which it returns.
+// What was read beyond the line is put into rest.
+std::string ReadHeader(InputSource& source, std::vector<char>& rest) {
+  constexpr size_t kHeaderReadSize = 64 * 1024;
+  std::vector<char> head;
+  for (;;) {
+    const auto head_size = head.size();
+    head.resize(head_size + kHeaderReadSize);
+    const auto read_size = source.Read(head.data() + head_size, kHeaderReadSize);
+    head.resize(head_size + read_size);
+    const auto newline = std::find(head.begin() + head_size, head.end(), '\n');
+    if (newline != head.end()) {
+      rest.assign(newline + 1, head.end());
+      return std::string(head.begin(), newline);
+    }
+    if (read_size < kHeaderReadSize) {
+      break;
+    }
+  }
+  if (head.empty()) {
+    throw std::runtime_error(std::string("Failed to parse field names from ") +
+                             source.Name());
+  }
+  rest.clear();
+  return std::string(head.begin(), head.end());
+}
+
+// Projection maps the columns of a CSV file to those of a Document, which leaves out
+// FieldType::SKIP columns, and holds the filter compiled for the file's columns
+struct Projection {
+  // per CSV column, kSkippedColumn for SKIP
+  std::vector<size_t> document_columns;
+  std::vector<std::string> document_field_names;
+  std::vector<FieldType> document_field_types;
+  RecordFilter record_filter;
+};
+
+Projection MakeProjection(const std::vector<std::string>& column_names,
+                          const std::vector<FieldType>& field_types,
+                          const ReadOptions& options) {
+  if (field_types.size() != column_names.size()) {
     throw std::invalid_argument(
-        std::string("given field types size ") + std::to_string(column_size) +
+        std::string("given field types size ") + std::to_string(field_types.size()) +
         "doesn't match CSV header size " + std::to_string(column_names.size()));
   }
-  const auto estimated_line_size = EstimateLineSize(file_in);
 
-  std::vector<std::string> lines(EstimateBufferLines(file_size, estimated_line_size));
-  Document doc(column_names, field_types);
+  Projection projection;
+  projection.document_columns.reserve(field_types.size());
+  for (size_t column = 0u; column < field_types.size(); ++column) {
+    if (field_types[column] == FieldType::SKIP) {
+      projection.document_columns.push_back(kSkippedColumn);
+      continue;
+    }
+    projection.document_columns.push_back(projection.document_field_names.size());
+    projection.document_field_names.push_back(column_names[column]);
+    projection.document_field_types.push_back(field_types[column]);
+  }
+  projection.record_filter = RecordFilter(options.filter, column_names, field_types);
+  return projection;
+}
 
-  const char quotechar = options.quotechar;
-  const char separator = options.separator;
-  const auto num_threads = options.num_threads;
+Document NewDocument(const Projection& projection, const ReadOptions& options) {
+  Document doc(projection.document_field_names, projection.document_field_types,
+               options.layout, options.allocator);
+  doc.SetThreadPool(options.thread_pool);
+  return doc;
+}
+
+// ModificationTime() returns when a file was last modified, to the nanosecond where
+// stat() tells
+std::string ModificationTime(const struct stat& file_stat) {
+#if defined(__APPLE__)
+  const auto& mtime = file_stat.st_mtimespec;
+  return std::to_string(mtime.tv_sec) + '.' + std::to_string(mtime.tv_nsec);
+#elif defined(__linux__) || (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L)
+  const auto& mtime = file_stat.st_mtim;
+  return std::to_string(mtime.tv_sec) + '.' + std::to_string(mtime.tv_nsec);
+#else
+  return std::to_string(file_stat.st_mtime);
+#endif
+}
+
+// ReadCached() returns the Document cached in options.cache_dir for path if it is
+// still up to date, otherwise the one parse() returns, which it caches. field_types
+// is empty when they are inferred.
+template <typename Parse>
+Document ReadCached(const std::string& path, const std::vector<FieldType>& field_types,
+                    const ReadOptions& options, Parse parse) {
+  struct stat file_stat;
+  if (options.cache_dir.empty() || !options.filter.Empty() ||
+      stat(path.c_str(), &file_stat) != 0) {
+    return parse();
+  }
+
+  // what the Document depends on besides the file's content
+  std::string source = path + '\n' + options.quotechar + options.separator +
+                       std::to_string(static_cast<int>(options.layout)) + '\n';
+  for (const auto field_type : field_types) {
+    source += std::to_string(static_cast<int>(field_type)) + ',';
+  }
+  const auto key = source + '\n' + std::to_string(file_stat.st_size) + '\n' +
+                   ModificationTime(file_stat);
+  // one cache file per source, replaced whenever the file changes
+  uint64_t hash = 14695981039346656037ULL;  // FNV-1a
+  for (const char current_char : source) {
+    hash ^= static_cast<unsigned char>(current_char);
+    hash *= 1099511628211ULL;
+  }
+  char file_name[32];
+  std::snprintf(file_name, sizeof(file_name), "%016llx.doc",
+                static_cast<unsigned long long>(hash));
+  const auto cache_path = options.cache_dir + '/' + file_name;
+
+  try {
+    // set up like the Document parse() returns
+    Document doc = Document::Load(cache_path, key, options.allocator);
+    doc.SetThreadPool(options.thread_pool);
+    return doc;
+  } catch (const std::runtime_error&) {
+    // not cached yet, stale or unreadable
+  }
+  Document doc = parse();
+  // saved aside and renamed, so that nobody loads a partially written file
+  const auto saved_path = cache_path + '.' + std::to_string(getpid());
+  try {
+    doc.Save(saved_path, key);
+    if (std::rename(saved_path.c_str(), cache_path.c_str()) != 0) {
+      std::remove(saved_path.c_str());
+    }
+  } catch (const std::runtime_error&) {
+    // the cache is best effort
+    std::remove(saved_path.c_str());
+  }
+  return doc;
+}
 
-  bool process_done = false;
-  size_t row_offset = 0u;
+}  // namespace
 
+std::vector<std::string> ColumnNames(std::istream& file_in, const std::string& path,
+                                     ReadOptions options) {
   file_in.seekg(0, std::ios::beg);
-  std::string dummy;
-  std::getline(file_in, dummy);
-  do {
-    size_t num_read_lines = 0u;
-    process_done = FillLines(file_in, lines, num_read_lines);
-    doc.AddChunk(num_read_lines);
-    ParseOneChunk(lines, num_read_lines, row_offset, field_types, options, doc);
-    row_offset += num_read_lines;
-  } while (!process_done);
+  std::string line;
+  if (!std::getline(file_in, line)) {
+    throw std::runtime_error(std::string("Failed to parse field names from ") + path);
+  }
+
+  return ParseColumnNames(line.c_str(), line.size(), options);
+}
+
+std::vector<std::string> ColumnNames(InputSource& source, ReadOptions options) {
+  if (source.Data() != nullptr) {
+    const char* const end = source.Data() + source.Size();
+    if (source.Data() == end) {
+      throw std::runtime_error(std::string("Failed to parse field names from ") +
+                               source.Name());
+    }
+    const auto header_end = NextLine(source.Data(), end);
+    return ParseColumnNames(source.Data(),
+                            static_cast<size_t>(header_end - source.Data()), options);
+  }
+  std::vector<char> rest;
+  const auto header = ReadHeader(source, rest);
+  return ParseColumnNames(header.c_str(), header.size(), options);
+}
+
+// BlockPrefetcher reads an InputSource on a thread of its own into a pool of
+// reusable buffers, so the next block is read while the current one is parsed.
+class BlockPrefetcher {
+public:
+  struct Buffer {
+    // kPrefetchHeadroom bytes, then up to block_size bytes read
+    std::vector<char> data;
+    size_t size;
+    bool is_last;
+    std::exception_ptr error;
+  };
+
+  BlockPrefetcher(InputSource& source, size_t block_size)
+      : source_(source), block_size_(block_size), buffers_(kNumPrefetchBuffers),
+        stop_(false) {
+    for (auto& buffer : buffers_) {
+      buffer.data.resize(kPrefetchHeadroom + block_size);
+      free_buffers_.push_back(&buffer);
+    }
+    thread_ = std::thread(&BlockPrefetcher::Run, this);
+  }
+
+  ~BlockPrefetcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    free_cv_.notify_one();
+    thread_.join();
+  }
+
+  BlockPrefetcher(const BlockPrefetcher&) = delete;
+  BlockPrefetcher& operator=(const BlockPrefetcher&) = delete;
+
+  // Take() waits for the next block. The buffer must be given back with Release().
+  Buffer* Take() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    filled_cv_.wait(lock, [this] { return !filled_buffers_.empty(); });
+    const auto buffer = filled_buffers_.front();
+    filled_buffers_.pop_front();
+    if (buffer->error) {
+      std::rethrow_exception(buffer->error);
+    }
+    return buffer;
+  }
+
+  void Release(Buffer* buffer) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_buffers_.push_back(buffer);
+    }
+    free_cv_.notify_one();
+  }
+
+private:
+  void Run() {
+    bool is_last = false;
+    while (!is_last) {
+      Buffer* buffer = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        free_cv_.wait(lock, [this] { return stop_ || !free_buffers_.empty(); });
+        if (stop_) {
+          return;
+        }
+        buffer = free_buffers_.front();
+        free_buffers_.pop_front();
+      }
+
+      try {
+        buffer->size = source_.Read(buffer->data.data() + kPrefetchHeadroom, block_size_);
+        buffer->is_last = buffer->size < block_size_;
+      } catch (...) {
+        buffer->error = std::current_exception();
+        buffer->is_last = true;
+      }
+      is_last = buffer->is_last;
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        filled_buffers_.push_back(buffer);
+      }
+      filled_cv_.notify_one();
+    }
+  }
+
+  InputSource& source_;
+  const size_t block_size_;
+  std::vector<Buffer> buffers_;
+  std::mutex mutex_;
+  std::condition_variable free_cv_;
+  std::condition_variable filled_cv_;
+  std::deque<Buffer*> free_buffers_;
+  std::deque<Buffer*> filled_buffers_;
+  bool stop_;
+  std::thread thread_;
+};
+
+// BlockReader parses a CSV block by block, a block holding at most
+// options.block_size bytes of whole records (unless a single record is bigger),
+// either in place from a source whose content is in memory or read from it.
+class BlockReader {
+public:
+  BlockReader(InputSource& source, const std::vector<FieldType>& field_types,
+              const ReadOptions& options)
+      : source_(source),
+        field_types_(field_types),
+        options_(options),
+        is_last_(false),
+        num_records_(0u) {
+    if (source.Data() != nullptr) {
+      OpenInPlace();
+    } else {
+      OpenRead();
+    }
+    projection_ = MakeProjection(column_names_, field_types, options);
+  }
+
+  // ColumnNames() returns every column of the CSV header
+  const std::vector<std::string>& ColumnNames() const { return column_names_; }
+  // NewDocument() returns an empty Document for the columns which are not SKIP
+  Document NewDocument() const { return csv::NewDocument(projection_, options_); }
+
+  // ParseNext() parses the next block into doc, which may add no rows at all.
+  // Returns false once the whole source has been parsed.
+  bool ParseNext(Document& doc) {
+    if (is_last_) {
+      return false;
+    }
+    if (source_.Data() != nullptr) {
+      return ParseNextInPlace(doc);
+    }
+    return prefetcher_ ? ParseNextPrefetched(doc) : ParseNextRead(doc);
+  }
+
+private:
+  void OpenInPlace() {
+    cursor_ = source_.Data();
+    end_ = cursor_ + source_.Size();
+    if (cursor_ == end_) {
+      throw std::runtime_error(std::string("Failed to parse field names from ") +
+                               source_.Name());
+    }
+
+    const auto header_end = NextLine(cursor_, end_);
+    column_names_ =
+        ParseColumnNames(cursor_, static_cast<size_t>(header_end - cursor_), options_);
+    cursor_ = header_end == end_ ? end_ : header_end + 1;
+    is_last_ = cursor_ == end_;
+    window_size_ = options_.block_size;
+  }
+
+  void OpenRead() {
+    std::vector<char> rest;
+    const auto header = ReadHeader(source_, rest);
+    column_names_ = ParseColumnNames(header.c_str(), header.size(), options_);
+
+    // the size of a stream isn't known up front
+    const auto source_size = source_.Size();
+    const auto block_size =
+        (source_size == 0u ? options_.block_size
+                           : std::min(options_.block_size, source_size)) +
+        1;
+    if (options_.pipelined) {
+      // read beyond the header, in front of the first block
+      tail_ = std::move(rest);
+      prefetcher_.reset(new BlockPrefetcher(source_, block_size));
+      return;
+    }
+    // block keeps the head of a record continuing into the next read at its front
+    block_.resize(std::max(block_size, rest.size() + 1));
+    std::copy(rest.begin(), rest.end(), block_.begin());
+    block_used_ = rest.size();
+  }
+
+  bool ParseNextInPlace(Document& doc) {
+    const auto window_end = static_cast<size_t>(end_ - cursor_) > window_size_
+                                ? cursor_ + window_size_
+                                : end_;
+    is_last_ = window_end == end_;
+    // let the kernel fetch the next window while this one is being parsed
+    source_.WillNeed(static_cast<size_t>(window_end - source_.Data()),
+                     options_.block_size);
+    const auto records_end =
+        ParseBlock(cursor_, window_end, is_last_, field_types_,
+                   projection_.document_columns, projection_.record_filter, options_,
+                   num_records_, doc);
+    if (!is_last_ && records_end == cursor_) {
+      // a single record is bigger than the window
+      window_size_ *= 2;
+    }
+    cursor_ = records_end;
+    return true;
+  }
+
+  bool ParseNextRead(Document& doc) {
+    if (block_used_ == block_.size()) {
+      // a single record is bigger than the block
+      block_.resize(block_.size() * 2);
+    }
+    const auto read_size = block_.size() - block_used_;
+    const auto size = source_.Read(block_.data() + block_used_, read_size);
+    block_used_ += size;
+    is_last_ = size < read_size;
+
+    const auto block_end = block_.data() + block_used_;
+    const auto records_end =
+        ParseBlock(block_.data(), block_end, is_last_, field_types_,
+                   projection_.document_columns, projection_.record_filter, options_,
+                   num_records_, doc);
+    std::copy(records_end, static_cast<const char*>(block_end), block_.data());
+    block_used_ = static_cast<size_t>(block_end - records_end);
+    return true;
+  }
+
+  bool ParseNextPrefetched(Document& doc) {
+    const auto buffer = prefetcher_->Take();
+    char* block_begin = buffer->data.data() + kPrefetchHeadroom;
+    const char* block_end = block_begin + buffer->size;
+    // put the head of the record continuing from the previous block in front of it
+    if (tail_.size() <= kPrefetchHeadroom) {
+      block_begin -= tail_.size();
+      std::copy(tail_.begin(), tail_.end(), block_begin);
+    } else {
+      // a record longer than the headroom, rare enough to copy
+      merged_.assign(tail_.begin(), tail_.end());
+      merged_.insert(merged_.end(), static_cast<const char*>(block_begin), block_end);
+      block_begin = merged_.data();
+      block_end = block_begin + merged_.size();
+    }
+    is_last_ = buffer->is_last;
+
+    const auto records_end =
+        ParseBlock(block_begin, block_end, is_last_, field_types_,
+                   projection_.document_columns, projection_.record_filter, options_,
+                   num_records_, doc);
+    tail_.assign(records_end, block_end);
+    prefetcher_->Release(buffer);
+    return true;
+  }
 
+  InputSource& source_;
+  const std::vector<FieldType> field_types_;
+  const ReadOptions options_;
+  std::vector<std::string> column_names_;
+  Projection projection_;
+  bool is_last_;
+  size_t num_records_;
+
+  // a source in memory
+  const char* cursor_;
+  const char* end_;
+  size_t window_size_;
+
+  // otherwise
+  std::vector<char> block_;
+  size_t block_used_;
+
+  // pipelined, declared last to stop reading before the reader is gone
+  std::vector<char> tail_;
+  std::vector<char> merged_;
+  std::unique_ptr<BlockPrefetcher> prefetcher_;
+};
+
+Document ReadCSV(const std::string& path, const std::vector<FieldType>& field_types,
+                 ReadOptions options) {
+  return ReadCached(path, field_types, options, [&]() {
+    const auto source =
+        OpenSource(path, options.use_mmap, options.num_threads, &options.Pool());
+    return ReadCSV(*source, field_types, options);
+  });
+}
+
+Document ReadCSV(InputSource& source, const std::vector<FieldType>& field_types,
+                 ReadOptions options) {
+  BlockReader block_reader(source, field_types, options);
+  Document doc = block_reader.NewDocument();
+  while (block_reader.ParseNext(doc)) {
+  }
+  return doc;
+}
+
+Document ReadCSV(const std::string& path, ReadOptions options) {
+  // a cache hit skips inference too
+  return ReadCached(path, std::vector<FieldType>(), options, [&]() {
+    auto parse_options = options;
+    parse_options.cache_dir.clear();
+    return ReadInferred(InferFieldTypes(path, options),
+                        [&](const std::vector<FieldType>& field_types) {
+                          return ReadCSV(path, field_types, parse_options);
+                        });
+  });
+}
+
+Document ReadCSVFiles(const std::vector<std::string>& paths,
+                      const std::vector<FieldType>& field_types, ReadOptions options) {
+  if (paths.empty()) {
+    throw std::invalid_argument("no CSV file to read");
+  }
+  // mapped files are parsed in place, compressed ones streamed by a BlockReader.
+  // Readers of all compressed files are open at once, so none reads ahead.
+  auto stream_options = options;
+  stream_options.pipelined = false;
+  std::vector<std::unique_ptr<InputSource>> sources;
+  std::vector<std::unique_ptr<BlockReader>> block_readers(paths.size());
+  std::vector<const char*> records_begins;
+  std::vector<const char*> file_ends;
+  std::vector<std::string> column_names;
+  for (size_t file_index = 0u; file_index < paths.size(); ++file_index) {
+    const auto& path = paths[file_index];
+    sources.push_back(OpenSource(path, true, options.num_threads, &options.Pool()));
+    const char* data = sources.back()->Data();
+    const char* end = data + sources.back()->Size();
+    std::vector<std::string> file_column_names;
+    if (data == nullptr) {
+      block_readers[file_index].reset(
+          new BlockReader(*sources.back(), field_types, stream_options));
+      file_column_names = block_readers[file_index]->ColumnNames();
+      end = nullptr;
+    } else {
+      if (data == end) {
+        throw std::runtime_error(std::string("Failed to parse field names from ") +
+                                 path);
+      }
+      const auto header_end = NextLine(data, end);
+      file_column_names =
+          ParseColumnNames(data, static_cast<size_t>(header_end - data), options);
+      data = header_end == end ? end : header_end + 1;
+    }
+    if (file_index == 0u) {
+      column_names = std::move(file_column_names);
+    } else if (file_column_names != column_names) {
+      throw std::runtime_error(std::string("header of ") + path +
+                               " doesn't match header of " + paths[0]);
+    }
+    records_begins.push_back(data);
+    file_ends.push_back(end);
+  }
+  const auto projection = MakeProjection(column_names, field_types, options);
+
+  // pieces no bigger than those of a block read by ReadCSV(), unless that makes
+  // more than kMaxPiecesPerThread per thread in all: then each file gets its share
+  // of those by size, a piece at least
+  size_t total_size = 0u;
+  for (size_t file_index = 0u; file_index < paths.size(); ++file_index) {
+    total_size += static_cast<size_t>(file_ends[file_index] - records_begins[file_index]);
+  }
+  const auto max_pieces =
+      kMaxPiecesPerThread * static_cast<size_t>(std::max(options.num_threads, 1));
+  std::vector<std::vector<Piece>> file_pieces(paths.size());
+  auto split = [&](size_t file_index, int num_threads) {
+    const char* const end = file_ends[file_index];
+    const auto size = static_cast<size_t>(end - records_begins[file_index]);
+    const auto block_size = std::max(options.block_size, size_t{1u});
+    const auto num_pieces = std::min(
+        std::max(size_t{1u}, (size + block_size - 1) / block_size) *
+            NumPieces(std::min(size, block_size), options),
+        std::max(size_t{1u}, size * max_pieces / std::max(total_size, size_t{1u})));
+    const char* records_end = nullptr;
+    file_pieces[file_index] =
+        SplitRecords(records_begins[file_index], end, true, num_pieces, options.quotechar,
+                     num_threads, records_end, &options.Pool());
+  };
+  // files of a single piece are split in parallel, bigger ones with every thread each
+  std::vector<size_t> small_files;
+  for (size_t file_index = 0u; file_index < paths.size(); ++file_index) {
+    if (block_readers[file_index]) {
+      continue;
+    }
+    const auto size =
+        static_cast<size_t>(file_ends[file_index] - records_begins[file_index]);
+    if (NumPieces(size, options) == 1u) {
+      small_files.push_back(file_index);
+    } else {
+      split(file_index, options.num_threads);
+    }
+  }
+  options.Pool().ParallelFor(small_files.size(), options.num_threads,
+                             [&](size_t idx) { split(small_files[idx], 1); });
+
+  struct Task {
+    size_t file_index;
+    const Piece* piece;
+    size_t first_record;
+    uint64_t sequence;
+  };
+  std::vector<Task> tasks;
+  // the tasks of the files before each file
+  std::vector<size_t> first_tasks;
+  uint64_t sequence = 0u;
+  for (size_t file_index = 0u; file_index < paths.size(); ++file_index) {
+    first_tasks.push_back(tasks.size());
+    size_t num_records = 0u;
+    for (const auto& piece : file_pieces[file_index]) {
+      tasks.push_back(Task{file_index, &piece, num_records, sequence});
+      num_records += piece.num_rows;
+      sequence += piece.num_rows;
+    }
+  }
+
+  // the pieces of every run of mapped files are parsed in one loop, their chunks
+  // ordered by the number of their first record in all files. A compressed file is
+  // streamed between two runs, one block at a time, rather than decompressed whole.
+  Document doc = NewDocument(projection, options);
+  size_t done_tasks = 0u;
+  auto parse_tasks = [&](size_t end_task) {
+    options.Pool().ParallelFor(
+        end_task - done_tasks, options.num_threads, [&](size_t idx) {
+          const auto& task = tasks[done_tasks + idx];
+          if (task.piece->num_rows == 0u) {
+            return;
+          }
+          try {
+            ParseRecords(*task.piece, task.first_record, task.sequence, field_types,
+                         projection.document_columns, projection.record_filter,
+                         options, doc);
+          } catch (const std::runtime_error& e) {
+            throw std::runtime_error(paths[task.file_index] + ": " + e.what());
+          }
+        });
+    doc.StitchChunks();
+    done_tasks = end_task;
+  };
+  for (size_t file_index = 0u; file_index < paths.size(); ++file_index) {
+    if (!block_readers[file_index]) {
+      continue;
+    }
+    parse_tasks(first_tasks[file_index]);
+    try {
+      while (block_readers[file_index]->ParseNext(doc)) {
+      }
+    } catch (const std::runtime_error& e) {
+      throw std::runtime_error(paths[file_index] + ": " + e.what());
+    }
+    // its buffers aren't needed anymore
+    block_readers[file_index].reset();
+  }
+  parse_tasks(tasks.size());
   return doc;
 }
 
+Document ReadCSVFiles(const std::vector<std::string>& paths, ReadOptions options) {
+  if (paths.empty()) {
+    throw std::invalid_argument("no CSV file to read");
+  }
+  return ReadInferred(InferFieldTypes(paths[0], options),
+                      [&](const std::vector<FieldType>& field_types) {
+                        return ReadCSVFiles(paths, field_types, options);
+                      });
+}
+
+std::vector<std::string> GlobPaths(const std::string& pattern) {
+  glob_t matches;
+  const int result = glob(pattern.c_str(), 0, nullptr, &matches);
+  std::vector<std::string> paths;
+  if (result == 0) {
+    paths.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+  }
+  globfree(&matches);
+  if (result != 0 && result != GLOB_NOMATCH) {
+    throw std::runtime_error(std::string("Failed to glob ") + pattern);
+  }
+  return paths;
+}
+
+CsvStreamReader::CsvStreamReader(const std::string& path,
+                                 const std::vector<FieldType>& field_types,
+                                 ReadOptions options)
+    : CsvStreamReader(
+          OpenSource(path, options.use_mmap, options.num_threads, &options.Pool()),
+          field_types, options) {}
+
+CsvStreamReader::CsvStreamReader(std::unique_ptr<InputSource> source,
+                                 const std::vector<FieldType>& field_types,
+                                 ReadOptions options)
+    : source_(std::move(source)),
+      block_reader_(new BlockReader(*source_, field_types, options)),
+      num_rows_read_(0u) {}
+
+CsvStreamReader::~CsvStreamReader() = default;
+
+const std::vector<std::string>& CsvStreamReader::ColumnNames() const {
+  return block_reader_->ColumnNames();
+}
+
+bool CsvStreamReader::Next(Batch& batch) {
+  if (batch.document) {
+    batch.document->Clear();
+  } else {
+    batch.document.reset(new Document(block_reader_->NewDocument()));
+  }
+
+  auto& doc = *batch.document;
+  // a block may hold no complete record, e.g. when a record is bigger than it
+  while (doc.NumRows() == 0u && block_reader_->ParseNext(doc)) {
+  }
+  batch.first_row = num_rows_read_;
+  num_rows_read_ += doc.NumRows();
+  return doc.NumRows() != 0u;
+}
+
 }  // namespace csv
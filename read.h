@@ -2,30 +2,147 @@
 #define __READ_H__
 
 #include <istream>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "base.h"
 #include "document.h"
+#include "filter.h"
+#include "input.h"
+#include "thread_pool.h"
 
 namespace csv {
 
 struct ReadOptions {
   char quotechar;
   char separator;
+  // most threads of thread_pool one parallel loop runs on
   int num_threads;
+  // parse straight from a read-only memory map of the file (a MappedSource) instead
+  // of reading it into blocks (a FileSource)
+  bool use_mmap;
+  // layout of the returned Document
+  Layout layout;
+  // bytes read and parsed at once, which bounds a CsvStreamReader batch
+  size_t block_size;
+  // read the next block on an I/O thread while the current one is being parsed.
+  // Applies to sources read into blocks only; memory is parsed in place.
+  bool pipelined;
+  // only records the filter accepts are stored, the others are dropped as soon as
+  // the filter's last column is parsed
+  Filter filter;
+  // when not empty, ReadCSV() keeps the Document it parses in this directory (see
+  // Document::Save()) and loads it instead of parsing again as long as the file's
+  // path, size, modification time and these options are the same. Ignored when
+  // filtering.
+  std::string cache_dir;
+  // memory of the returned Document's chunks, e.g. a PooledChunkAllocator shared by
+  // several readers. Each Document pools its own memory by default.
+  std::shared_ptr<ChunkAllocator> allocator;
+  // threads parsing runs on, at most num_threads of them at once, and which the
+  // returned Document's Get*() run on. Sharing one pool between readers, or with
+  // the application, keeps them from starting more threads than there are cores.
+  // DefaultThreadPool() when null.
+  std::shared_ptr<ThreadPool> thread_pool;
 
-  ReadOptions() : quotechar('"'), separator(','), num_threads(16) {}
-  ReadOptions(char quotechar, char separator, int num_threads)
-      : quotechar(quotechar), separator(separator), num_threads(num_threads) {}
+  ReadOptions()
+      : quotechar('"'),
+        separator(','),
+        num_threads(16),
+        use_mmap(false),
+        layout(Layout::ROW),
+        block_size(256 * 1024 * 1024),
+        pipelined(false) {}
+  ReadOptions(char quotechar, char separator, int num_threads, bool use_mmap = false)
+      : quotechar(quotechar),
+        separator(separator),
+        num_threads(num_threads),
+        use_mmap(use_mmap),
+        layout(Layout::ROW),
+        block_size(256 * 1024 * 1024),
+        pipelined(false) {}
+
+  // Pool() returns thread_pool, or DefaultThreadPool() when it is null
+  ThreadPool& Pool() const { return thread_pool ? *thread_pool : *DefaultThreadPool(); }
 };
 
 std::vector<std::string> ColumnNames(std::istream& file_in, const std::string& path,
                                      ReadOptions options = ReadOptions());
+// This ColumnNames() parses the header of a source which hasn't been read yet. A
+// source which isn't in memory is then left past the header.
+std::vector<std::string> ColumnNames(InputSource& source,
+                                     ReadOptions options = ReadOptions());
 
+// ReadCSV() parses a whole CSV file. field_types has one entry per column of the
+// file; columns typed FieldType::SKIP are left out of the returned Document.
+// A gzip or zstd compressed file (see decompress.h) is decompressed block by block
+// as it is parsed, on the I/O thread when pipelined; use_mmap doesn't apply to it.
 Document ReadCSV(const std::string& path, const std::vector<FieldType>& field_types,
                  ReadOptions options = ReadOptions());
+// This ReadCSV() takes field types from InferFieldTypes() (see infer.h). As those
+// are guessed from samples, a numeric column with a cell outside them which doesn't
+// convert is widened (to DOUBLE or VARSTRING) and the file is parsed again.
+Document ReadCSV(const std::string& path, ReadOptions options = ReadOptions());
+// This ReadCSV() parses any InputSource (see input.h), e.g. a buffer already in
+// memory or a pipe. The source picks how it is read: use_mmap and cache_dir don't
+// apply.
+Document ReadCSV(InputSource& source, const std::vector<FieldType>& field_types,
+                 ReadOptions options = ReadOptions());
+
+// ReadCSVFiles() parses CSV files with the same header into one Document, the rows
+// of each file after those of the previous one. Every file is memory mapped and
+// split into pieces, and the pieces of all files are parsed by one parallel loop,
+// each straight into a chunk of the Document, so that many small files are read
+// about as fast as one big one. Compressed files are instead parsed block by block
+// as they are decompressed, in their turn. Throws if a header differs from the
+// first file's.
+Document ReadCSVFiles(const std::vector<std::string>& paths,
+                      const std::vector<FieldType>& field_types,
+                      ReadOptions options = ReadOptions());
+// This ReadCSVFiles() takes field types from InferFieldTypes() of the first file,
+// widened as by ReadCSV() when a cell of any file doesn't convert.
+Document ReadCSVFiles(const std::vector<std::string>& paths,
+                      ReadOptions options = ReadOptions());
+// GlobPaths() returns the paths matching a shell pattern, e.g. "daily/*.csv", sorted
+std::vector<std::string> GlobPaths(const std::string& pattern);
+
+class BlockReader;
+
+// Batch is a block of records parsed by CsvStreamReader::Next().
+struct Batch {
+  // created by the first Next() call, then cleared and refilled by later ones
+  std::unique_ptr<Document> document;
+  // row number of the batch's first record in the whole file
+  size_t first_row;
+
+  Batch() : first_row(0u) {}
+};
+
+// CsvStreamReader parses a CSV file one block of records (ReadOptions::block_size,
+// 256MB by default) at a time, so memory use stays constant however big the file
+// is. Passing the same Batch to every Next() call reuses its chunk memory.
+class CsvStreamReader {
+public:
+  CsvStreamReader(const std::string& path, const std::vector<FieldType>& field_types,
+                  ReadOptions options = ReadOptions());
+  CsvStreamReader(std::unique_ptr<InputSource> source,
+                  const std::vector<FieldType>& field_types,
+                  ReadOptions options = ReadOptions());
+  ~CsvStreamReader();
+
+  // ColumnNames() returns every column of the CSV header, SKIP ones included
+  const std::vector<std::string>& ColumnNames() const;
+  // Next() replaces the content of batch with the next block of records.
+  // Returns false once every record has been read.
+  bool Next(Batch& batch);
+
+private:
+  std::unique_ptr<InputSource> source_;
+  std::unique_ptr<BlockReader> block_reader_;
+  size_t num_rows_read_;
+};
 }  // namespace csv
 
 #endif
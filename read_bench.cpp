@@ -0,0 +1,104 @@
+// Compares reading then parsing each block in turn with the pipelined mode, where
+// an I/O thread reads the next block meanwhile, and with the memory map.
+// The file is dropped from the page cache before every run, so it is read from disk
+// as it would be for a file larger than the page cache.
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "read.h"
+#include "stop_watch.h"
+
+namespace {
+
+constexpr int kNumIntColumns = 8;
+
+std::vector<csv::FieldType> FieldTypes() {
+  std::vector<csv::FieldType> field_types(kNumIntColumns, csv::FieldType::INT64);
+  field_types.push_back(csv::FieldType::DOUBLE);
+  field_types.push_back(csv::FieldType::STRING);
+  return field_types;
+}
+
+void MakeFile(const std::string& path, size_t size) {
+  std::mt19937 random(11);
+  std::uniform_int_distribution<int64_t> value(0, 99999999);
+  std::ofstream ofs(path);
+  for (int column = 0; column < kNumIntColumns; ++column) {
+    ofs << 'i' << column << ',';
+  }
+  ofs << "d,s\n";
+  std::string record;
+  size_t written = 0u;
+  while (written < size) {
+    record.clear();
+    for (int column = 0; column < kNumIntColumns; ++column) {
+      record += std::to_string(value(random));
+      record += ',';
+    }
+    record += std::to_string(value(random)) + ".25,code" +
+              std::to_string(value(random) % 100) + '\n';
+    ofs << record;
+    written += record.size();
+  }
+}
+
+void DropFromPageCache(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "can't open " << path << '\n';
+    std::exit(1);
+  }
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+void Run(const std::string& name, const std::string& path, size_t file_size,
+         const csv::ReadOptions& options) {
+  DropFromPageCache(path);
+  Stopwatch watch(name);
+  watch.Start();
+  const auto start = std::chrono::high_resolution_clock::now();
+  csv::CsvStreamReader reader(path, FieldTypes(), options);
+  csv::Batch batch;
+  size_t num_rows = 0u;
+  while (reader.Next(batch)) {
+    num_rows += batch.document->NumRows();
+  }
+  watch.End();
+  const std::chrono::duration<double> seconds =
+      std::chrono::high_resolution_clock::now() - start;
+  std::cout << "  rows: " << num_rows << ", "
+            << static_cast<double>(file_size) / (1024 * 1024) / seconds.count()
+            << " MB/s\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t size_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4096u;
+  const std::string path = argc > 2 ? argv[2] : "read_bench.csv";
+  const int num_threads = argc > 3 ? std::atoi(argv[3]) : 16;
+
+  if (!std::ifstream(path)) {
+    MakeFile(path, size_mb * 1024 * 1024);
+  }
+  std::ifstream file_in(path, std::ios::ate);
+  const auto file_size = static_cast<size_t>(file_in.tellg());
+
+  csv::ReadOptions options('"', ',', num_threads);
+  Run("sequential", path, file_size, options);
+  options.pipelined = true;
+  Run("pipelined", path, file_size, options);
+  options.pipelined = false;
+  options.use_mmap = true;
+  Run("mmap", path, file_size, options);
+  return 0;
+}
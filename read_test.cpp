@@ -1,10 +1,26 @@
 #include "read.h"
 
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
 #include <sstream>
+#include <thread>
 #include <gtest/gtest.h>
 
+#include "infer.h"
+
+#ifdef PCSV_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef PCSV_WITH_ZSTD
+#include <zstd.h>
+#endif
+
 namespace {
 
 struct TempFileHandle {
@@ -13,6 +29,31 @@ struct TempFileHandle {
   ~TempFileHandle() { if (!file_name.empty()) std::remove(file_name.c_str()); }
 };
 
+struct TempDirHandle {
+  std::string dir_name;
+  TempDirHandle() {
+    char dir_template[] = "/tmp/read_testXXXXXX";
+    dir_name = mkdtemp(dir_template);
+  }
+  ~TempDirHandle() {
+    for (const auto& file_name : FileNames()) {
+      std::remove((dir_name + '/' + file_name).c_str());
+    }
+    std::remove(dir_name.c_str());
+  }
+  std::vector<std::string> FileNames() const {
+    std::vector<std::string> file_names;
+    DIR* dir = opendir(dir_name.c_str());
+    while (dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') {
+        file_names.push_back(entry->d_name);
+      }
+    }
+    closedir(dir);
+    return file_names;
+  }
+};
+
 TEST(TestReadCSV, ColumnNames) {
   std::stringstream ss;
   ss << "id,name,age,grade\n";
@@ -22,6 +63,18 @@ TEST(TestReadCSV, ColumnNames) {
   EXPECT_STREQ("name", column_names[1].c_str());
   EXPECT_STREQ("age", column_names[2].c_str());
   EXPECT_STREQ("grade", column_names[3].c_str());
+
+  // split like a record, escaped quotes included
+  const std::string quoted_line = "id,\"a \"\"x\"\", b\",age\n";
+  std::stringstream quoted(quoted_line + quoted_line);
+  EXPECT_EQ((std::vector<std::string>{"id", "\"a \"\"x\"\", b\"", "age"}),
+            csv::ColumnNames(quoted, ""));
+  TempFileHandle file_handle;
+  std::ofstream(file_handle.file_name) << quoted_line << "1,\"a \"\"x\"\", b\",2\n";
+  auto document = csv::ReadCSV(
+      file_handle.file_name,
+      {csv::FieldType::INT64, csv::FieldType::STRING, csv::FieldType::INT64});
+  EXPECT_EQ((std::vector<int64_t>{2}), document.GetAsInt64("age"));
 }
 
 TEST(TestReadCSV, ReadCSV) {
@@ -50,4 +103,641 @@ TEST(TestReadCSV, ReadCSV) {
   ASSERT_EQ(4u, grades.size());
 }
 
+TEST(TestReadCSV, ReadCSVMmap) {
+  const std::string file_content = "id|name|age|grade\n"
+                                   "0|A|20|2.7\n"
+                                   "1|B|19|4.1\n"
+                                   "\n"
+                                   "2|AB|9|4.12\n"
+                                   "3|ABCD|24|3.1415";
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << file_content;
+  ofs.close();
+
+  auto document = csv::ReadCSV(file_handle.file_name,
+                               {csv::FieldType::INT64, csv::FieldType::STRING,
+                                csv::FieldType::INT64, csv::FieldType::DOUBLE},
+                               csv::ReadOptions('"', '|', 4, true));
+
+  std::vector<int64_t> ids = document.GetAsInt64("id");
+  std::vector<std::string> names = document.GetAsString("name");
+  std::vector<int64_t> ages = document.GetAsInt64("age");
+  std::vector<double> grades = document.GetAsDouble("grade");
+
+  ASSERT_EQ(4u, ids.size());
+  EXPECT_EQ(3, ids[3]);
+  EXPECT_STREQ("AB", names[2].c_str());
+  EXPECT_EQ(19, ages[1]);
+  EXPECT_DOUBLE_EQ(3.1415, grades[3]);
+}
+
+TEST(TestReadCSV, ReadCSVQuotedNewline) {
+  const std::string file_content = "id,name,age\r\n"
+                                   "0,\"A\nB\",20\r\n"
+                                   "1,\"x,y\",19\r\n"
+                                   "\r\n"
+                                   "2,AB,9\r\n";
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << file_content;
+  ofs.close();
+
+  for (bool use_mmap : {false, true}) {
+    auto document = csv::ReadCSV(
+        file_handle.file_name,
+        {csv::FieldType::INT64, csv::FieldType::STRING, csv::FieldType::INT64},
+        csv::ReadOptions('"', ',', 4, use_mmap));
+
+    std::vector<int64_t> ids = document.GetAsInt64("id");
+    std::vector<std::string> names = document.GetAsString("name");
+    std::vector<int64_t> ages = document.GetAsInt64("age");
+
+    ASSERT_EQ(3u, ids.size());
+    EXPECT_EQ(2, ids[2]);
+    EXPECT_EQ(std::string("\"A\nB\""), names[0]);
+    EXPECT_EQ(std::string("\"x,y\""), names[1]);
+    EXPECT_EQ(20, ages[0]);
+    EXPECT_EQ(9, ages[2]);
+  }
+}
+
+TEST(TestReadCSV, ReadCSVManyPieces) {
+  // big enough to be split into several pieces
+  constexpr int64_t num_rows = 200000;
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id|name|grade\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ofs << row << "|\"name\n" << row % 7 << "\"|" << row << ".5\n";
+  }
+  ofs.close();
+
+  for (bool use_mmap : {false, true}) {
+    csv::ReadOptions options('"', '|', 4, use_mmap);
+    options.layout = use_mmap ? csv::Layout::COLUMN : csv::Layout::ROW;
+    auto document = csv::ReadCSV(
+        file_handle.file_name,
+        {csv::FieldType::INT64, csv::FieldType::STRING, csv::FieldType::DOUBLE}, options);
+
+    std::vector<int64_t> ids = document.GetAsInt64("id");
+    std::vector<std::string> names = document.GetAsString("name");
+    std::vector<double> grades = document.GetAsDouble("grade");
+    ASSERT_EQ(static_cast<size_t>(num_rows), ids.size());
+    for (int64_t row = 0; row < num_rows; ++row) {
+      ASSERT_EQ(row, ids[row]);
+      ASSERT_EQ("\"name\n" + std::to_string(row % 7) + "\"", names[row]);
+      ASSERT_DOUBLE_EQ(row + 0.5, grades[row]);
+    }
+  }
+}
+
+TEST(TestReadCSV, ReadCSVVarString) {
+  const std::string long_name(100, 'n');
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,name\n0," << long_name << "\n1,KR\n";
+  ofs.close();
+
+  EXPECT_THROW(csv::ReadCSV(file_handle.file_name,
+                            {csv::FieldType::INT64, csv::FieldType::STRING}),
+               std::runtime_error);
+
+  auto document = csv::ReadCSV(file_handle.file_name,
+                               {csv::FieldType::INT64, csv::FieldType::VARSTRING});
+  EXPECT_EQ((std::vector<std::string>{long_name, "KR"}), document.GetAsString("name"));
+}
+
+TEST(TestReadCSV, ReadCSVCategory) {
+  // big enough to be split into several pieces parsed in parallel
+  constexpr int64_t num_rows = 200000;
+  const std::vector<std::string> countries{"KR", "US", "FR", "DE", "JP"};
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,country\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ofs << row << ',' << countries[(row / 3) % countries.size()] << '\n';
+  }
+  ofs.close();
+
+  csv::ReadOptions options('"', ',', 4);
+  auto document = csv::ReadCSV(
+      file_handle.file_name, {csv::FieldType::INT64, csv::FieldType::CATEGORY}, options);
+  // codes follow order of first appearance
+  const auto& dictionary = document.Dictionary("country");
+  ASSERT_EQ(countries.size(), dictionary.Size());
+  for (size_t code = 0u; code < countries.size(); ++code) {
+    EXPECT_EQ(countries[code], dictionary.Get(static_cast<int32_t>(code)).ToString());
+  }
+
+  const auto codes = document.GetCategoryCodes("country");
+  const auto values = document.GetAsString("country");
+  ASSERT_EQ(static_cast<size_t>(num_rows), codes.size());
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ASSERT_EQ((row / 3) % static_cast<int64_t>(countries.size()), codes[row]);
+    ASSERT_EQ(countries[(row / 3) % countries.size()], values[row]);
+  }
+}
+
+TEST(TestReadCSV, CsvStreamReader) {
+  constexpr int64_t num_rows = 50000;
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,name\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ofs << row << ",name" << row % 11 << '\n';
+  }
+  ofs.close();
+
+  for (int mode = 0; mode < 3; ++mode) {
+    csv::ReadOptions options('"', ',', 4, mode == 1);
+    options.block_size = 64 * 1024;
+    options.pipelined = mode == 2;
+    csv::CsvStreamReader reader(file_handle.file_name,
+                                {csv::FieldType::INT64, csv::FieldType::STRING}, options);
+    EXPECT_EQ((std::vector<std::string>{"id", "name"}), reader.ColumnNames());
+
+    csv::Batch batch;
+    size_t num_batches = 0u;
+    int64_t next_id = 0;
+    while (reader.Next(batch)) {
+      ++num_batches;
+      ASSERT_EQ(static_cast<size_t>(next_id), batch.first_row);
+      const auto ids = batch.document->GetAsInt64("id");
+      const auto names = batch.document->GetAsString("name");
+      for (size_t idx = 0u; idx < ids.size(); ++idx, ++next_id) {
+        ASSERT_EQ(next_id, ids[idx]);
+        ASSERT_EQ("name" + std::to_string(next_id % 11), names[idx]);
+      }
+    }
+    EXPECT_EQ(num_rows, next_id);
+    EXPECT_LT(1u, num_batches);
+    EXPECT_FALSE(reader.Next(batch));
+  }
+}
+
+TEST(TestReadCSV, ReadCSVPipelined) {
+  // a record longer than a block and than the room kept for it in front of one
+  const std::string long_name(3 * 1024 * 1024, 'n');
+  constexpr int64_t num_rows = 30000;
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,name\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ofs << row << ',' << (row == num_rows / 2 ? long_name : "n" + std::to_string(row))
+        << '\n';
+  }
+  ofs.close();
+
+  csv::ReadOptions options('"', ',', 4);
+  options.block_size = 64 * 1024;
+  options.pipelined = true;
+  auto document = csv::ReadCSV(
+      file_handle.file_name, {csv::FieldType::INT64, csv::FieldType::VARSTRING}, options);
+  const auto ids = document.GetAsInt64("id");
+  const auto names = document.GetAsString("name");
+  ASSERT_EQ(static_cast<size_t>(num_rows), ids.size());
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ASSERT_EQ(row, ids[row]);
+    ASSERT_EQ(row == num_rows / 2 ? long_name : "n" + std::to_string(row), names[row]);
+  }
+}
+
+TEST(TestReadCSV, ReadCSVSkip) {
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  // skipped cells are never converted, so they may hold anything
+  ofs << "id,note,grade,code\n";
+  ofs << "1,\"not, a number\",1.5,KR\n";
+  ofs << "2," << std::string(100, 'x') << ",2.5,US\n";
+  ofs.close();
+
+  for (bool use_mmap : {false, true}) {
+    csv::ReadOptions options('"', ',', 4, use_mmap);
+    auto document = csv::ReadCSV(file_handle.file_name,
+                                 {csv::FieldType::INT64, csv::FieldType::SKIP,
+                                  csv::FieldType::SKIP, csv::FieldType::STRING},
+                                 options);
+    EXPECT_EQ((std::vector<std::string>{"id", "code"}), document.FieldNames());
+    EXPECT_EQ((std::vector<int64_t>{1, 2}), document.GetAsInt64("id"));
+    EXPECT_EQ((std::vector<std::string>{"KR", "US"}), document.GetAsString("code"));
+    EXPECT_THROW(document.GetAsDouble("grade"), std::invalid_argument);
+  }
+
+  csv::CsvStreamReader reader(file_handle.file_name,
+                              {csv::FieldType::SKIP, csv::FieldType::SKIP,
+                               csv::FieldType::DOUBLE, csv::FieldType::SKIP});
+  EXPECT_EQ((std::vector<std::string>{"id", "note", "grade", "code"}),
+            reader.ColumnNames());
+  csv::Batch batch;
+  ASSERT_TRUE(reader.Next(batch));
+  EXPECT_EQ((std::vector<std::string>{"grade"}), batch.document->FieldNames());
+  EXPECT_EQ((std::vector<double>{1.5, 2.5}), batch.document->GetAsDouble("grade"));
+}
+
+TEST(TestReadCSV, ReadCSVFilter) {
+  // big enough to be split into several pieces
+  constexpr int64_t num_rows = 200000;
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,status,grade\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    // cells of rejected records are never converted, so they may be invalid
+    ofs << row << ',' << (row % 20 == 0 ? "FAIL" : "OK") << ','
+        << (row % 20 == 0 ? std::to_string(row) + ".5" : "not a number") << '\n';
+  }
+  ofs.close();
+
+  for (int mode = 0; mode < 3; ++mode) {
+    csv::ReadOptions options('"', ',', 4, mode == 1);
+    options.pipelined = mode == 2;
+    options.layout = mode == 1 ? csv::Layout::COLUMN : csv::Layout::ROW;
+    options.filter = csv::Filter::Compare("status", csv::CompareOp::EQ, "FAIL");
+    auto document = csv::ReadCSV(file_handle.file_name,
+                                 {csv::FieldType::INT64, csv::FieldType::CATEGORY,
+                                  csv::FieldType::DOUBLE},
+                                 options);
+
+    ASSERT_EQ(static_cast<size_t>(num_rows / 20), document.NumRows());
+    const auto ids = document.GetAsInt64("id");
+    const auto grades = document.GetAsDouble("grade");
+    for (size_t idx = 0u; idx < ids.size(); ++idx) {
+      ASSERT_EQ(static_cast<int64_t>(idx * 20), ids[idx]);
+      ASSERT_DOUBLE_EQ(static_cast<double>(idx * 20) + 0.5, grades[idx]);
+    }
+    EXPECT_EQ(1u, document.Dictionary("status").Size());
+  }
+
+  csv::ReadOptions options;
+  options.filter =
+      csv::Filter::Or(csv::Filter::Compare("id", csv::CompareOp::LT, int64_t{3}),
+                      csv::Filter::Compare("id", csv::CompareOp::GE, num_rows - 1));
+  auto document = csv::ReadCSV(file_handle.file_name,
+                               {csv::FieldType::INT64, csv::FieldType::SKIP,
+                                csv::FieldType::SKIP},
+                               options);
+  EXPECT_EQ((std::vector<int64_t>{0, 1, 2, num_rows - 1}), document.GetAsInt64("id"));
+
+  // a piece keeping most records fills several chunks, with the compared ids
+  // written as the filter converted them
+  options.num_threads = 4;
+  options.filter = csv::Filter::And(
+      csv::Filter::Compare("id", csv::CompareOp::NE, int64_t{7}),
+      csv::Filter::Compare("id", csv::CompareOp::LT, 1.5e5));
+  document = csv::ReadCSV(file_handle.file_name,
+                          {csv::FieldType::INT64, csv::FieldType::CATEGORY,
+                           csv::FieldType::SKIP},
+                          options);
+  EXPECT_GT(document.NumChunks(), 4u);
+  const auto ids = document.GetAsInt64("id");
+  ASSERT_EQ(static_cast<size_t>(150000 - 1), ids.size());
+  for (size_t idx = 0u; idx < ids.size(); ++idx) {
+    ASSERT_EQ(static_cast<int64_t>(idx < 7u ? idx : idx + 1u), ids[idx]);
+  }
+  EXPECT_EQ(0u, document.NullCount("id"));
+}
+
+TEST(TestReadCSV, ReadCSVNulls) {
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,grade,name\n1,,a\n,0,\n3,2.5,c\r\n4,1,";
+  ofs.close();
+
+  for (bool use_mmap : {false, true}) {
+    csv::ReadOptions options('"', ',', 4, use_mmap);
+    auto document = csv::ReadCSV(
+        file_handle.file_name,
+        {csv::FieldType::INT64, csv::FieldType::DOUBLE, csv::FieldType::STRING}, options);
+    EXPECT_EQ((std::vector<bool>{true, false, true, true}), document.GetValidity("id"));
+    EXPECT_EQ((std::vector<bool>{false, true, true, true}),
+              document.GetValidity("grade"));
+    EXPECT_EQ((std::vector<bool>{true, false, true, false}),
+              document.GetValidity("name"));
+    EXPECT_EQ((std::vector<double>{0.0, 0.0, 2.5, 1.0}), document.GetAsDouble("grade"));
+
+    // filters never keep a null, even where its stored value would match
+    options.filter = csv::Filter::Compare("grade", csv::CompareOp::LE, 0.0);
+    document = csv::ReadCSV(
+        file_handle.file_name,
+        {csv::FieldType::INT64, csv::FieldType::DOUBLE, csv::FieldType::STRING}, options);
+    EXPECT_EQ((std::vector<bool>{false}), document.GetValidity("id"));
+    options.filter = csv::Filter::Compare("name", csv::CompareOp::NE, "a");
+    document = csv::ReadCSV(
+        file_handle.file_name,
+        {csv::FieldType::INT64, csv::FieldType::DOUBLE, csv::FieldType::STRING}, options);
+    EXPECT_EQ((std::vector<int64_t>{3}), document.GetAsInt64("id"));
+  }
+}
+
+TEST(TestReadCSV, ReadCSVCache) {
+  TempFileHandle file_handle;
+  TempDirHandle cache_handle;
+  auto write_file = [&file_handle](const std::string& content, time_t mtime) {
+    std::ofstream(file_handle.file_name) << content;
+    utimbuf times{mtime, mtime};
+    utime(file_handle.file_name.c_str(), &times);
+  };
+  write_file("id,name,status\n1,KR,OK\n2,US,FAIL\n3,,OK\n", 1000000);
+
+  csv::ReadOptions options('"', ',', 4);
+  options.cache_dir = cache_handle.dir_name;
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    options.layout = layout;
+    const std::vector<csv::FieldType> field_types{
+        csv::FieldType::INT64, csv::FieldType::VARSTRING, csv::FieldType::CATEGORY};
+    auto parsed = csv::ReadCSV(file_handle.file_name, field_types, options);
+    EXPECT_EQ((std::vector<int64_t>{1, 2, 3}), parsed.GetAsInt64("id"));
+    auto cached = csv::ReadCSV(file_handle.file_name, field_types, options);
+    EXPECT_EQ(layout, cached.GetLayout());
+    EXPECT_EQ((std::vector<int64_t>{1, 2, 3}), cached.GetAsInt64("id"));
+    EXPECT_EQ((std::vector<std::string>{"KR", "US", ""}), cached.GetAsString("name"));
+    EXPECT_EQ((std::vector<std::string>{"OK", "FAIL", "OK"}),
+              cached.GetAsString("status"));
+    EXPECT_EQ((std::vector<bool>{true, true, false}), cached.GetValidity("name"));
+  }
+  // a cached document allocates from options.allocator like a parsed one
+  auto allocator = std::make_shared<csv::PooledChunkAllocator>();
+  options.allocator = allocator;
+  auto cached = csv::ReadCSV(file_handle.file_name,
+                             {csv::FieldType::INT64, csv::FieldType::VARSTRING,
+                              csv::FieldType::CATEGORY},
+                             options);
+  cached.AddChunk(1);
+  cached.Clear();
+  EXPECT_NE(0u, allocator->PooledBytes());
+  options.allocator = nullptr;
+  // inferred types are cached apart
+  EXPECT_EQ(1, csv::ReadCSV(file_handle.file_name, options).GetAsInt64("id")[0]);
+  // a file per layout and field types
+  EXPECT_EQ(3u, cache_handle.FileNames().size());
+
+  // same path, size and modification time: the stale cached document is loaded
+  write_file("id,name,status\n7,KR,OK\n2,US,FAIL\n3,,OK\n", 1000000);
+  EXPECT_EQ(1, csv::ReadCSV(file_handle.file_name, options).GetAsInt64("id")[0]);
+  // a new modification time invalidates it
+  write_file("id,name,status\n7,KR,OK\n2,US,FAIL\n3,,OK\n", 2000000);
+  EXPECT_EQ(7, csv::ReadCSV(file_handle.file_name, options).GetAsInt64("id")[0]);
+  EXPECT_EQ(7, csv::ReadCSV(file_handle.file_name, options).GetAsInt64("id")[0]);
+  // as does another size
+  write_file("id,name,status\n8,KR,OK\n", 2000000);
+  EXPECT_EQ(8, csv::ReadCSV(file_handle.file_name, options).GetAsInt64("id")[0]);
+
+  // filtered reads aren't cached
+  options.filter = csv::Filter::Compare("id", csv::CompareOp::GT, int64_t{100});
+  EXPECT_EQ(0u, csv::ReadCSV(file_handle.file_name, options).NumRows());
+}
+
+TEST(TestReadCSV, ReadCSVFiles) {
+  TempDirHandle dir_handle;
+  // one file of many pieces among small ones, one of them without records
+  const std::vector<size_t> file_rows{3u, 200000u, 0u, 1u, 5u};
+  std::vector<std::string> paths;
+  int64_t id = 0;
+  for (size_t file_index = 0u; file_index < file_rows.size(); ++file_index) {
+    paths.push_back(dir_handle.dir_name + "/part-" + std::to_string(file_index) + ".csv");
+    std::ofstream ofs(paths.back());
+    ofs << "id,status,note\n";
+    for (size_t row = 0u; row < file_rows[file_index]; ++row, ++id) {
+      ofs << id << ",S" << (id % 3 == 0 ? file_index : 9u) << ",\"a,\nb\"\n";
+    }
+  }
+
+  csv::ReadOptions options('"', ',', 4);
+  options.block_size = 1024 * 1024;
+  const std::vector<csv::FieldType> field_types{
+      csv::FieldType::INT64, csv::FieldType::CATEGORY, csv::FieldType::SKIP};
+  auto document = csv::ReadCSVFiles(paths, field_types, options);
+  EXPECT_EQ((std::vector<std::string>{"id", "status"}), document.FieldNames());
+  ASSERT_GT(document.NumChunks(), file_rows.size());
+  const auto ids = document.GetAsInt64("id");
+  ASSERT_EQ(static_cast<size_t>(id), ids.size());
+  for (size_t row = 0u; row < ids.size(); ++row) {
+    ASSERT_EQ(static_cast<int64_t>(row), ids[row]);
+  }
+  // codes in order of first appearance over the files
+  const auto& dictionary = document.Dictionary("status");
+  ASSERT_EQ(4u, dictionary.Size());
+  EXPECT_EQ("S0", dictionary.Get(0).ToString());
+  EXPECT_EQ("S9", dictionary.Get(1).ToString());
+  EXPECT_EQ("S1", dictionary.Get(2).ToString());
+  EXPECT_EQ("S4", dictionary.Get(3).ToString());
+
+  // the same as reading each file
+  const auto part = csv::ReadCSV(paths[4], field_types, options);
+  EXPECT_EQ(part.GetAsInt64("id"),
+            std::vector<int64_t>(ids.end() - file_rows[4], ids.end()));
+
+  EXPECT_EQ(paths, csv::GlobPaths(dir_handle.dir_name + "/part-*.csv"));
+  EXPECT_TRUE(csv::GlobPaths(dir_handle.dir_name + "/none-*.csv").empty());
+  EXPECT_EQ(static_cast<size_t>(id),
+            csv::ReadCSVFiles(csv::GlobPaths(dir_handle.dir_name + "/*.csv"), options)
+                .NumRows());
+
+  options.filter = csv::Filter::Compare("id", csv::CompareOp::GE, int64_t{200003});
+  EXPECT_EQ(6u, csv::ReadCSVFiles(paths, field_types, options).NumRows());
+  // chunks added as accepted rows need them keep the order of the files
+  options.filter = csv::Filter::Compare("id", csv::CompareOp::NE, int64_t{1});
+  const auto filtered_ids =
+      csv::ReadCSVFiles(paths, field_types, options).GetAsInt64("id");
+  ASSERT_EQ(ids.size() - 1u, filtered_ids.size());
+  for (size_t row = 0u; row < filtered_ids.size(); ++row) {
+    ASSERT_EQ(static_cast<int64_t>(row < 1u ? row : row + 1u), filtered_ids[row]);
+  }
+
+  // small blocks don't make more pieces than a few per thread, a file's at least
+  options.filter = csv::Filter();
+  options.block_size = 16 * 1024;
+  document = csv::ReadCSVFiles(paths, field_types, options);
+  EXPECT_LE(document.NumChunks(), 4u * 4u + file_rows.size());
+  EXPECT_EQ(ids, document.GetAsInt64("id"));
+}
+
+TEST(TestReadCSV, ReadCSVFilesInvalid) {
+  TempFileHandle first_handle;
+  TempFileHandle second_handle;
+  std::ofstream(first_handle.file_name) << "id,name\n1,a\n";
+  std::ofstream(second_handle.file_name) << "id,other\n2,b\n";
+  const std::vector<csv::FieldType> field_types{csv::FieldType::INT64,
+                                                csv::FieldType::STRING};
+  EXPECT_THROW(
+      csv::ReadCSVFiles({first_handle.file_name, second_handle.file_name}, field_types),
+      std::runtime_error);
+  EXPECT_THROW(csv::ReadCSVFiles({}, field_types), std::invalid_argument);
+
+  std::ofstream(second_handle.file_name) << "id,name\n2,b,c\n";
+  try {
+    csv::ReadCSVFiles({first_handle.file_name, second_handle.file_name}, field_types);
+    FAIL();
+  } catch (const std::runtime_error& e) {
+    EXPECT_EQ(0u, std::string(e.what()).find(second_handle.file_name));
+  }
+}
+
+TEST(TestReadCSV, ReadCSVSources) {
+  constexpr int64_t num_rows = 50000;
+  std::ostringstream content_stream;
+  content_stream << "id,name\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    content_stream << row << ",\"n,\n" << row % 11 << "\"\n";
+  }
+  const auto content = content_stream.str();
+  const std::vector<csv::FieldType> field_types{csv::FieldType::INT64,
+                                                csv::FieldType::STRING};
+  auto check = [&](const csv::Document& document) {
+    const auto ids = document.GetAsInt64("id");
+    ASSERT_EQ(static_cast<size_t>(num_rows), ids.size());
+    for (int64_t row = 0; row < num_rows; ++row) {
+      ASSERT_EQ(row, ids[row]);
+    }
+    EXPECT_EQ("\"n,\n3\"", document.GetAsString("name")[3]);
+  };
+
+  csv::ReadOptions options('"', ',', 4);
+  options.block_size = 64 * 1024;
+  csv::MemorySource memory_source(content.data(), content.size());
+  EXPECT_EQ((std::vector<std::string>{"id", "name"}), csv::ColumnNames(memory_source));
+  check(csv::ReadCSV(memory_source, field_types, options));
+
+  for (const bool pipelined : {false, true}) {
+    options.pipelined = pipelined;
+    std::istringstream in(content);
+    csv::StreamSource stream_source(in);
+    check(csv::ReadCSV(stream_source, field_types, options));
+
+    // a pipe, filled while it is parsed
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    std::thread writer([&]() {
+      for (size_t offset = 0u; offset < content.size(); offset += 4096u) {
+        const auto size = std::min(size_t{4096u}, content.size() - offset);
+        if (write(fds[1], content.data() + offset, size) != static_cast<ssize_t>(size)) {
+          break;
+        }
+      }
+      close(fds[1]);
+    });
+    csv::DescriptorSource descriptor_source(fds[0], "pipe");
+    check(csv::ReadCSV(descriptor_source, field_types, options));
+    writer.join();
+    close(fds[0]);
+  }
+
+  options.pipelined = false;
+  std::istringstream in(content);
+  csv::CsvStreamReader reader(
+      std::unique_ptr<csv::InputSource>(new csv::StreamSource(in)), field_types, options);
+  EXPECT_EQ((std::vector<std::string>{"id", "name"}), reader.ColumnNames());
+  csv::Batch batch;
+  size_t num_read = 0u;
+  while (reader.Next(batch)) {
+    EXPECT_EQ(num_read, batch.first_row);
+    num_read += batch.document->NumRows();
+  }
+  EXPECT_EQ(static_cast<size_t>(num_rows), num_read);
+
+  std::istringstream empty;
+  csv::StreamSource empty_source(empty, "empty");
+  EXPECT_THROW(csv::ReadCSV(empty_source, field_types), std::runtime_error);
+}
+
+#ifdef PCSV_WITH_ZLIB
+TEST(TestReadCSV, ReadCSVCompressed) {
+  constexpr int64_t num_rows = 50000;
+  std::ostringstream content;
+  content << "id,grade,name\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    content << row << ',' << row / 4.0 << ",\"n,\n" << row % 11 << "\"\n";
+  }
+  TempFileHandle file_handle;
+  gzFile file = gzopen(file_handle.file_name.c_str(), "wb");
+  ASSERT_NE(nullptr, file);
+  gzputs(file, content.str().c_str());
+  gzclose(file);
+
+  const std::vector<csv::FieldType> field_types{
+      csv::FieldType::INT64, csv::FieldType::DOUBLE, csv::FieldType::CATEGORY};
+  for (int mode = 0; mode < 3; ++mode) {
+    // a compressed file is never mapped
+    csv::ReadOptions options('"', ',', 4, mode == 1);
+    options.block_size = 64 * 1024;
+    options.pipelined = mode == 2;
+    const auto document = csv::ReadCSV(file_handle.file_name, field_types, options);
+    const auto ids = document.GetAsInt64("id");
+    const auto names = document.GetAsString("name");
+    ASSERT_EQ(static_cast<size_t>(num_rows), ids.size());
+    for (int64_t row = 0; row < num_rows; ++row) {
+      ASSERT_EQ(row, ids[row]);
+      ASSERT_EQ("\"n,\n" + std::to_string(row % 11) + '"', names[row]);
+    }
+  }
+
+  csv::ReadOptions options('"', ',', 4);
+  EXPECT_EQ((std::vector<csv::FieldType>{csv::FieldType::INT64, csv::FieldType::DOUBLE,
+                                         csv::FieldType::VARSTRING}),
+            csv::InferFieldTypes(file_handle.file_name, options));
+  const auto inferred = csv::ReadCSV(file_handle.file_name, options);
+  EXPECT_EQ(static_cast<size_t>(num_rows), inferred.NumRows());
+
+  // mixed with an uncompressed file
+  TempFileHandle plain_handle;
+  std::ofstream(plain_handle.file_name) << content.str();
+  const auto files = csv::ReadCSVFiles({file_handle.file_name, plain_handle.file_name},
+                                       field_types, options);
+  const auto ids = files.GetAsInt64("id");
+  ASSERT_EQ(static_cast<size_t>(2 * num_rows), ids.size());
+  EXPECT_EQ(num_rows - 1, ids[num_rows - 1]);
+  EXPECT_EQ(0, ids[num_rows]);
+}
+#endif
+
+#ifdef PCSV_WITH_ZSTD
+TEST(TestReadCSV, ReadCSVZstd) {
+  constexpr int64_t num_rows = 50000;
+  std::ostringstream header, records;
+  header << "id,name\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    records << row << ",\"n,\n" << row % 11 << "\"\n";
+  }
+  const auto content = header.str() + records.str();
+  // in two frames which tell their size, so they are decoded in parallel
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name, std::ios::binary);
+  const auto half = content.size() / 2;
+  for (const auto& frame : {content.substr(0u, half), content.substr(half)}) {
+    std::vector<char> compressed(ZSTD_compressBound(frame.size()));
+    const auto size = ZSTD_compress(compressed.data(), compressed.size(), frame.data(),
+                                    frame.size(), 1);
+    ASSERT_FALSE(ZSTD_isError(size));
+    ofs.write(compressed.data(), static_cast<std::streamsize>(size));
+  }
+  ofs.close();
+
+  const std::vector<csv::FieldType> field_types{csv::FieldType::INT64,
+                                                csv::FieldType::CATEGORY};
+  csv::ReadOptions options('"', ',', 4);
+  options.block_size = 64 * 1024;
+  const auto document = csv::ReadCSV(file_handle.file_name, field_types, options);
+  const auto ids = document.GetAsInt64("id");
+  ASSERT_EQ(static_cast<size_t>(num_rows), ids.size());
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ASSERT_EQ(row, ids[row]);
+  }
+  EXPECT_EQ(11u, document.Dictionary("name").Size());
+
+  // streamed between mapped files, in order
+  TempFileHandle plain_handle;
+  std::ofstream(plain_handle.file_name) << content;
+  options.filter = csv::Filter::Compare("id", csv::CompareOp::LT, int64_t{3});
+  const auto files = csv::ReadCSVFiles(
+      {plain_handle.file_name, file_handle.file_name, plain_handle.file_name},
+      field_types, options);
+  EXPECT_EQ((std::vector<int64_t>{0, 1, 2, 0, 1, 2, 0, 1, 2}), files.GetAsInt64("id"));
+
+  std::ofstream(plain_handle.file_name) << "id,other\n1,a\n";
+  EXPECT_THROW(csv::ReadCSVFiles({file_handle.file_name, plain_handle.file_name},
+                                 field_types, options),
+               std::runtime_error);
+}
+#endif
+
 }
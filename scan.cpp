@@ -0,0 +1,107 @@
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSV_SCAN_X86 1
+#endif
+
+namespace csv {
+
+void ScanBlockScalar(const char* block, char separator, char quotechar,
+                     StructuralMasks& masks) {
+  uint64_t separator_bits = 0u;
+  uint64_t quote_bits = 0u;
+  uint64_t newline_bits = 0u;
+  for (size_t idx = 0u; idx < kScanBlockSize; ++idx) {
+    const char current_char = block[idx];
+    separator_bits |= static_cast<uint64_t>(current_char == separator) << idx;
+    quote_bits |= static_cast<uint64_t>(current_char == quotechar) << idx;
+    newline_bits |= static_cast<uint64_t>(current_char == '\n') << idx;
+  }
+  masks.separator = separator_bits;
+  masks.quote = quote_bits;
+  masks.newline = newline_bits;
+}
+
+#ifdef CSV_SCAN_X86
+
+namespace {
+
+__attribute__((target("sse4.2"))) void ScanBlockSse42Impl(const char* block,
+                                                          char separator,
+                                                          char quotechar,
+                                                          StructuralMasks& masks) {
+  const __m128i separators = _mm_set1_epi8(separator);
+  const __m128i quotes = _mm_set1_epi8(quotechar);
+  const __m128i newlines = _mm_set1_epi8('\n');
+  uint64_t separator_bits = 0u;
+  uint64_t quote_bits = 0u;
+  uint64_t newline_bits = 0u;
+  for (size_t idx = 0u; idx < kScanBlockSize; idx += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + idx));
+    separator_bits |= static_cast<uint64_t>(static_cast<uint32_t>(
+                          _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, separators))))
+                      << idx;
+    quote_bits |= static_cast<uint64_t>(static_cast<uint32_t>(
+                      _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quotes))))
+                  << idx;
+    newline_bits |= static_cast<uint64_t>(static_cast<uint32_t>(
+                        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newlines))))
+                    << idx;
+  }
+  masks.separator = separator_bits;
+  masks.quote = quote_bits;
+  masks.newline = newline_bits;
+}
+
+__attribute__((target("avx2"))) inline uint64_t ToMask(__m256i low_eq, __m256i high_eq) {
+  return static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(low_eq))) |
+         (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high_eq)))
+          << 32);
+}
+
+__attribute__((target("avx2"))) void ScanBlockAvx2Impl(const char* block, char separator,
+                                                       char quotechar,
+                                                       StructuralMasks& masks) {
+  const __m256i separators = _mm256_set1_epi8(separator);
+  const __m256i quotes = _mm256_set1_epi8(quotechar);
+  const __m256i newlines = _mm256_set1_epi8('\n');
+  const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+  masks.separator =
+      ToMask(_mm256_cmpeq_epi8(low, separators), _mm256_cmpeq_epi8(high, separators));
+  masks.quote = ToMask(_mm256_cmpeq_epi8(low, quotes), _mm256_cmpeq_epi8(high, quotes));
+  masks.newline =
+      ToMask(_mm256_cmpeq_epi8(low, newlines), _mm256_cmpeq_epi8(high, newlines));
+}
+
+}  // namespace
+
+const ScanFunction ScanBlockSse42 = ScanBlockSse42Impl;
+const ScanFunction ScanBlockAvx2 = ScanBlockAvx2Impl;
+
+ScanFunction SelectScanner() {
+  static const ScanFunction scanner = []() -> ScanFunction {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return ScanBlockAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+      return ScanBlockSse42;
+    }
+    return ScanBlockScalar;
+  }();
+  return scanner;
+}
+
+#else
+
+const ScanFunction ScanBlockSse42 = nullptr;
+const ScanFunction ScanBlockAvx2 = nullptr;
+
+ScanFunction SelectScanner() { return ScanBlockScalar; }
+
+#endif
+
+}  // namespace csv
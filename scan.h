@@ -0,0 +1,50 @@
+#ifndef __SCAN_H__
+#define __SCAN_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace csv {
+
+// Every scanner looks at this many bytes at once and reports one bit per byte.
+constexpr size_t kScanBlockSize = 64;
+
+// StructuralMasks marks the structural characters of one block of kScanBlockSize
+// bytes: bit i is set when byte i of the block is that character.
+struct StructuralMasks {
+  uint64_t separator;
+  uint64_t quote;
+  uint64_t newline;
+};
+
+using ScanFunction = void (*)(const char* block, char separator, char quotechar,
+                              StructuralMasks& masks);
+
+void ScanBlockScalar(const char* block, char separator, char quotechar,
+                     StructuralMasks& masks);
+// ScanBlockSse42() and ScanBlockAvx2() must only be called when the running CPU
+// supports them. They are nullptr when the compiler can't target x86.
+extern const ScanFunction ScanBlockSse42;
+extern const ScanFunction ScanBlockAvx2;
+
+// SelectScanner() returns the fastest scanner the running CPU supports.
+ScanFunction SelectScanner();
+
+// PrefixXor() sets bit i of the result to the xor of bits [0, i] of bits.
+// Applied to a quote mask, it marks every byte between an opening quote
+// (inclusive) and its closing quote (exclusive).
+inline uint64_t PrefixXor(uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+inline int CountTrailingZeros(uint64_t bits) { return __builtin_ctzll(bits); }
+
+}  // namespace csv
+
+#endif
@@ -0,0 +1,113 @@
+// Compares the byte-at-a-time tokenizer loop with the bitmask scanners on the
+// pipe separated layout test_cli reads (560 columns, mostly INT64).
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "scan.h"
+#include "stop_watch.h"
+
+namespace {
+
+constexpr int kNumColumns = 560;
+constexpr int kStringColumn = 118;
+constexpr int kDoubleColumn = 546;
+
+std::string MakeContent(size_t num_rows) {
+  std::mt19937 random(7);
+  std::uniform_int_distribution<int64_t> value(0, 99999999);
+  std::string content;
+  for (size_t row = 0u; row < num_rows; ++row) {
+    for (int column = 0; column < kNumColumns; ++column) {
+      if (column != 0) {
+        content += '|';
+      }
+      if (column == kStringColumn) {
+        content += "\"code|" + std::to_string(value(random) % 100) + "\"";
+      } else if (column == kDoubleColumn) {
+        content += std::to_string(value(random)) + ".25";
+      } else {
+        content += std::to_string(value(random) % 100000);
+      }
+    }
+    content += '\n';
+  }
+  return content;
+}
+
+// the loop ParseOneChunk used to run for every byte
+size_t CountCellsScalar(const std::string& content, char separator, char quotechar) {
+  size_t num_cells = 0u;
+  bool quoted = false;
+  for (const char current_char : content) {
+    if (current_char == quotechar) {
+      quoted = !quoted;
+    } else if (!quoted && (current_char == separator || current_char == '\n')) {
+      num_cells++;
+    }
+  }
+  return num_cells;
+}
+
+size_t CountCellsMasks(const std::string& content, char separator, char quotechar,
+                       csv::ScanFunction scan) {
+  size_t num_cells = 0u;
+  uint64_t quoted_carry = 0u;
+  const char* const end = content.data() + content.size();
+  char tail[csv::kScanBlockSize];
+  for (const char* block = content.data(); block < end; block += csv::kScanBlockSize) {
+    const auto remaining = static_cast<size_t>(end - block);
+    const char* scanned = block;
+    if (remaining < csv::kScanBlockSize) {
+      std::memcpy(tail, block, remaining);
+      std::memset(tail + remaining, 0, csv::kScanBlockSize - remaining);
+      scanned = tail;
+    }
+    csv::StructuralMasks masks;
+    scan(scanned, separator, quotechar, masks);
+    const uint64_t quoted = csv::PrefixXor(masks.quote) ^ quoted_carry;
+    quoted_carry = static_cast<uint64_t>(static_cast<int64_t>(quoted) >> 63);
+    uint64_t structurals = (masks.separator | masks.newline) & ~quoted;
+    // consume the bits one by one the way the tokenizer does
+    while (structurals != 0u) {
+      num_cells++;
+      structurals &= structurals - 1u;
+    }
+  }
+  return num_cells;
+}
+
+void Run(const std::string& name, const std::string& content, csv::ScanFunction scan) {
+  constexpr int kRepeat = 5;
+  Stopwatch watch(name);
+  size_t num_cells = 0u;
+  watch.Start();
+  for (int repeat = 0; repeat < kRepeat; ++repeat) {
+    num_cells += scan == nullptr ? CountCellsScalar(content, '|', '"')
+                                 : CountCellsMasks(content, '|', '"', scan);
+  }
+  watch.End();
+  std::cout << "  cells: " << num_cells / kRepeat << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t num_rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000u;
+  const auto content = MakeContent(num_rows);
+  std::cout << "rows: " << num_rows << ", bytes: " << content.size() << '\n';
+
+  Run("scalar byte loop", content, nullptr);
+  Run("scalar masks", content, csv::ScanBlockScalar);
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    Run("sse4.2 masks", content, csv::ScanBlockSse42);
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    Run("avx2 masks", content, csv::ScanBlockAvx2);
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include "scan.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+namespace {
+
+void ExpectSameMasks(csv::ScanFunction scanner, const std::string& block) {
+  csv::StructuralMasks expected;
+  csv::StructuralMasks actual;
+  csv::ScanBlockScalar(block.data(), '|', '"', expected);
+  scanner(block.data(), '|', '"', actual);
+  EXPECT_EQ(expected.separator, actual.separator);
+  EXPECT_EQ(expected.quote, actual.quote);
+  EXPECT_EQ(expected.newline, actual.newline);
+}
+
+TEST(TestScan, ScalarMasks) {
+  const std::string block =
+      "1|\"a|b\"|3\n"
+      "01234567890123456789012345678901234567890123456789012|";
+  ASSERT_EQ(csv::kScanBlockSize, block.size());
+  csv::StructuralMasks masks;
+  csv::ScanBlockScalar(block.data(), '|', '"', masks);
+  EXPECT_EQ((uint64_t{1} << 1) | (uint64_t{1} << 4) | (uint64_t{1} << 7) |
+                (uint64_t{1} << 63),
+            masks.separator);
+  EXPECT_EQ((uint64_t{1} << 2) | (uint64_t{1} << 6), masks.quote);
+  EXPECT_EQ(uint64_t{1} << 9, masks.newline);
+}
+
+TEST(TestScan, PrefixXor) {
+  EXPECT_EQ(0u, csv::PrefixXor(0u));
+  // quotes at 2 and 6 mark [2, 6)
+  EXPECT_EQ(uint64_t{0x3c}, csv::PrefixXor((uint64_t{1} << 2) | (uint64_t{1} << 6)));
+  // an unclosed quote marks the rest of the block
+  EXPECT_EQ(~uint64_t{0} << 60, csv::PrefixXor(uint64_t{1} << 60));
+}
+
+TEST(TestScan, VectorScannersMatchScalar) {
+  std::mt19937 random(42);
+  const std::string alphabet = "0123456789|\"\n,ab";
+  std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+  for (int trial = 0; trial < 1000; ++trial) {
+    std::string block(csv::kScanBlockSize, ' ');
+    for (auto& current_char : block) {
+      current_char = alphabet[pick(random)];
+    }
+    ExpectSameMasks(csv::SelectScanner(), block);
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("sse4.2")) {
+      ExpectSameMasks(csv::ScanBlockSse42, block);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      ExpectSameMasks(csv::ScanBlockAvx2, block);
+    }
+#endif
+  }
+}
+
+}  // namespace
@@ -0,0 +1,120 @@
+#include "split.h"
+
+#include <algorithm>
+
+namespace csv {
+
+namespace {
+
+// ScanPiece() returns the piece owned by [range_begin, range_end).
+// The piece starts at the first record boundary at or after range_begin and ends at
+// the first record boundary at or after range_end. quoted is the quote state at
+// range_begin.
+Piece ScanPiece(const char* range_begin, const char* range_end, const char* begin,
+                const char* end, bool quoted, bool is_last, char quotechar) {
+  const char* cursor = range_begin;
+  const bool at_boundary =
+      cursor == begin || (!quoted && *(cursor - 1) == '\n');
+  if (!at_boundary) {
+    for (; cursor < end; ++cursor) {
+      const char current_char = *cursor;
+      if (current_char == quotechar) {
+        quoted = !quoted;
+      } else if (current_char == '\n' && !quoted) {
+        ++cursor;
+        break;
+      }
+    }
+  }
+
+  if (cursor >= range_end) {
+    // the next range owns the record starting at cursor
+    return Piece{cursor, cursor, 0u};
+  }
+
+  Piece piece{cursor, cursor, 0u};
+  const char* record_start = cursor;
+  quoted = false;
+  for (; cursor < end; ++cursor) {
+    const char current_char = *cursor;
+    if (current_char == quotechar) {
+      quoted = !quoted;
+    } else if (current_char == '\n' && !quoted) {
+      if (!IsEmptyRecord(record_start, cursor)) {
+        piece.num_rows++;
+      }
+      record_start = cursor + 1;
+      if (record_start >= range_end) {
+        break;
+      }
+    }
+  }
+
+  if (cursor < end || !is_last) {
+    piece.end = record_start;
+  } else {
+    if (!IsEmptyRecord(record_start, end)) {
+      piece.num_rows++;
+    }
+    piece.end = end;
+  }
+  return piece;
+}
+
+}  // namespace
+
+std::vector<Piece> SplitRecords(const char* begin, const char* end, bool is_last,
+                                size_t num_pieces, char quotechar, int num_threads,
+                                const char*& records_end, ThreadPool* thread_pool) {
+  records_end = begin;
+  std::vector<Piece> pieces;
+  if (begin >= end) {
+    return pieces;
+  }
+
+  const auto size = static_cast<size_t>(end - begin);
+  num_pieces = std::max(size_t{1u}, std::min(num_pieces, size));
+  const size_t range_size = (size + num_pieces - 1) / num_pieces;
+  std::vector<const char*> range_begins(num_pieces + 1);
+  for (size_t idx = 0u; idx <= num_pieces; ++idx) {
+    range_begins[idx] = begin + std::min(size, idx * range_size);
+  }
+
+  // quote parity of every range tells the quote state at the start of each range
+  auto& pool = thread_pool != nullptr ? *thread_pool : *DefaultThreadPool();
+  std::vector<char> quote_parities(num_pieces);
+  pool.ParallelFor(num_pieces, num_threads, [&](size_t idx) {
+    quote_parities[idx] = static_cast<char>(
+        std::count(range_begins[idx], range_begins[idx + 1], quotechar) & 1);
+  });
+
+  std::vector<char> quoted_at(num_pieces);
+  char quoted = 0;
+  for (size_t idx = 0u; idx < num_pieces; ++idx) {
+    quoted_at[idx] = quoted;
+    quoted ^= quote_parities[idx];
+  }
+
+  std::vector<Piece> scanned(num_pieces);
+  pool.ParallelFor(num_pieces, num_threads, [&](size_t idx) {
+    scanned[idx] = ScanPiece(range_begins[idx], range_begins[idx + 1], begin, end,
+                             quoted_at[idx] != 0, is_last, quotechar);
+  });
+
+  pieces.reserve(num_pieces);
+  for (const auto& piece : scanned) {
+    // a range without any boundary yields an empty piece which ends nowhere
+    if (piece.begin != piece.end) {
+      records_end = std::max(records_end, piece.end);
+    }
+    if (piece.num_rows > 0u) {
+      pieces.push_back(piece);
+    }
+  }
+  if (is_last) {
+    records_end = end;
+  }
+  return pieces;
+}
+
+}  // namespace csv
@@ -0,0 +1,40 @@
+#ifndef __SPLIT_H__
+#define __SPLIT_H__
+
+#include <cstddef>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace csv {
+
+// Piece is a byte range holding whole CSV records only, so it can be parsed
+// independently of every other piece.
+struct Piece {
+  const char* begin;
+  const char* end;
+  // number of non-empty records in [begin, end)
+  size_t num_rows;
+};
+
+// IsEmptyRecord() returns true for a record without any character other than a
+// trailing '\r'. Empty records are skipped by the reader.
+inline bool IsEmptyRecord(const char* begin, const char* end) {
+  return begin == end || (end - begin == 1 && *begin == '\r');
+}
+
+// SplitRecords() divides [begin, end) into at most num_pieces pieces using up to
+// num_threads threads of thread_pool, DefaultThreadPool() when null.
+// Every thread finds the first record boundary of its byte range on its own: quote
+// parity of the preceding ranges is counted in parallel first, so newlines inside
+// quoted cells are never taken as a boundary. begin must be a record boundary.
+// When is_last is false, bytes after the last newline are an incomplete record and
+// are left out; records_end is set to where the returned pieces end.
+std::vector<Piece> SplitRecords(const char* begin, const char* end, bool is_last,
+                                size_t num_pieces, char quotechar, int num_threads,
+                                const char*& records_end,
+                                ThreadPool* thread_pool = nullptr);
+
+}  // namespace csv
+
+#endif
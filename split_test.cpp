@@ -0,0 +1,98 @@
+#include "split.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace {
+
+using Piece = csv::Piece;
+
+size_t TotalRows(const std::vector<Piece>& pieces) {
+  size_t num_rows = 0u;
+  for (const auto& piece : pieces) {
+    num_rows += piece.num_rows;
+  }
+  return num_rows;
+}
+
+// pieces must cover [begin, records_end) without gaps or overlaps
+void ExpectContiguous(const std::vector<Piece>& pieces, const char* begin,
+                      const char* records_end) {
+  ASSERT_FALSE(pieces.empty());
+  EXPECT_EQ(begin, pieces.front().begin);
+  EXPECT_EQ(records_end, pieces.back().end);
+  for (size_t idx = 1u; idx < pieces.size(); ++idx) {
+    EXPECT_EQ(pieces[idx - 1].end, pieces[idx].begin);
+  }
+}
+
+TEST(TestSplitRecords, SplitsOnNewlines) {
+  const std::string content = "0,A,20\n1,B,19\n2,AB,9\n3,ABCD,24\n";
+  const char* begin = content.data();
+  const char* end = begin + content.size();
+  for (size_t num_pieces = 1u; num_pieces <= content.size(); ++num_pieces) {
+    const char* records_end = nullptr;
+    auto pieces = csv::SplitRecords(begin, end, true, num_pieces, '"', 4, records_end);
+    EXPECT_EQ(end, records_end);
+    EXPECT_EQ(4u, TotalRows(pieces));
+    EXPECT_LE(pieces.size(), num_pieces);
+    ExpectContiguous(pieces, begin, records_end);
+  }
+}
+
+TEST(TestSplitRecords, QuotedNewlineIsNotBoundary) {
+  const std::string content = "0,\"A\nB\nC\",20\n1,\"\n\",19\n2,AB,9\n";
+  const char* begin = content.data();
+  const char* end = begin + content.size();
+  for (size_t num_pieces = 1u; num_pieces <= content.size(); ++num_pieces) {
+    const char* records_end = nullptr;
+    auto pieces = csv::SplitRecords(begin, end, true, num_pieces, '"', 4, records_end);
+    EXPECT_EQ(3u, TotalRows(pieces));
+    ExpectContiguous(pieces, begin, records_end);
+    for (const auto& piece : pieces) {
+      // every piece starts a record
+      EXPECT_TRUE(piece.begin == begin || *(piece.begin - 1) == '\n');
+      EXPECT_NE('\n', *piece.begin);
+    }
+  }
+}
+
+TEST(TestSplitRecords, SkipsEmptyRecords) {
+  const std::string content = "\n0,A\n\n\r\n1,B\r\n\n";
+  const char* begin = content.data();
+  const char* end = begin + content.size();
+  for (size_t num_pieces = 1u; num_pieces <= content.size(); ++num_pieces) {
+    const char* records_end = nullptr;
+    auto pieces = csv::SplitRecords(begin, end, true, num_pieces, '"', 4, records_end);
+    EXPECT_EQ(2u, TotalRows(pieces));
+  }
+}
+
+TEST(TestSplitRecords, LeavesIncompleteRecord) {
+  const std::string content = "0,A\n1,B\n2,\"partial\nrecord";
+  const char* begin = content.data();
+  const char* end = begin + content.size();
+  for (size_t num_pieces = 1u; num_pieces <= content.size(); ++num_pieces) {
+    const char* records_end = nullptr;
+    auto pieces = csv::SplitRecords(begin, end, false, num_pieces, '"', 4, records_end);
+    EXPECT_EQ(2u, TotalRows(pieces));
+    EXPECT_EQ(begin + 8, records_end);
+    ExpectContiguous(pieces, begin, records_end);
+
+    pieces = csv::SplitRecords(begin, end, true, num_pieces, '"', 4, records_end);
+    EXPECT_EQ(3u, TotalRows(pieces));
+    EXPECT_EQ(end, records_end);
+  }
+}
+
+TEST(TestSplitRecords, Empty) {
+  const std::string content;
+  const char* records_end = nullptr;
+  auto pieces = csv::SplitRecords(content.data(), content.data(), true, 4, '"', 4,
+                                  records_end);
+  EXPECT_TRUE(pieces.empty());
+  EXPECT_EQ(content.data(), records_end);
+}
+
+}  // namespace
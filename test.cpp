@@ -2,6 +2,7 @@
 #include <stdexcept>
 #include <vector>
 
+#include "infer.h"
 #include "read.h"
 #include "stop_watch.h"
 
@@ -30,6 +31,9 @@ std::vector<csv::FieldType> ParseFieldType(const std::string& field_type_string)
   const std::string int_str("INT64");
   const std::string double_str("DOUBLE");
   const std::string string_str("STRING");
+  const std::string varstring_str("VARSTRING");
+  const std::string category_str("CATEGORY");
+  const std::string skip_str("SKIP");
   for (const auto& field_name : field_names) {
     if (field_name == int_str) {
       types.push_back(csv::FieldType::INT64);
@@ -37,6 +41,12 @@ std::vector<csv::FieldType> ParseFieldType(const std::string& field_type_string)
       types.push_back(csv::FieldType::DOUBLE);
     } else if (field_name == string_str) {
       types.push_back(csv::FieldType::STRING);
+    } else if (field_name == varstring_str) {
+      types.push_back(csv::FieldType::VARSTRING);
+    } else if (field_name == category_str) {
+      types.push_back(csv::FieldType::CATEGORY);
+    } else if (field_name == skip_str) {
+      types.push_back(csv::FieldType::SKIP);
     } else {
       throw std::runtime_error(std::string("input type string has wrong token ") +
                                field_name);
@@ -47,100 +57,67 @@ std::vector<csv::FieldType> ParseFieldType(const std::string& field_type_string)
 }
 
 int main(int argc, char** argv) {
-  if (argc != 2) {
-    std::cout << "must csv pat and field types be given.";
+  if (argc != 2 && argc != 3) {
+    std::cout << "usage: test_cli <csv path> [comma separated field types]\n"
+                 "field types are inferred from the file when not given.";
     return -1;
   }
 
   const std::string file_name = argv[1];
-  const std::string field_type_string =       "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,STRING,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,INT64,DOUBLE,INT64,INT64,INT64,"
-      "INT64,INT64,INT64,INT64,INT64,INT64";
-
-  const auto field_types = ParseFieldType(field_type_string);
+  const csv::ReadOptions options{'"', '|', 16};
+  const auto field_types = argc == 3 ? ParseFieldType(argv[2])
+                                     : csv::InferFieldTypes(file_name, options);
 
   Stopwatch watch("read");
   watch.Start();
-  auto document = csv::ReadCSV(file_name, field_types, csv::ReadOptions{'"', '|', 16});
+  auto document = csv::ReadCSV(file_name, field_types, options);
   watch.End();
 
   watch.message = "read_columns";
 
-  std::vector<int64_t> int_vector;
-  std::vector<double> double_vector;
-  std::vector<std::string> string_vector;
+  // columns are extracted a group at a time, each pass reusing the outputs of the
+  // last one, so at most kColumnsPerGroup columns of a type are held at once
+  constexpr size_t kColumnsPerGroup = 8u;
+  std::vector<std::vector<int64_t>> int_vectors(kColumnsPerGroup);
+  std::vector<std::vector<double>> double_vectors(kColumnsPerGroup);
+  std::vector<std::vector<std::string>> string_vectors(kColumnsPerGroup);
 
   watch.Start();
   document.SetNumThreads(16);
   auto field_names = document.FieldNames();
   auto field_name_itr = std::begin(field_names);
-  auto field_type_itr = std::begin(field_types);
-  const auto field_type_end = std::end(field_types);
-  for (; field_type_itr != field_type_end; ++field_name_itr, ++field_type_itr) {
-    switch (*field_type_itr) {
-    case csv::FieldType::INT64:
-      if (int_vector.empty()) {
-        int_vector = document.GetAsInt64(*field_name_itr);
-      } else {
-        document.GetAsInt64(*field_name_itr, int_vector);
-      }
-      break;
-    case csv::FieldType::DOUBLE:
-      if (double_vector.empty()) {
-        double_vector = document.GetAsDouble(*field_name_itr);
-      } else {
-        document.GetAsDouble(*field_name_itr, double_vector);
+  size_t idx = 0u;
+  while (idx < field_types.size()) {
+    csv::ColumnBatch batch;
+    size_t num_ints = 0u;
+    size_t num_doubles = 0u;
+    size_t num_strings = 0u;
+    for (; idx < field_types.size() && num_ints < kColumnsPerGroup &&
+           num_doubles < kColumnsPerGroup && num_strings < kColumnsPerGroup;
+         ++idx) {
+      // SKIP columns are not in the document
+      if (field_types[idx] == csv::FieldType::SKIP) {
+        continue;
       }
-      break;
+      switch (field_types[idx]) {
+      case csv::FieldType::INT64:
+        batch.AddInt64(*field_name_itr, int_vectors[num_ints++]);
+        break;
+      case csv::FieldType::DOUBLE:
+        batch.AddDouble(*field_name_itr, double_vectors[num_doubles++]);
+        break;
 
-    case csv::FieldType::STRING:
-      if (string_vector.empty()) {
-        string_vector = document.GetAsString(*field_name_itr);
-      } else {
-        document.GetAsString(*field_name_itr, string_vector);
+      case csv::FieldType::STRING:
+      case csv::FieldType::VARSTRING:
+      case csv::FieldType::CATEGORY:
+        batch.AddString(*field_name_itr, string_vectors[num_strings++]);
+        break;
+      default:
+        break;
       }
-      break;
-    default:
-      break;
+      ++field_name_itr;
     }
+    document.GetColumns(batch);
   }
   watch.End();
 
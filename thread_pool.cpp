@@ -0,0 +1,192 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace csv {
+
+namespace {
+
+// the pool whose loop a thread runs, set on the pool's threads and on a caller
+// while it runs its loop
+thread_local const ThreadPool* loop_pool = nullptr;
+
+// Range holds the indices a thread of a loop has yet to run
+struct Range {
+  std::mutex mutex;
+  size_t begin;
+  size_t end;
+};
+
+}  // namespace
+
+struct ThreadPool::Loop {
+  Loop(size_t size, size_t num_slots, const std::function<void(size_t)>& body)
+      : body(body),
+        ranges(new Range[num_slots]),
+        num_slots(num_slots),
+        num_unclaimed(size),
+        next_slot(1u),
+        num_workers(0),
+        failed(false) {
+    for (size_t slot = 0u; slot < num_slots; ++slot) {
+      ranges[slot].begin = size * slot / num_slots;
+      ranges[slot].end = size * (slot + 1u) / num_slots;
+    }
+  }
+
+  // Take() sets idx to the next index of slot, stolen from another slot if needed.
+  // Returns false once every index was taken.
+  bool Take(size_t slot, size_t& idx) {
+    if (failed) {
+      return false;
+    }
+    auto& own = ranges[slot];
+    {
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (own.begin < own.end) {
+        idx = own.begin++;
+        --num_unclaimed;
+        return true;
+      }
+    }
+    for (size_t offset = 1u; offset < num_slots; ++offset) {
+      auto& victim = ranges[(slot + offset) % num_slots];
+      size_t begin = 0u;
+      size_t end = 0u;
+      {
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.begin == victim.end) {
+          continue;
+        }
+        // the back half, which its owner would run last
+        end = victim.end;
+        begin = end - (end - victim.begin + 1u) / 2u;
+        victim.end = begin;
+      }
+      idx = begin;
+      --num_unclaimed;
+      std::lock_guard<std::mutex> lock(own.mutex);
+      own.begin = begin + 1u;
+      own.end = end;
+      return true;
+    }
+    return false;
+  }
+
+  const std::function<void(size_t)>& body;
+  std::unique_ptr<Range[]> ranges;
+  const size_t num_slots;
+  std::atomic<size_t> num_unclaimed;
+  // guarded by the pool's mutex
+  size_t next_slot;
+  int num_workers;
+
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  // set with error, so that no more indices are taken
+  std::atomic<bool> failed;
+};
+
+ThreadPool::ThreadPool(int num_threads) : stop_(false) {
+  for (int thread = 1; thread < num_threads; ++thread) {
+    workers_.emplace_back(&ThreadPool::Run, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t size, int max_threads,
+                             const std::function<void(size_t)>& body) {
+  auto num_threads = static_cast<size_t>(NumThreads());
+  if (max_threads > 0) {
+    num_threads = std::min(num_threads, static_cast<size_t>(max_threads));
+  }
+  num_threads = std::min(num_threads, size);
+  if (num_threads <= 1u || loop_pool == this) {
+    for (size_t idx = 0u; idx < size; ++idx) {
+      body(idx);
+    }
+    return;
+  }
+
+  Loop loop(size, num_threads, body);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loops_.push_back(&loop);
+  }
+  work_cv_.notify_all();
+  Work(loop, 0u);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    loops_.remove(&loop);
+    done_cv_.wait(lock, [&loop] { return loop.num_workers == 0; });
+  }
+  if (loop.error) {
+    std::rethrow_exception(loop.error);
+  }
+}
+
+void ThreadPool::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    Loop* loop = nullptr;
+    work_cv_.wait(lock, [this, &loop] {
+      for (const auto candidate : loops_) {
+        if (candidate->next_slot < candidate->num_slots &&
+            candidate->num_unclaimed > 0u && !candidate->failed) {
+          loop = candidate;
+          return true;
+        }
+      }
+      return stop_;
+    });
+    if (loop == nullptr) {
+      return;
+    }
+    const auto slot = loop->next_slot++;
+    ++loop->num_workers;
+    lock.unlock();
+    Work(*loop, slot);
+    lock.lock();
+    if (--loop->num_workers == 0) {
+      done_cv_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::Work(Loop& loop, size_t slot) {
+  const auto outer_pool = loop_pool;
+  loop_pool = this;
+  size_t idx = 0u;
+  while (loop.Take(slot, idx)) {
+    try {
+      loop.body(idx);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(loop.error_mutex);
+      if (!loop.error) {
+        loop.error = std::current_exception();
+        loop.failed = true;
+      }
+    }
+  }
+  loop_pool = outer_pool;
+}
+
+std::shared_ptr<ThreadPool> DefaultThreadPool() {
+  static const std::shared_ptr<ThreadPool> thread_pool(new ThreadPool(
+      static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))));
+  return thread_pool;
+}
+
+}  // namespace csv
@@ -0,0 +1,63 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace csv {
+
+// ThreadPool runs parallel loops on threads which are started once and kept for
+// every loop, so that a loop costs a wake up rather than starting threads.
+// The indices of a loop are dealt evenly to its threads, the caller being one of
+// them; a thread out of indices steals half of what another has left, so uneven
+// tasks balance out. Loops started from several threads at once share the pool's
+// threads instead of adding their own, and a loop started from inside a loop of the
+// same pool runs on the calling thread alone, while one of another pool runs on
+// that pool's threads too. Thread safe.
+class ThreadPool {
+public:
+  // a pool of num_threads threads runs num_threads - 1 of them besides the caller
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int NumThreads() const { return static_cast<int>(workers_.size()) + 1; }
+
+  // ParallelFor() calls body(idx) for every idx in [0, size) on up to max_threads
+  // threads (all of the pool's when not positive), the calling thread included, and
+  // returns once every call did. Once a call throws no more calls start, and its
+  // exception is rethrown after the running ones returned.
+  void ParallelFor(size_t size, int max_threads, const std::function<void(size_t)>& body);
+
+private:
+  struct Loop;
+
+  void Run();
+  // Work() runs indices of loop as the thread of slot until none is left
+  void Work(Loop& loop, size_t slot);
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  // workers wait for a loop, callers for the workers in their loop to leave it
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  // loops with slots for more threads
+  std::list<Loop*> loops_;
+  bool stop_;
+};
+
+// DefaultThreadPool() returns the pool of the library, of one thread per core,
+// started on first use.
+std::shared_ptr<ThreadPool> DefaultThreadPool();
+
+}  // namespace csv
+
+#endif
@@ -0,0 +1,181 @@
+#include "thread_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ThreadPool = csv::ThreadPool;
+
+TEST(TestThreadPool, ParallelFor) {
+  ThreadPool thread_pool(4);
+  EXPECT_EQ(4, thread_pool.NumThreads());
+  for (size_t size : {0u, 1u, 3u, 4u, 1000u}) {
+    std::vector<std::atomic<int>> calls(size);
+    for (auto& count : calls) {
+      count = 0;
+    }
+    thread_pool.ParallelFor(size, 0, [&calls](size_t idx) { ++calls[idx]; });
+    for (const auto& count : calls) {
+      EXPECT_EQ(1, count);
+    }
+  }
+}
+
+TEST(TestThreadPool, MaxThreads) {
+  ThreadPool thread_pool(4);
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  thread_pool.ParallelFor(100u, 1, [&](size_t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.insert(std::this_thread::get_id());
+  });
+  ASSERT_EQ(1u, threads.size());
+  EXPECT_EQ(std::this_thread::get_id(), *threads.begin());
+
+  // a pool of one thread runs loops on the caller
+  ThreadPool single(1);
+  EXPECT_EQ(1, single.NumThreads());
+  threads.clear();
+  single.ParallelFor(100u, 0, [&](size_t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.insert(std::this_thread::get_id());
+  });
+  EXPECT_EQ(1u, threads.size());
+}
+
+TEST(TestThreadPool, Steals) {
+  ThreadPool thread_pool(4);
+  // the first call blocks until every other one ran, which the other threads only
+  // can by stealing what is left of the blocked thread's range
+  std::atomic<size_t> num_done(0u);
+  constexpr size_t size = 400u;
+  thread_pool.ParallelFor(size, 0, [&num_done](size_t idx) {
+    if (idx == 0u) {
+      while (num_done < size - 1u) {
+        std::this_thread::yield();
+      }
+    }
+    ++num_done;
+  });
+  EXPECT_EQ(size, num_done);
+}
+
+TEST(TestThreadPool, Exception) {
+  ThreadPool thread_pool(4);
+  std::atomic<size_t> num_calls(0u);
+  EXPECT_THROW(thread_pool.ParallelFor(100u, 0,
+                                       [&num_calls](size_t idx) {
+                                         ++num_calls;
+                                         if (idx % 10u == 3u) {
+                                           throw std::runtime_error("failed");
+                                         }
+                                       }),
+               std::runtime_error);
+  // no call starts once one threw, and the pool is usable after
+  EXPECT_LT(num_calls, 100u);
+  num_calls = 0u;
+  EXPECT_THROW(thread_pool.ParallelFor(100u, 0,
+                                       [&num_calls](size_t) {
+                                         ++num_calls;
+                                         throw std::runtime_error("failed");
+                                       }),
+               std::runtime_error);
+  EXPECT_LE(num_calls, 4u);
+  num_calls = 0u;
+  thread_pool.ParallelFor(100u, 0, [&num_calls](size_t) { ++num_calls; });
+  EXPECT_EQ(100u, num_calls);
+
+  ThreadPool single(1);
+  num_calls = 0u;
+  EXPECT_THROW(single.ParallelFor(10u, 0,
+                                  [&num_calls](size_t) {
+                                    ++num_calls;
+                                    throw std::out_of_range("x");
+                                  }),
+               std::out_of_range);
+  EXPECT_EQ(1u, num_calls);
+}
+
+TEST(TestThreadPool, Nested) {
+  ThreadPool thread_pool(4);
+  std::vector<std::atomic<int>> calls(20u * 30u);
+  for (auto& count : calls) {
+    count = 0;
+  }
+  thread_pool.ParallelFor(20u, 0, [&](size_t outer) {
+    const auto thread = std::this_thread::get_id();
+    // runs on the thread of the outer call
+    thread_pool.ParallelFor(30u, 0, [&](size_t inner) {
+      EXPECT_EQ(thread, std::this_thread::get_id());
+      ++calls[outer * 30u + inner];
+    });
+  });
+  for (const auto& count : calls) {
+    EXPECT_EQ(1, count);
+  }
+}
+
+TEST(TestThreadPool, NestedOtherPool) {
+  ThreadPool outer_pool(2);
+  ThreadPool inner_pool(4);
+  outer_pool.ParallelFor(2u, 0, [&inner_pool](size_t) {
+    // a loop of another pool runs on its threads too: the first call waits for the
+    // others, which the calling thread alone couldn't run
+    constexpr size_t size = 100u;
+    std::atomic<size_t> num_done(0u);
+    size_t num_done_before_first = 0u;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    inner_pool.ParallelFor(size, 0, [&](size_t idx) {
+      if (idx == 0u) {
+        while (num_done < size - 1u && std::chrono::steady_clock::now() < deadline) {
+          std::this_thread::yield();
+        }
+        num_done_before_first = num_done;
+      }
+      ++num_done;
+    });
+    EXPECT_EQ(size - 1u, num_done_before_first);
+  });
+}
+
+TEST(TestThreadPool, ConcurrentCallers) {
+  ThreadPool thread_pool(3);
+  constexpr size_t num_callers = 6u;
+  constexpr size_t size = 2000u;
+  std::vector<std::atomic<size_t>> sums(num_callers);
+  for (auto& sum : sums) {
+    sum = 0u;
+  }
+  std::vector<std::thread> callers;
+  for (size_t caller = 0u; caller < num_callers; ++caller) {
+    callers.emplace_back([&thread_pool, &sums, caller] {
+      for (int round = 0; round < 5; ++round) {
+        thread_pool.ParallelFor(size, 0,
+                                [&sums, caller](size_t idx) { sums[caller] += idx; });
+      }
+    });
+  }
+  for (auto& caller : callers) {
+    caller.join();
+  }
+  for (const auto& sum : sums) {
+    EXPECT_EQ(5u * size * (size - 1u) / 2u, sum);
+  }
+}
+
+TEST(TestThreadPool, DefaultThreadPool) {
+  const auto thread_pool = csv::DefaultThreadPool();
+  ASSERT_NE(nullptr, thread_pool);
+  EXPECT_EQ(thread_pool, csv::DefaultThreadPool());
+  EXPECT_GE(thread_pool->NumThreads(), 1);
+}
+
+}  // anonymous namespace
@@ -0,0 +1,145 @@
+#ifndef __VIEW_H__
+#define __VIEW_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include "arena.h"
+#include "base.h"
+#include "chunk.h"
+
+namespace csv {
+
+// ViewTypeHelper maps the element type of a view to the column type it reads.
+template <typename T>
+struct ViewTypeHelper;
+
+template <>
+struct ViewTypeHelper<int64_t> {
+  static bool Matches(FieldType type) { return type == FieldType::INT64; }
+};
+
+// codes of a CATEGORY column
+template <>
+struct ViewTypeHelper<int32_t> {
+  static bool Matches(FieldType type) { return type == FieldType::CATEGORY; }
+};
+
+template <>
+struct ViewTypeHelper<double> {
+  static bool Matches(FieldType type) { return type == FieldType::DOUBLE; }
+};
+
+template <>
+struct ViewTypeHelper<StringRef> {
+  static bool Matches(FieldType type) {
+    return type == FieldType::STRING || type == FieldType::VARSTRING;
+  }
+};
+
+// ColumnView is a read-only view of one column in one chunk of a Document.
+// Nothing is copied: cells are read straight from the chunk, which must outlive the
+// view. T is one of int64_t, double, StringRef and int32_t (CATEGORY codes).
+template <typename T>
+class ColumnView {
+public:
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = ptrdiff_t;
+    using pointer = const T*;
+    using reference = T;
+
+    Iterator(const ColumnView* view, size_t idx) : view_(view), idx_(idx) {}
+    T operator*() const { return (*view_)[idx_]; }
+    Iterator& operator++() {
+      ++idx_;
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator current = *this;
+      ++idx_;
+      return current;
+    }
+    bool operator==(const Iterator& other) const { return idx_ == other.idx_; }
+    bool operator!=(const Iterator& other) const { return idx_ != other.idx_; }
+
+  private:
+    const ColumnView* view_;
+    size_t idx_;
+  };
+
+  ColumnView()
+      : chunk_(nullptr),
+        first_offset_(0u),
+        size_(0u),
+        stride_(0u),
+        arena_(nullptr),
+        validity_(nullptr) {}
+  // arena is given for VARSTRING columns only. validity is a bitmap of size bits,
+  // every cell is valid without one.
+  ColumnView(const MemoryChunk* chunk, size_t first_offset, size_t size, size_t stride,
+             const StringArena* arena = nullptr, const uint64_t* validity = nullptr)
+      : chunk_(chunk),
+        first_offset_(first_offset),
+        size_(size),
+        stride_(stride),
+        arena_(arena),
+        validity_(validity) {}
+
+  size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0u; }
+  // IsValid() is false for a cell which was empty in the CSV file (a null). Such
+  // cells read as 0 or as an empty string.
+  bool IsValid(size_t idx) const {
+    return validity_ == nullptr || ((validity_[idx / 64] >> (idx % 64)) & 1u) != 0u;
+  }
+  // Validity() returns the validity bitmap, bit idx % 64 of word idx / 64 for cell
+  // idx (the bit order of Arrow), or nullptr when every cell is valid
+  const uint64_t* Validity() const { return validity_; }
+  T operator[](size_t idx) const {
+    return chunk_->Read<T>(static_cast<int>(first_offset_ + idx * stride_));
+  }
+
+  // Contiguous() is true when cells are packed back to back (Layout::COLUMN), in
+  // which case Data() is the column as a plain array.
+  bool Contiguous() const { return stride_ == sizeof(T); }
+  const T* Data() const {
+    return Contiguous() ? reinterpret_cast<const T*>(
+                              chunk_->ReadCharPtr(static_cast<int>(first_offset_)))
+                        : nullptr;
+  }
+
+  Iterator begin() const { return Iterator(this, 0u); }
+  Iterator end() const { return Iterator(this, size_); }
+
+private:
+  const MemoryChunk* chunk_;
+  size_t first_offset_;
+  size_t size_;
+  size_t stride_;
+  const StringArena* arena_;
+  const uint64_t* validity_;
+};
+
+template <>
+inline StringRef ColumnView<StringRef>::operator[](size_t idx) const {
+  const auto offset = static_cast<int>(first_offset_ + idx * stride_);
+  if (arena_ != nullptr) {
+    const auto slot = chunk_->ReadStringSlot(offset);
+    return StringRef{arena_->Data(slot.offset), slot.size};
+  }
+  return chunk_->ReadStringRef(offset);
+}
+
+// StringRef cells are never packed back to back
+template <>
+inline bool ColumnView<StringRef>::Contiguous() const {
+  return false;
+}
+
+}  // namespace csv
+
+#endif
@@ -0,0 +1,197 @@
+#include "write.h"
+
+#include "number.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace csv {
+
+namespace {
+
+// rows formatted into one buffer
+constexpr size_t kRowsPerSlice = 8192u;
+// slices formatted per thread before the buffers are written
+constexpr size_t kSlicesPerThread = 4u;
+
+// AppendString() appends a string cell, quoted if it needs to be
+void AppendString(const char* str, size_t size, const ReadOptions& options,
+                  std::string& out) {
+  const char quotechar = options.quotechar;
+  const bool quoted = size >= 2u && str[0] == quotechar && str[size - 1] == quotechar;
+  bool needs_quotes = false;
+  for (size_t idx = 0u; idx < size && !quoted && !needs_quotes; ++idx) {
+    needs_quotes = str[idx] == options.separator || str[idx] == quotechar ||
+                   str[idx] == '\n' || str[idx] == '\r';
+  }
+  if (!needs_quotes) {
+    out.append(str, size);
+    return;
+  }
+  out += quotechar;
+  for (size_t idx = 0u; idx < size; ++idx) {
+    if (str[idx] == quotechar) {
+      out += quotechar;
+    }
+    out += str[idx];
+  }
+  out += quotechar;
+}
+
+// RowFormatter formats rows of one chunk of a Document
+class RowFormatter {
+public:
+  RowFormatter(const Document& doc, size_t chunk_index, const ReadOptions& options)
+      : options_(options) {
+    columns_.resize(doc.FieldNames().size());
+    for (size_t column_index = 0u; column_index < columns_.size(); ++column_index) {
+      auto& column = columns_[column_index];
+      column.type = doc.ColumnType(column_index);
+      switch (column.type) {
+      case FieldType::INT64:
+        column.ints = doc.GetColumnView<int64_t>(column_index, chunk_index);
+        break;
+      case FieldType::DOUBLE:
+        column.doubles = doc.GetColumnView<double>(column_index, chunk_index);
+        break;
+      case FieldType::STRING:
+      case FieldType::VARSTRING:
+        column.strings = doc.GetColumnView<StringRef>(column_index, chunk_index);
+        break;
+      case FieldType::CATEGORY:
+        column.codes = doc.GetColumnView<int32_t>(column_index, chunk_index);
+        column.dictionary = &doc.Dictionary(doc.FieldNames()[column_index]);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  // Format() appends rows [begin_row, end_row) to out
+  void Format(size_t begin_row, size_t end_row, std::string& out) const {
+    char number[kMaxDoubleLength];
+    for (size_t row = begin_row; row < end_row; ++row) {
+      for (size_t column_index = 0u; column_index < columns_.size(); ++column_index) {
+        if (column_index != 0u) {
+          out += options_.separator;
+        }
+        const auto& column = columns_[column_index];
+        switch (column.type) {
+        case FieldType::INT64:
+          if (column.ints.IsValid(row)) {
+            out.append(number, FormatInt64(column.ints[row], number));
+          }
+          break;
+        case FieldType::DOUBLE:
+          if (column.doubles.IsValid(row)) {
+            out.append(number, FormatDouble(column.doubles[row], number));
+          }
+          break;
+        case FieldType::STRING:
+        case FieldType::VARSTRING: {
+          const auto str = column.strings[row];
+          AppendString(str.data, str.size, options_, out);
+          break;
+        }
+        case FieldType::CATEGORY:
+          if (column.codes.IsValid(row)) {
+            const auto str = column.dictionary->Get(column.codes[row]);
+            AppendString(str.data, str.size, options_, out);
+          }
+          break;
+        default:
+          break;
+        }
+      }
+      out += '\n';
+    }
+  }
+
+private:
+  // only the view of the column's type is set
+  struct Column {
+    FieldType type;
+    ColumnView<int64_t> ints;
+    ColumnView<double> doubles;
+    ColumnView<StringRef> strings;
+    ColumnView<int32_t> codes;
+    const CategoryDictionary* dictionary;
+  };
+
+  const ReadOptions& options_;
+  std::vector<Column> columns_;
+};
+
+struct Slice {
+  size_t chunk_index;
+  size_t begin_row;
+  size_t end_row;
+};
+
+}  // namespace
+
+void WriteCSV(const Document& doc, std::ostream& os, ReadOptions options) {
+  std::string header;
+  const auto& field_names = doc.FieldNames();
+  for (size_t column_index = 0u; column_index < field_names.size(); ++column_index) {
+    if (column_index != 0u) {
+      header += options.separator;
+    }
+    AppendString(field_names[column_index].data(), field_names[column_index].size(),
+                 options, header);
+  }
+  header += '\n';
+  os.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+  std::vector<RowFormatter> formatters;
+  std::vector<Slice> slices;
+  for (size_t chunk_index = 0u; chunk_index < doc.NumChunks(); ++chunk_index) {
+    formatters.emplace_back(doc, chunk_index, options);
+    const auto num_rows = doc.NumRowsInChunk(chunk_index);
+    for (size_t begin_row = 0u; begin_row < num_rows; begin_row += kRowsPerSlice) {
+      slices.push_back(
+          Slice{chunk_index, begin_row, std::min(begin_row + kRowsPerSlice, num_rows)});
+    }
+  }
+
+  // buffers keep their memory from one round of slices to the next
+  const size_t round_size =
+      static_cast<size_t>(std::max(options.num_threads, 1)) * kSlicesPerThread;
+  std::vector<std::string> buffers(std::min(round_size, slices.size()));
+  for (size_t round_begin = 0u; round_begin < slices.size(); round_begin += round_size) {
+    const size_t round_end = std::min(round_begin + round_size, slices.size());
+    options.Pool().ParallelFor(round_end - round_begin, options.num_threads,
+                               [&](size_t idx) {
+                                 const auto& slice = slices[round_begin + idx];
+                                 auto& buffer = buffers[idx];
+                                 buffer.clear();
+                                 formatters[slice.chunk_index].Format(
+                                     slice.begin_row, slice.end_row, buffer);
+                               });
+
+    for (size_t idx = round_begin; idx < round_end; ++idx) {
+      const auto& buffer = buffers[idx - round_begin];
+      os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+  }
+  if (!os) {
+    throw std::runtime_error("Failed to write CSV");
+  }
+}
+
+void WriteCSV(const Document& doc, const std::string& path, ReadOptions options) {
+  std::ofstream file_out(path, std::ios::binary | std::ios::trunc);
+  if (!file_out) {
+    throw std::runtime_error(std::string("Failed to open ") + path);
+  }
+  WriteCSV(doc, file_out, options);
+  file_out.close();
+  if (!file_out) {
+    throw std::runtime_error(std::string("Failed to write ") + path);
+  }
+}
+
+}  // namespace csv
@@ -0,0 +1,25 @@
+#ifndef __WRITE_H__
+#define __WRITE_H__
+
+#include <ostream>
+#include <string>
+
+#include "document.h"
+#include "read.h"
+
+namespace csv {
+
+// WriteCSV() writes doc as CSV: a header of its column names, then a line per row.
+// Rows are formatted in parallel on options.num_threads threads, a slice of rows per
+// buffer, and the buffers are written in order. Cells are separated by
+// options.separator. A string cell holding the separator, options.quotechar or a
+// newline is quoted with options.quotechar, unless it already is (cells keep the
+// quotes they were read with). Numbers are written with FormatInt64() and
+// FormatDouble(), so they read back exactly. Nulls are written as empty cells.
+void WriteCSV(const Document& doc, std::ostream& os, ReadOptions options = ReadOptions());
+void WriteCSV(const Document& doc, const std::string& path,
+              ReadOptions options = ReadOptions());
+
+}  // namespace csv
+
+#endif
@@ -0,0 +1,73 @@
+// Compares Document::Dump(), which formats every cell through std::ostream on one
+// thread, with WriteCSV().
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "stop_watch.h"
+#include "write.h"
+
+namespace {
+
+constexpr int kNumIntColumns = 6;
+constexpr size_t kRowsPerChunk = 1000000u;
+
+csv::Document MakeDocument(size_t num_rows) {
+  std::vector<std::string> field_names;
+  std::vector<csv::FieldType> field_types(kNumIntColumns, csv::FieldType::INT64);
+  for (int column = 0; column < kNumIntColumns; ++column) {
+    field_names.push_back(std::string("i") + std::to_string(column));
+  }
+  field_names.push_back("d");
+  field_types.push_back(csv::FieldType::DOUBLE);
+  field_names.push_back("s");
+  field_types.push_back(csv::FieldType::STRING);
+
+  std::mt19937 random(13);
+  std::uniform_int_distribution<int64_t> value(0, 99999999);
+  csv::Document doc(field_names, field_types);
+  for (size_t row = 0u; row < num_rows; ++row) {
+    if (row % kRowsPerChunk == 0u) {
+      doc.AddChunk(std::min(kRowsPerChunk, num_rows - row));
+    }
+    for (int column = 0; column < kNumIntColumns; ++column) {
+      const auto cell = std::to_string(value(random));
+      doc.Write(row, column, cell.data(), cell.size());
+    }
+    const auto grade = std::to_string(value(random)) + ".25";
+    doc.Write(row, kNumIntColumns, grade.data(), grade.size());
+    const auto code = "code" + std::to_string(value(random) % 100);
+    doc.Write(row, kNumIntColumns + 1, code.data(), code.size());
+  }
+  return doc;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t num_rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000u;
+  const std::string path = argc > 2 ? argv[2] : "write_bench.csv";
+  const int num_threads = argc > 3 ? std::atoi(argv[3]) : 16;
+
+  const auto doc = MakeDocument(num_rows);
+  {
+    Stopwatch watch("Dump");
+    watch.Start();
+    std::ofstream file_out(path);
+    doc.Dump(file_out);
+    file_out.close();
+    watch.End();
+  }
+  {
+    Stopwatch watch("WriteCSV");
+    watch.Start();
+    csv::WriteCSV(doc, path, csv::ReadOptions('"', ',', num_threads));
+    watch.End();
+  }
+  std::ifstream file_in(path, std::ios::ate);
+  std::cout << "  bytes: " << file_in.tellg() << '\n';
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "write.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <gtest/gtest.h>
+
+namespace {
+
+using FieldType = csv::FieldType;
+
+struct TempFileHandle {
+  std::string file_name;
+  TempFileHandle(): file_name(std::tmpnam(nullptr)) {}
+  ~TempFileHandle() { if (!file_name.empty()) std::remove(file_name.c_str()); }
+};
+
+TEST(TestWriteCSV, WriteCSV) {
+  for (auto layout : {csv::Layout::ROW, csv::Layout::COLUMN}) {
+    csv::Document doc(std::vector<std::string>{"id", "grade", "name", "note", "status"},
+                      std::vector<FieldType>{FieldType::INT64, FieldType::DOUBLE,
+                                             FieldType::STRING, FieldType::VARSTRING,
+                                             FieldType::CATEGORY},
+                      layout);
+    const std::vector<std::vector<std::string>> rows{
+        {"1", "1.5", "KR", "\"a,b\"", "OK"},
+        {"", "0.1", "", "say \"hi\"", "FAIL"},
+        {"-3", "", "x|y", "two\nlines", ""}};
+    doc.AddChunk(2);
+    for (size_t row = 0u; row < rows.size(); ++row) {
+      if (row == 2u) {
+        doc.AddChunk(1);
+      }
+      for (size_t column = 0u; column < rows[row].size(); ++column) {
+        doc.Write(row, column, rows[row][column].data(), rows[row][column].size());
+      }
+    }
+
+    std::ostringstream os;
+    csv::WriteCSV(doc, os, csv::ReadOptions('"', ',', 4));
+    EXPECT_EQ("id,grade,name,note,status\n"
+              "1,1.5,KR,\"a,b\",OK\n"
+              ",0.1,,\"say \"\"hi\"\"\",FAIL\n"
+              "-3,,x|y,\"two\nlines\",\n",
+              os.str());
+
+    std::ostringstream piped;
+    csv::WriteCSV(doc, piped, csv::ReadOptions('\'', '|', 1));
+    EXPECT_EQ("id|grade|name|note|status\n"
+              "1|1.5|KR|\"a,b\"|OK\n"
+              "|0.1||say \"hi\"|FAIL\n"
+              "-3||'x|y'|'two\nlines'|\n",
+              piped.str());
+  }
+}
+
+TEST(TestWriteCSV, RoundTrip) {
+  // enough rows for many slices per chunk
+  constexpr int64_t num_rows = 100000;
+  TempFileHandle file_handle;
+  std::ofstream ofs(file_handle.file_name);
+  ofs << "id,grade,name\n";
+  for (int64_t row = 0; row < num_rows; ++row) {
+    ofs << row << ',' << (row % 7 == 0 ? "" : std::to_string(row / 3.0)) << ",\"n,"
+        << row % 100 << "\"\n";
+  }
+  ofs.close();
+
+  const std::vector<FieldType> field_types{FieldType::INT64, FieldType::DOUBLE,
+                                           FieldType::CATEGORY};
+  csv::ReadOptions options('"', ',', 4);
+  options.block_size = 1024 * 1024;
+  const auto doc = csv::ReadCSV(file_handle.file_name, field_types, options);
+  ASSERT_GT(doc.NumChunks(), 1u);
+
+  TempFileHandle written_handle;
+  csv::WriteCSV(doc, written_handle.file_name, options);
+  const auto written = csv::ReadCSV(written_handle.file_name, field_types, options);
+  EXPECT_EQ(doc.GetAsInt64("id"), written.GetAsInt64("id"));
+  EXPECT_EQ(doc.GetAsDouble("grade"), written.GetAsDouble("grade"));
+  EXPECT_EQ(doc.GetValidity("grade"), written.GetValidity("grade"));
+  EXPECT_EQ(doc.GetAsString("name"), written.GetAsString("name"));
+}
+
+}  // anonymous namespace